@@ -209,6 +209,8 @@ namespace db
 		unsigned long m_counter;
 		state m_state;
 		bool m_commited;
+		// one for each nested lock; a level is finished by its commit or by its unlock, whichever comes first
+		std::vector<bool> m_finished;
 
 		bool finish_transaction(bool commit);
 	public:
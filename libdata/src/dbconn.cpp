@@ -71,15 +71,20 @@ namespace db
 		if (!m_counter)
 		{
 			if (!m_conn->beginTransaction())
+			{
+				m_mutex.unlock();
 				throw transaction_error(m_conn->errorMessage(), m_counter);
+			}
 			m_state = BEGAN;
 		}
 		++m_counter;
+		m_finished.push_back(false);
 	}
 
 	void transaction_mutex::unlock()
 	{
 		(void) finish_transaction(false);
+		m_finished.pop_back();
 		m_mutex.unlock();
 	}
 
@@ -91,15 +96,18 @@ namespace db
 
 	bool transaction_mutex::finish_transaction(bool commit)
 	{
-		if (m_state != BEGAN)
+		if (m_finished.empty() || m_finished.back())
 			return true;
 
+		m_finished.back() = true;
 		--m_counter;
-		m_state = commit ? COMMITED : REVERTED;
-		if (!m_counter)
-			return commit ? m_conn->commitTransaction() : m_conn->rollbackTransaction();
 
-		return true;
+		// the nested ones only count down; the outermost one commits or rolls back everything
+		if (m_counter)
+			return true;
+
+		m_state = commit ? COMMITED : REVERTED;
+		return commit ? m_conn->commitTransaction() : m_conn->rollbackTransaction();
 	}
 #endif
 
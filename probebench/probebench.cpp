@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifdef _WIN32
+#include <sdkddkver.h>
+#endif
+
+#include <dlna_media.hpp>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+namespace fs = boost::filesystem;
+namespace dlna = net::dlna;
+
+inline void push() {}
+
+template <typename T, typename... Args>
+inline void push(T && arg, Args && ... rest)
+{
+	std::cerr << arg;
+	push(std::forward<Args>(rest)...);
+}
+
+template <typename... Args>
+void help(Args&& ... args)
+{
+	std::cerr << "probebench 1.0 -- native and ffmpeg probers, side by side.\n";
+
+	push(std::forward<Args>(args)...);
+	if (sizeof...(args) > 0)
+		std::cerr << "\n";
+
+	std::cerr <<
+		"\nusage:\n"
+		"	probebench [-n rounds] folder [folder...]\n"
+		"\n"
+		"Opens every file under the folders with both probers, prints how long each\n"
+		"took (the best of the rounds) and lists the files, for which they disagree.\n";
+}
+
+struct result
+{
+	bool m_ok;
+	dlna::Item m_item;
+
+	result() : m_ok(false) {}
+};
+
+struct file_info
+{
+	fs::path m_path;
+	result m_native;
+	result m_ffmpeg;
+
+	explicit file_info(const fs::path& path) : m_path(path) {}
+};
+
+typedef std::chrono::high_resolution_clock clock_type;
+
+static double probe_all(std::vector<file_info>& files, dlna::prober use, int rounds)
+{
+	double best = 0;
+	for (int round = 0; round < rounds; ++round)
+	{
+		auto start = clock_type::now();
+		for (auto && file : files)
+		{
+			auto& res = use == dlna::prober::native ? file.m_native : file.m_ffmpeg;
+			res.m_item = dlna::Item();
+			res.m_ok = res.m_item.open(file.m_path, use);
+		}
+		double elapsed = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+		if (!round || elapsed < best)
+			best = elapsed;
+	}
+	return best;
+}
+
+static void differs(std::ostream& o, const char* what, const std::string& native, const std::string& ffmpeg)
+{
+	o << "\n    " << what << ": native=`" << native << "` ffmpeg=`" << ffmpeg << "`";
+}
+
+template <typename T>
+static void differs(std::ostream& o, const char* what, T native, T ffmpeg)
+{
+	o << "\n    " << what << ": native=" << native << " ffmpeg=" << ffmpeg;
+}
+
+// a file, which ffmpeg does not know, is not expected to be known by the native probers either
+static bool compare(std::ostream& o, const file_info& file)
+{
+	auto& native = file.m_native;
+	auto& ffmpeg = file.m_ffmpeg;
+
+	if (!native.m_ok)
+		return true;
+
+	std::ostringstream diff;
+	if (!ffmpeg.m_ok)
+		diff << "\n    known only to the native prober";
+	else
+	{
+		auto& n = native.m_item;
+		auto& f = ffmpeg.m_item;
+
+		auto name = [](const dlna::Item& item) { return std::string(item.m_profile.m_name ? item.m_profile.m_name : "-"); };
+		if (name(n) != name(f)) differs(diff, "profile", name(n), name(f));
+		if (n.m_class != f.m_class) differs(diff, "class", (int) n.m_class, (int) f.m_class);
+
+		auto& np = n.m_props;
+		auto& fp = f.m_props;
+		if (std::abs((long) np.m_duration - (long) fp.m_duration) > 1) differs(diff, "duration", np.m_duration, fp.m_duration);
+		if (np.m_width != fp.m_width) differs(diff, "width", np.m_width, fp.m_width);
+		if (np.m_height != fp.m_height) differs(diff, "height", np.m_height, fp.m_height);
+		if (np.m_sample_freq != fp.m_sample_freq) differs(diff, "sample rate", np.m_sample_freq, fp.m_sample_freq);
+		if (np.m_channels != fp.m_channels) differs(diff, "channels", np.m_channels, fp.m_channels);
+
+		auto& nm = n.m_meta;
+		auto& fm = f.m_meta;
+		if (nm.m_title != fm.m_title) differs(diff, "title", nm.m_title, fm.m_title);
+		if (nm.m_artist != fm.m_artist) differs(diff, "artist", nm.m_artist, fm.m_artist);
+		if (nm.m_album != fm.m_album) differs(diff, "album", nm.m_album, fm.m_album);
+		if (n.m_cover.size() != f.m_cover.size()) differs(diff, "cover", n.m_cover.size(), f.m_cover.size());
+	}
+
+	auto text = diff.str();
+	if (text.empty())
+		return true;
+
+	o << "  " << file.m_path.string() << text << "\n";
+	return false;
+}
+
+int main(int argc, char* argv [])
+{
+	try
+	{
+		int rounds = 3;
+		std::vector<fs::path> roots;
+
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string arg = argv[i];
+			if (arg == "-n")
+			{
+				if (++i == argc)
+				{
+					help("Number of rounds missing.");
+					return 1;
+				}
+				rounds = atoi(argv[i]);
+				if (rounds < 1)
+					rounds = 1;
+				continue;
+			}
+			roots.push_back(arg);
+		}
+
+		if (roots.empty())
+		{
+			help("Folder name missing.");
+			return 1;
+		}
+
+		std::vector<file_info> files;
+		for (auto && root : roots)
+		{
+			boost::system::error_code ec;
+			for (fs::recursive_directory_iterator it { root, ec }, end; !ec && it != end; it.increment(ec))
+			{
+				if (fs::is_regular_file(it->status()))
+					files.emplace_back(it->path());
+			}
+		}
+
+		if (files.empty())
+		{
+			help("No files found.");
+			return 1;
+		}
+
+		dlna::init media;
+
+		// the first pass over the corpus warms up the disk cache for both of them
+		probe_all(files, dlna::prober::any, 1);
+
+		double native = probe_all(files, dlna::prober::native, rounds);
+		double ffmpeg = probe_all(files, dlna::prober::ffmpeg, rounds);
+
+		size_t native_count = 0, ffmpeg_count = 0, mismatches = 0;
+		std::ostringstream list;
+		for (auto && file : files)
+		{
+			if (file.m_native.m_ok) ++native_count;
+			if (file.m_ffmpeg.m_ok) ++ffmpeg_count;
+			if (!compare(list, file)) ++mismatches;
+		}
+
+		auto per_file = [&](double ms) { return ms * 1000 / files.size(); };
+
+		std::cout << std::fixed << std::setprecision(2)
+			<< "files:    " << files.size() << " (best of " << rounds << ")\n"
+			<< "native:   " << std::setw(10) << native << " ms, " << std::setw(8) << per_file(native) << " us/file, " << native_count << " known\n"
+			<< "ffmpeg:   " << std::setw(10) << ffmpeg << " ms, " << std::setw(8) << per_file(ffmpeg) << " us/file, " << ffmpeg_count << " known\n"
+			<< "mismatch: " << mismatches << "\n";
+
+		if (mismatches)
+			std::cout << "\n" << list.str();
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Exception: " << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catalog.hpp"
+#include "fs_items.hpp"
+#include "schema.hpp"
+
+namespace lan
+{
+	catalog& catalog::get()
+	{
+		// never destroyed: the scans on the detached threads store their results here
+		static catalog* instance = new catalog();
+		return *instance;
+	}
+
+	const char* catalog::intern(const std::string& text)
+	{
+		if (text.empty())
+			return nullptr;
+
+		std::lock_guard<std::mutex> lock(m_guard);
+		return m_strings.insert(text).first->c_str();
+	}
+
+	void catalog::open(const std::shared_ptr<db::schema>& data)
+	{
+		std::lock_guard<std::mutex> lock(m_guard);
+		m_data = data;
+	}
+
+	std::shared_ptr<db::schema> catalog::data()
+	{
+		std::lock_guard<std::mutex> lock(m_guard);
+		return m_data;
+	}
+
+	av::items::media_item_ptr catalog::restore(av::MediaServer* device, const boost::filesystem::path& root)
+	{
+		auto data = this->data();
+		if (!data)
+			return nullptr;
+
+		auto id = data->add_root(root);
+		if (id == -1 || !data->scanned(id))
+			return nullptr;
+
+		auto folder = std::make_shared<item::directory_item>(device, root);
+
+		fs::path cover = root / "Folder.jpg";
+		if (fs::exists(cover))
+			folder->set_cover(cover);
+
+		restore(device, folder, id);
+		return folder;
+	}
+
+	void catalog::restore(av::MediaServer* device, const std::shared_ptr<item::container_file>& folder, long long id)
+	{
+		auto data = this->data();
+		std::vector<db::entry> rows;
+		if (!data || !data->children(id, rows))
+			return;
+
+		av::items::media_item::container_type children;
+		children.reserve(rows.size());
+		for (auto && row : rows)
+		{
+			auto child = restore(device, row);
+			if (child)
+				children.push_back(child);
+		}
+
+		folder->restore(std::move(children));
+		folder->verify();
+	}
+
+	av::items::media_item_ptr catalog::restore(av::MediaServer* device, const db::entry& row)
+	{
+		std::shared_ptr<item::path_item> ret;
+
+		switch (row.m_class)
+		{
+		case net::dlna::Class::Video:
+		case net::dlna::Class::Audio:
+		case net::dlna::Class::Image:
+			{
+				net::dlna::Item file;
+				file.m_class = row.m_class;
+				file.m_meta = row.m_meta;
+				file.m_props = row.m_props;
+				file.m_profile = net::dlna::Profile(intern(row.m_profile), intern(row.m_mime), "", row.m_class);
+
+				item::stamp known(row.m_props.m_last_write_time, (uintmax_t) row.m_props.m_size, row.m_inode);
+				ret = std::make_shared<item::ffmpeg_file>(device, row.m_path, file, known);
+			}
+			break;
+		case net::dlna::Class::Container:
+			{
+				item::stamp known(row.m_props.m_last_write_time, 0, row.m_inode);
+				auto folder = std::make_shared<item::directory_item>(device, row.m_path, known);
+
+				// a folder never opened is scanned, when it is opened, as always
+				if (row.m_scanned)
+					restore(device, folder, row.m_id);
+
+				ret = folder;
+			}
+			break;
+		default:
+			return nullptr;
+		}
+
+		if (row.m_cover_mime.empty())
+			return ret;
+
+		net::dlna::Profile cover(intern(row.m_cover_profile), intern(row.m_cover_mime), "", net::dlna::Class::Image);
+		if (!row.m_cover_path.empty())
+			ret->set_cover(fs::path(row.m_cover_path), cover);
+		else if (row.m_cover_stored)
+		{
+			auto data = this->data();
+			auto path = row.m_path;
+			ret->set_cover(cover, [data, path] { return data->cover_data(path); });
+		}
+
+		return ret;
+	}
+
+	void catalog::save(const boost::filesystem::path& folder, const av::items::media_item::container_type& added, const av::items::media_item::container_type& removed)
+	{
+		auto data = this->data();
+		if (!data)
+			return;
+
+		std::vector<db::entry> rows;
+		rows.reserve(added.size());
+		for (auto && ptr : added)
+		{
+			auto file = std::dynamic_pointer_cast<item::path_item>(ptr);
+			if (!file)
+				continue;
+
+			db::entry row;
+			row.m_path = file->get_path();
+
+			auto media = std::dynamic_pointer_cast<item::ffmpeg_file>(ptr);
+			if (media)
+			{
+				auto& profile = media->m_item.m_profile;
+				row.m_class = media->m_item.m_class;
+				row.m_profile = profile.m_name ? profile.m_name : "";
+				row.m_mime = profile.m_mime ? profile.m_mime : "";
+				row.m_meta = media->m_item.m_meta;
+				row.m_props = media->m_item.m_props;
+			}
+			else
+			{
+				row.m_class = net::dlna::Class::Container;
+				row.m_meta.m_title = file->get_title();
+			}
+
+			auto& known = file->get_stamp();
+			row.m_props.m_last_write_time = known.m_last_write;
+			row.m_props.m_size = (net::dlna::size_t) known.m_size;
+			row.m_inode = known.m_inode;
+
+			auto cover = file->get_cover();
+			auto profile = cover ? cover->profile() : nullptr;
+			if (profile && profile->m_mime)
+			{
+				row.m_cover_profile = profile->m_name ? profile->m_name : "";
+				row.m_cover_mime = profile->m_mime;
+				if (!file->get_cover_data(row.m_cover_data))
+					row.m_cover_path = file->get_cover_path().string();
+			}
+
+			rows.push_back(std::move(row));
+		}
+
+		std::vector<boost::filesystem::path> gone;
+		for (auto && ptr : removed)
+		{
+			auto path = item::directory_item::get_path(ptr);
+
+			// a file written anew keeps its row
+			auto pos = std::find_if(rows.begin(), rows.end(), [&](const db::entry& row) { return row.m_path == path; });
+			if (pos == rows.end())
+				gone.push_back(path);
+		}
+
+		if (!data->store(folder, rows, gone))
+			log::warning() << "Could not store the scan of " << folder;
+	}
+}
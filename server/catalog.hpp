@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __CATALOG_HPP__
+#define __CATALOG_HPP__
+
+#include <media_server.hpp>
+#include <boost/filesystem.hpp>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace av = net::ssdp::import::av;
+
+namespace db
+{
+	class schema;
+	struct entry;
+}
+
+namespace lan
+{
+	namespace item
+	{
+		struct container_file;
+	}
+
+	/*
+	 * The scan results, kept in the database between the runs. At start,
+	 * the folders are built from their rows at once, without opening any
+	 * of the files, and then scanned again in the background; only the
+	 * files with a different size, last write time or inode are probed.
+	 * Every scan stores, what it changed, in one transaction.
+	 */
+	class catalog
+	{
+	public:
+		static catalog& get();
+
+		// the scans and the covers keep the schema alive, for as long as they need it
+		void open(const std::shared_ptr<db::schema>& data);
+		void close() { open(nullptr); }
+
+		// the folder, as it was stored, or nullptr, if it was never scanned
+		av::items::media_item_ptr restore(av::MediaServer* device, const boost::filesystem::path& root);
+		void save(const boost::filesystem::path& folder, const av::items::media_item::container_type& added, const av::items::media_item::container_type& removed);
+
+	private:
+		catalog() {}
+
+		void restore(av::MediaServer* device, const std::shared_ptr<item::container_file>& folder, long long id);
+		av::items::media_item_ptr restore(av::MediaServer* device, const db::entry& row);
+		// the profiles need strings, which live as long as the server
+		const char* intern(const std::string& text);
+		std::shared_ptr<db::schema> data();
+
+		std::shared_ptr<db::schema> m_data;
+		std::mutex m_guard;
+		std::set<std::string> m_strings;
+	};
+}
+
+#endif // __CATALOG_HPP__
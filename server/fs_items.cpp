@@ -23,19 +23,31 @@
  */
 
 #include "fs_items.hpp"
+#include "catalog.hpp"
 
 #include <regex>
 #include <future>
 #include <threads.hpp>
 #include <dlna_media.hpp>
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
 namespace lan
 {
 	Log::Module APP { "APPL" };
 
 	namespace item
 	{
-		std::shared_ptr<ffmpeg_file> create(av::MediaServer* device, const fs::path& path, net::dlna::Item& item)
+		std::shared_ptr<ffmpeg_file> create(av::MediaServer* device, const fs::path& path, net::dlna::Item& item, const siblings_t* siblings)
 		{
 			std::vector<char> cover = std::move(item.m_cover);
 
@@ -44,17 +56,35 @@ namespace lan
 				ret->set_cover(std::move(cover));
 			else
 			{
+				auto exists = [siblings](const fs::path& cover) { return siblings ? siblings->count(cover.filename()) > 0 : fs::exists(cover); };
+
 				fs::path cover = path.string() + ".cover.png";
-				if (!fs::exists(cover))
+				if (!exists(cover))
 					cover = path.string() + ".cover.jpg";
-				if (fs::exists(cover))
+				if (exists(cover))
 					ret->set_cover(cover);
 			}
 
 			return ret;
 		}
 
+		av::items::media_item_ptr from_folder(av::MediaServer* device, const fs::path& path)
+		{
+			auto ret = std::make_shared<directory_item>(device, path);
+
+			fs::path cover = path / "Folder.jpg";
+			if (fs::exists(cover))
+				ret->set_cover(cover);
+
+			return ret;
+		}
+
 		av::items::media_item_ptr from_path(av::MediaServer* device, const fs::path& path)
+		{
+			return from_path(device, path, nullptr);
+		}
+
+		av::items::media_item_ptr from_path(av::MediaServer* device, const fs::path& path, const siblings_t* siblings)
 		{
 			if (path.filename() == ".")
 				return nullptr;
@@ -68,20 +98,120 @@ namespace lan
 			case net::dlna::Class::Video:
 			case net::dlna::Class::Audio:
 			case net::dlna::Class::Image:
-				return create(device, path, item);
+				return create(device, path, item, siblings);
 			case net::dlna::Class::Container:
+				return from_folder(device, path);
+			}
+
+			return nullptr;
+		}
+
+		stamp stamp::of(const fs::path& path)
+		{
+			boost::system::error_code ec;
+			auto ret = of(path, ec);
+			if (ec)
+				throw fs::filesystem_error("stamp::of", path, ec);
+			return ret;
+		}
+
+		stamp stamp::of(const fs::path& path, boost::system::error_code& ec)
+		{
+			ec.clear();
+#ifdef _WIN32
+			// there is no inode to speak of; the size and the last write time have to do
+			auto last_write = fs::last_write_time(path, ec);
+			if (ec)
+				return stamp();
+			if (fs::is_directory(path, ec))
+				return stamp(last_write, 0, 0);
+			auto size = fs::file_size(path, ec);
+			if (ec)
+				return stamp();
+			return stamp(last_write, size, 0);
+#else
+			struct stat st;
+			if (::stat(path.c_str(), &st))
+			{
+				ec.assign(errno, boost::system::system_category());
+				return stamp();
+			}
+			return stamp(st.st_mtime, S_ISDIR(st.st_mode) ? 0 : st.st_size, st.st_ino);
+#endif
+		}
+
+		listing_t list_folder(const fs::path& path)
+		{
+			listing_t ret;
+#ifdef __linux__
+			// the d_type of the entry is enough for almost every file system; only the rest is looked at
+			struct linux_dirent64
+			{
+				uint64_t       d_ino;
+				int64_t        d_off;
+				unsigned short d_reclen;
+				unsigned char  d_type;
+				char           d_name[1];
+			};
+
+			int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (fd < 0)
+				throw fs::filesystem_error("list_folder", path, boost::system::error_code(errno, boost::system::system_category()));
+
+			std::vector<char> buffer(32 * 1024);
+			for (;;)
+			{
+				long read = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+				if (read < 0)
 				{
-					auto ret = std::make_shared<directory_item>(device, path);
+					if (errno == EINTR)
+						continue;
+					boost::system::error_code ec(errno, boost::system::system_category());
+					::close(fd);
+					throw fs::filesystem_error("list_folder", path, ec);
+				}
+
+				if (!read)
+					break;
 
-					fs::path cover = path / "Folder.jpg";
-					if (fs::exists(cover))
-						ret->set_cover(cover);
+				for (long pos = 0; pos < read;)
+				{
+					auto entry = reinterpret_cast<const linux_dirent64*>(buffer.data() + pos);
+					pos += entry->d_reclen;
 
-					return ret;
+					const char* name = entry->d_name;
+					if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+						continue;
+
+					bool folder = entry->d_type == DT_DIR;
+					if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+					{
+						struct stat st;
+						folder = !::fstatat(fd, name, &st, 0) && S_ISDIR(st.st_mode);
+					}
+
+					ret.emplace_back(path / name, folder);
 				}
 			}
 
-			return nullptr;
+			::close(fd);
+#else
+			// the iterator already has the attributes found with the file
+			for (fs::directory_iterator it { path }, end; it != end; ++it)
+			{
+				boost::system::error_code ec;
+				ret.emplace_back(it->path(), fs::is_directory(it->status(ec)));
+			}
+#endif
+			std::sort(ret.begin(), ret.end());
+			return ret;
+		}
+
+		bool path_item::changed() const
+		{
+			boost::system::error_code ec;
+			auto now = stamp::of(m_path, ec);
+			return ec || now != m_stamp;
 		}
 
 		struct embedded_cover;
@@ -100,16 +230,35 @@ namespace lan
 			std::size_t read(void* buffer, std::size_t size) override;
 		};
 
+		void base64_decode(const std::string& base64, std::vector<char>& dst);
+
 		struct embedded_cover : av::items::media, std::enable_shared_from_this<embedded_cover>
 		{
 			std::vector<char> m_text;
 			net::dlna::Profile m_profile;
 			fs::path m_path;
+			// the picture kept in the catalog, read on the first request
+			std::function<std::string ()> m_load;
+			std::mutex m_guard;
 
 			embedded_cover(const fs::path path) : m_path(path) {}
 
+			bool load()
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+				if (m_load)
+				{
+					base64_decode(m_load(), m_text);
+					m_load = nullptr;
+				}
+				return !m_text.empty();
+			}
+
 			bool prep_response(net::http::response& resp) override
 			{
+				if (!load())
+					return false;
+
 				auto& header = resp.header();
 				header.append("content-type", m_profile.m_mime);
 				resp.content(std::make_shared<referenced_content>(shared_from_this()));
@@ -228,6 +377,59 @@ namespace lan
 			m_cover = ret;
 		}
 
+		void path_item::set_cover(const net::dlna::Profile& profile, const std::function<std::string ()>& base64)
+		{
+			auto ret = std::make_shared<embedded_cover>(m_path);
+
+			ret->m_profile = profile;
+			ret->m_load = base64;
+
+			m_cover = ret;
+		}
+
+		std::string base64_encode(const std::vector<char>& src)
+		{
+			static char alphabet [] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+			std::string out;
+			out.reserve((src.size() + 2) / 3 * 4);
+
+			unsigned int bits = 0;
+			unsigned int accu = 0;
+			for (auto && c : src)
+			{
+				accu = (accu << 8) | (unsigned char) c;
+				bits += 8;
+				while (bits >= 6)
+				{
+					bits -= 6;
+					out.push_back(alphabet[(accu >> bits) & 0x3F]);
+				}
+			}
+
+			if (bits)
+				out.push_back(alphabet[(accu << (6 - bits)) & 0x3F]);
+
+			while (out.size() % 4)
+				out.push_back('=');
+
+			return out;
+		}
+
+		bool path_item::get_cover_data(std::string& base64) const
+		{
+			auto cover = std::dynamic_pointer_cast<embedded_cover>(m_cover);
+			if (!cover)
+				return false;
+
+			std::lock_guard<std::mutex> lock(cover->m_guard);
+			if (cover->m_text.empty())
+				return false;
+
+			base64 = base64_encode(cover->m_text);
+			return true;
+		}
+
 		common_file::media_ptr common_file::get_media(media_type type) const
 		{
 			switch (type)
@@ -242,6 +444,14 @@ namespace lan
 			return nullptr;
 		}
 
+		common_file::media_ptr ffmpeg_file::get_media(media_type type) const
+		{
+			// the profile from the scan; no probing while the renderer waits for the stream
+			if (type == av::items::main_resource && m_main)
+				return m_main;
+			return common_file::get_media(type);
+		}
+
 #pragma region container_file
 
 		container_file::container_type container_file::list(net::ulong start_from, net::ulong max_count)
@@ -253,33 +463,107 @@ namespace lan
 			return data;
 		}
 
+		container_file::container_type container_file::sorted_list(net::ulong start_from, net::ulong max_count, const av::sorting::criteria& order)
+		{
+			if (order.empty())
+				return list(start_from, max_count);
+
+			rescan_if_needed();
+
+			// any order needs the whole folder, so wait for the first scan to finish
+			bool wait = false;
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+				wait = must_wait();
+			}
+			if (wait)
+				async_list(0, av::items::INVALID_ID).get();
+
+			auto snapshot = children();
+			std::lock_guard<std::mutex> lock(m_guard);
+			return m_sorted.slice(*snapshot, order, start_from, max_count);
+		}
+
 		net::ulong container_file::predict_count(net::ulong served) const
 		{
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+				if (must_wait())
+				{
+					net::ulong estimate = m_estimate;
+					return estimate > served ? estimate : served + 1;
+				}
+			}
+			return children()->size();
+		}
+
+		bool container_file::wait_for(net::ulong start_from, net::ulong max_count, const ready_type& ready)
+		{
+			rescan_if_needed();
+
 			std::lock_guard<std::mutex> lock(m_guard);
-			if (is_running())
-				return served + 1;
-			return m_children.size();
+			if (!must_wait() || has_page(start_from, max_count))
+				return true;
+
+			if (ready)
+				m_waiters.emplace_back(start_from, max_count, ready);
+			return false;
+		}
+
+		container_file::container_type container_file::peek(net::ulong start_from, net::ulong max_count)
+		{
+			rescan_if_needed();
+			return av::sorting::slice(*children(), start_from, max_count);
+		}
+
+		bool container_file::has_page(net::ulong start_from, net::ulong max_count) const
+		{
+			auto size = children()->size();
+			return size >= start_from && size - start_from >= max_count;
 		}
 
 		void container_file::rescan_if_needed()
 		{
+			// a renderer looks at this folder; its scan, queued or running, goes first
+			scanner::get().bump(m_ticket);
+
 			if (!rescan_needed())
 				return;
 
 			if (!mark_start())
 				return; // someone was quicker...
 
+			queue_scan();
+		}
+
+		void container_file::restore(container_type&& children)
+		{
+			for (auto && child : children)
+				adopt(child);
+
+			container_type added(children);
+			publish(std::move(children), added, container_type());
+
+			std::lock_guard<std::mutex> lock(m_guard);
+			m_scanned = true;
+		}
+
+		void container_file::verify()
+		{
+			// not bumped; the folders the renderers look at go first
+			if (!mark_start())
+				return;
+
+			queue_scan();
+		}
+
+		void container_file::queue_scan()
+		{
 			auto shared = shared_from_this();
-			auto thread = std::thread([shared, this]{
+			scanner::get().scan(m_ticket, [shared, this]{
 				try
 				{
-					static std::atomic<int> count;
-					threads::set_name("I/O Thread #" + std::to_string(count++));
-
 					rescan();
-					fulfill_promises(true); // release all remaining futures
-
-					mark_stop();
 				}
 				catch (std::exception& e)
 				{
@@ -289,9 +573,11 @@ namespace lan
 				{
 					log::error() << "Unknown exception";
 				}
-			});
 
-			thread.detach();
+				// releases all remaining futures and waiters, even if the scan failed
+				mark_stop();
+				scan_finished();
+			});
 		}
 
 		container_file::future_type container_file::async_list(net::ulong start_from, net::ulong max_count)
@@ -302,7 +588,8 @@ namespace lan
 			{
 				std::lock_guard<std::mutex> lock(m_guard);
 
-				if (is_running())
+				// a rescan does not hold anyone up, the previous snapshot is still good
+				if (must_wait() && !has_page(start_from, max_count))
 				{
 					m_tasks.emplace_back(std::move(promise), start_from, max_count);
 				}
@@ -320,19 +607,7 @@ namespace lan
 			try
 			{
 				log::info() << "Returning slice " << get_path().filename() << " (" << start_from << ", " << start_from + max_count << ")";
-				container_type out;
-				if (start_from > m_children.size())
-					start_from = m_children.size();
-
-				auto end_at = m_children.size() - start_from;
-				if (end_at > max_count)
-					end_at = max_count;
-				end_at += start_from;
-
-				for (auto i = start_from; i < end_at; ++i)
-					out.push_back(m_children.at(i));
-
-				promise.set_value(out);
+				promise.set_value(av::sorting::slice(*children(), start_from, max_count));
 			}
 			catch (...)
 			{
@@ -340,13 +615,12 @@ namespace lan
 			}
 		}
 
-		void container_file::fulfill_promises(bool forced)
+		std::vector<container_file::ready_type> container_file::fulfill_promises(bool forced)
 		{
 			auto cur = m_tasks.begin();
 			while (cur != m_tasks.end())
 			{
-				auto rest = m_children.size() - cur->m_start_from;
-				if (forced || rest >= cur->m_max_count)
+				if (forced || has_page(cur->m_start_from, cur->m_max_count))
 				{
 					fill_request(std::move(cur->m_promise), cur->m_start_from, cur->m_max_count);
 					cur = m_tasks.erase(cur);
@@ -354,6 +628,20 @@ namespace lan
 				}
 				++cur;
 			}
+
+			std::vector<ready_type> ready;
+			auto waiter = m_waiters.begin();
+			while (waiter != m_waiters.end())
+			{
+				if (forced || has_page(waiter->m_start_from, waiter->m_max_count))
+				{
+					ready.push_back(std::move(waiter->m_ready));
+					waiter = m_waiters.erase(waiter);
+					continue;
+				}
+				++waiter;
+			}
+			return ready;
 		}
 
 		av::items::media_item_ptr container_file::get_item(const std::string& id)
@@ -361,7 +649,7 @@ namespace lan
 			av::items::media_item_ptr candidate;
 			std::string rest_of_id;
 
-			std::tie(candidate, rest_of_id) = av::items::find_item(m_children, id);
+			std::tie(candidate, rest_of_id) = av::items::find_item(*children(), id);
 
 			if (!candidate || rest_of_id.empty())
 				return candidate;
@@ -386,34 +674,124 @@ namespace lan
 
 		void container_file::folder_changed()
 		{
-			::time(&m_update_id);
-			m_device->object_changed();
+			m_update_id = ::time(nullptr);
+			m_device->object_changed(this);
 		}
 
-		void container_file::add_child(av::items::media_item_ptr child)
+		void container_file::adopt(const item_ptr& child)
 		{
-			remove_child(child);
-
 			std::lock_guard<std::mutex> lock(m_guard);
 
-			m_children.push_back(child);
 			auto id = ++m_current_max;
 			child->set_id(id);
 			child->set_objectId_attr(get_raw_objectId_attr() + av::items::SEP + std::to_string(id));
 			child->set_parent_attr(get_objectId_attr());
+			child->invalidate_output();
+		}
 
-			if (is_running())
-				fulfill_promises(false);
+		void container_file::take_place(const item_ptr& child, const item_ptr& old)
+		{
+			child->set_id(old->get_id());
+			child->set_objectId_attr(old->get_raw_objectId_attr());
+			child->set_parent_attr(get_objectId_attr());
+			child->invalidate_output();
 		}
 
-		void container_file::remove_child(av::items::media_item_ptr child)
+		void container_file::publish(container_type&& next, const container_type& added, const container_type& removed)
 		{
-			std::lock_guard<std::mutex> lock(m_guard);
+			publish([&](const container_type&, container_type& out, container_type& out_added, container_type& out_removed)
+			{
+				out = std::move(next);
+				out_added = added;
+				out_removed = removed;
+				return true;
+			});
+		}
+
+		void container_file::publish(const transform_type& transform)
+		{
+			std::vector<ready_type> ready;
+			container_type added, removed;
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+
+				container_type next;
+				if (!transform(*children(), next, added, removed))
+					return;
+
+				snapshot_ptr snapshot = std::make_shared<container_type>(std::move(next));
+				std::atomic_store(&m_children, snapshot);
+
+				for (auto && child : removed)
+					m_sorted.remove(child);
+				for (auto && child : added)
+					m_sorted.add(child);
+
+				if (must_wait())
+					ready = fulfill_promises(false);
+			}
+
+			for (auto && call : ready)
+				call();
+
+			for (auto && child : removed)
+				m_device->item_removed(child);
+			for (auto && child : added)
+				m_device->item_added(child);
+		}
+
+		void container_file::add_child(av::items::media_item_ptr child)
+		{
+			adopt(child);
+
+			// on top of whatever a scan published in the meantime
+			publish([&](const container_type& current, container_type& next, container_type& added, container_type& removed)
+			{
+				next.reserve(current.size() + 1);
+				for (auto && ptr : current)
+				{
+					if (ptr != child)
+						next.push_back(ptr);
+				}
+				if (next.size() != current.size())
+					removed.push_back(child);
+				next.push_back(child);
+				added.push_back(child);
+				return true;
+			});
 			folder_changed();
+		}
+
+		void container_file::remove_child(av::items::media_item_ptr child)
+		{
+			bool was_there = false;
+			publish([&](const container_type& current, container_type& next, container_type& /*added*/, container_type& removed)
+			{
+				auto pos = std::find(current.begin(), current.end(), child);
+				if (pos == current.end())
+					return false;
+
+				next.assign(current.begin(), pos);
+				next.insert(next.end(), pos + 1, current.end());
+				removed.push_back(child);
+				was_there = true;
+				return true;
+			});
 
-			auto pos = std::find(m_children.begin(), m_children.end(), child);
-			if (pos != m_children.end())
-				m_children.erase(pos);
+			if (was_there)
+				folder_changed();
+		}
+
+		void container_file::forget_children()
+		{
+			auto snapshot = children();
+			for (auto && child : *snapshot)
+			{
+				auto folder = std::dynamic_pointer_cast<container_file>(child);
+				if (folder)
+					folder->forget_children();
+				m_device->item_removed(child);
+			}
 		}
 #pragma endregion
 
@@ -424,23 +802,22 @@ namespace lan
 		}
 		bool directory_item::rescan_needed()
 		{
+			// the events were lost, or a file was rewritten in place, which the folder's time does not show
+			if (m_stale)
+			{
+				log::info() << "Scan needed in " << m_path;
+				return true;
+			}
+
+			if (m_watched)
+				return false;
+
 			bool ret = m_last_scan != fs::last_write_time(m_path);
 			if (ret)
 				log::info() << "Scan needed in " << m_path;
 			return ret;
 		}
 
-		bool less(const fs::path& lhs, const fs::path& rhs)
-		{
-			bool lhs_dir = fs::is_directory(lhs);
-			bool rhs_dir = fs::is_directory(rhs);
-
-			if (lhs_dir != rhs_dir)
-				return lhs_dir; // directories before files
-
-			return lhs < rhs;
-		}
-
 		struct statistics
 		{
 			long long start;
@@ -524,27 +901,56 @@ namespace lan
 
 			log::info() << "Scanning " << m_path;
 
+			// watched before the listing, so nothing happening in between is missed
+			m_stale = false;
+			if (!m_watched)
+			{
+				std::weak_ptr<directory_item> weak = std::static_pointer_cast<directory_item>(shared_from_this());
+				m_watched = watcher::get().watch(m_path, [weak](watcher::names_t&& names)
+				{
+					auto self = weak.lock();
+					if (self)
+						self->changed(std::move(names));
+				});
+			}
+
 			m_last_scan = fs::last_write_time(m_path);
 
-			std::vector<std::pair<fs::path, int>> entries;
-			for (auto && file : contents(m_path))
-				entries.emplace_back(file.path(), 1);
+			// the listing comes sorted; the children know their kind without asking the disk
+			auto siblings = std::make_shared<siblings_t>();
+			std::vector<std::pair<dir_entry, int>> entries;
+			for (auto && entry : list_folder(m_path))
+			{
+				siblings->insert(entry.m_path.filename());
+				entries.emplace_back(entry, 1);
+			}
 
-			std::vector<std::pair<fs::path, av::items::media_item_ptr>> current;
-			for (auto && ptr : m_children)
-				current.emplace_back(get_path(ptr), ptr);
+			auto snapshot = children();
 
-			std::sort(entries.begin(), entries.end(), [](const std::pair<fs::path, int>& lhs, const std::pair<fs::path, int>& rhs) { return less(lhs.first, rhs.first); });
-			std::sort(current.begin(), current.end(), [](const std::pair<fs::path, av::items::media_item_ptr>& lhs, const std::pair<fs::path, av::items::media_item_ptr>& rhs) { return less(lhs.first, rhs.first); });
+			std::vector<std::pair<dir_entry, av::items::media_item_ptr>> current;
+			for (auto && ptr : *snapshot)
+				current.emplace_back(dir_entry(get_path(ptr), ptr->is_folder()), ptr);
+
+			std::sort(current.begin(), current.end(), [](const std::pair<dir_entry, av::items::media_item_ptr>& lhs, const std::pair<dir_entry, av::items::media_item_ptr>& rhs) { return lhs.first < rhs.first; });
 
 			auto entry = entries.begin();
 			auto curr = current.begin();
+			container_type rewritten;
 
 			while ((entry != entries.end()) && (curr != current.end()))
 			{
 				if (entry->first == curr->first)
 				{
-					entry->second = 0; // do not add
+					// a file written anew since the last scan (or since it was stored) is probed again
+					if (!curr->second->is_folder() && static_cast<path_item*>(curr->second.get())->changed())
+					{
+						rewritten.push_back(curr->second);
+					}
+					else
+					{
+						entry->second = 0; // do not add
+						curr->second->invalidate_output(); // but render it anew
+					}
 					curr->second = nullptr; // do not remove
 					++entry;
 					++curr;
@@ -559,20 +965,231 @@ namespace lan
 				}
 			}
 
+			container_type removed;
 			for (auto && curr : current)
 				if (curr.second)
-					remove_child(curr.second);
+					removed.push_back(curr.second);
+
+			// the ones, which stay, keep their places; the new ones go after them
+			container_type next;
+			next.reserve(snapshot->size() + entries.size());
+			for (auto && ptr : *snapshot)
+				if (std::find(removed.begin(), removed.end(), ptr) == removed.end())
+					next.push_back(ptr);
 
+			// with nothing to show yet, let the renderer see the items as they come
+			bool first_scan = snapshot->empty();
+
+			// shared with the probers, which may outlive this scan, if it throws
+			auto paths = std::make_shared<listing_t>();
+			container_type olds;
 			for (auto && entry : entries)
-				if (entry.second)
+			{
+				if (!entry.second)
+					continue;
+				paths->push_back(entry.first);
+
+				auto old = std::find_if(rewritten.begin(), rewritten.end(), [&](const av::items::media_item_ptr& ptr) { return get_path(ptr) == entry.first.m_path; });
+				olds.push_back(old == rewritten.end() ? nullptr : *old);
+			}
+
+			net::ulong pending = paths->size();
+			m_estimate = next.size() + pending;
+
+			// probed in parallel, taken in order
+			auto probed = std::make_shared<container_type>(paths->size());
+			auto device = m_device;
+			auto job = scanner::get().probe(m_ticket, paths->size(), [paths, siblings, probed, device](size_t index)
+			{
+				auto& entry = (*paths)[index];
+				sub_stat sub(entry.m_path);
+				(*probed)[index] = entry.m_folder ? from_folder(device, entry.m_path) : from_path(device, entry.m_path, siblings.get());
+			});
+
+			container_type added, batch;
+			for (size_t index = 0; index < paths->size(); ++index)
+			{
+				job->wait(index);
+				auto item = std::move((*probed)[index]);
+
+				// not every entry is a media file; the estimate follows the ratio seen so far
+				net::ulong seen = index + 1;
+				m_estimate = next.size() + (item ? 1 : 0) + (pending - seen) * (added.size() + (item ? 1 : 0)) / seen;
+
+				auto& old = olds[index];
+				if (old)
 				{
-					sub_stat sub(entry.first);
-					auto item = from_path(m_device, entry.first);
+					// stays where it was, under its own id
+					auto pos = std::find(next.begin(), next.end(), old);
+					removed.push_back(old);
 					if (item)
-						add_child(item);
+					{
+						take_place(item, old);
+						*pos = item;
+						added.push_back(item);
+					}
+					else
+						next.erase(pos);
+					continue;
 				}
 
-				log::info() << "Finished scanning " << m_path << "; found " << m_children.size() << " item(s)";
+				if (!item)
+					continue;
+
+				adopt(item);
+				next.push_back(item);
+				added.push_back(item);
+				batch.push_back(item);
+
+				if (first_scan && batch.size() >= PUBLISH_BATCH)
+				{
+					publish(container_type(next), batch, container_type());
+					batch.clear();
+				}
+			}
+
+			auto found = next.size();
+			publish(std::move(next), first_scan ? batch : added, removed);
+			catalog::get().save(m_path, added, removed);
+
+			for (auto && item : removed)
+			{
+				// the indexes and the library still know the items inside
+				auto folder = std::dynamic_pointer_cast<container_file>(item);
+				if (folder)
+					folder->forget_children();
+			}
+
+			// one update for the whole scan
+			if (!added.empty() || !removed.empty())
+				folder_changed();
+
+			log::info() << "Finished scanning " << m_path << "; found " << found << " item(s)";
+		}
+
+		void directory_item::changed(watcher::names_t&& names)
+		{
+			if (names.empty())
+			{
+				// the events were lost; everything is looked at again on the next Browse
+				m_stale = true;
+				folder_changed();
+				return;
+			}
+
+			if (!mark_start())
+			{
+				// the running scan might have listed the folder before these; they are looked at after it
+				{
+					std::lock_guard<std::mutex> lock(m_pending_guard);
+					m_pending.insert(m_pending.end(), names.begin(), names.end());
+				}
+
+				// ...unless it finished in the meantime, without seeing them
+				if (!is_running())
+					scan_finished();
+				return;
+			}
+
+			auto self = std::static_pointer_cast<directory_item>(shared_from_this());
+			auto list = std::make_shared<watcher::names_t>(std::move(names));
+			scanner::get().scan(m_ticket, [self, list]{
+				try
+				{
+					self->update(*list);
+				}
+				catch (std::exception& e)
+				{
+					log::error() << "Exception: " << e.what();
+				}
+				catch (...)
+				{
+					log::error() << "Unknown exception";
+				}
+
+				self->mark_stop();
+				self->scan_finished();
+			});
+		}
+
+		void directory_item::scan_finished()
+		{
+			watcher::names_t names;
+			{
+				std::lock_guard<std::mutex> lock(m_pending_guard);
+				names.swap(m_pending);
+			}
+
+			if (names.empty())
+				return;
+
+			std::sort(names.begin(), names.end());
+			names.erase(std::unique(names.begin(), names.end()), names.end());
+			changed(std::move(names));
+		}
+
+		void directory_item::update(const watcher::names_t& names)
+		{
+			log::info() << "Updating " << m_path << " (" << names.size() << " change(s))";
+
+			auto snapshot = children();
+			container_type next(*snapshot), added, removed;
+
+			for (auto && name : names)
+			{
+				auto path = m_path / name;
+				auto pos = std::find_if(next.begin(), next.end(), [&](const av::items::media_item_ptr& ptr) { return get_path(ptr) == path; });
+
+				boost::system::error_code ec;
+				bool exists = fs::exists(path, ec);
+
+				// a folder has a watch of its own for what happens inside
+				if (exists && pos != next.end() && (*pos)->is_folder())
+					continue;
+
+				av::items::media_item_ptr item;
+				if (exists)
+					item = from_path(m_device, path);
+
+				if (pos != next.end())
+				{
+					removed.push_back(*pos);
+					if (item)
+					{
+						take_place(item, *pos);
+						*pos = item;
+						added.push_back(item);
+					}
+					else
+						next.erase(pos);
+				}
+				else if (item)
+				{
+					adopt(item);
+					next.push_back(item);
+					added.push_back(item);
+				}
+			}
+
+			if (added.empty() && removed.empty())
+				return;
+
+			publish(std::move(next), added, removed);
+			catalog::get().save(m_path, added, removed);
+
+			for (auto && item : removed)
+			{
+				auto folder = std::dynamic_pointer_cast<container_file>(item);
+				if (folder)
+					folder->forget_children();
+			}
+
+			boost::system::error_code ec;
+			auto last_write = fs::last_write_time(m_path, ec);
+			if (!ec)
+				m_last_scan = last_write;
+
+			folder_changed();
 		}
 	}
 }
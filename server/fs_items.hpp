@@ -32,8 +32,14 @@
 #include <media_server.hpp>
 #include <boost/filesystem.hpp>
 #include <log.hpp>
+#include "scanner.hpp"
+#include "watcher.hpp"
 #include <mutex>
 #include <future>
+#include <atomic>
+#include <functional>
+#include <set>
+#include <vector>
 
 namespace fs = boost::filesystem;
 namespace av = net::ssdp::import::av;
@@ -49,28 +55,81 @@ namespace lan
 
 	namespace item
 	{
+		// what tells, if a file changed, without opening it
+		struct stamp
+		{
+			time_t    m_last_write;
+			uintmax_t m_size;  // 0 for folders
+			long long m_inode; // 0, where there is none
+			stamp() : m_last_write(0), m_size(0), m_inode(0) {}
+			stamp(time_t last_write, uintmax_t size, long long inode) : m_last_write(last_write), m_size(size), m_inode(inode) {}
+
+			static stamp of(const fs::path& path);
+			static stamp of(const fs::path& path, boost::system::error_code& ec);
+
+			bool operator == (const stamp& rhs) const { return m_last_write == rhs.m_last_write && m_size == rhs.m_size && m_inode == rhs.m_inode; }
+			bool operator != (const stamp& rhs) const { return !(*this == rhs); }
+		};
+
+		// a folder entry, with its kind taken from the listing itself and not from a stat of its own
+		struct dir_entry
+		{
+			fs::path m_path;
+			bool     m_folder;
+			dir_entry(const fs::path& path, bool folder) : m_path(path), m_folder(folder) {}
+
+			// folders before files, then by name
+			bool operator < (const dir_entry& rhs) const { return m_folder != rhs.m_folder ? m_folder : m_path < rhs.m_path; }
+			bool operator == (const dir_entry& rhs) const { return m_folder == rhs.m_folder && m_path == rhs.m_path; }
+		};
+
+		typedef std::vector<dir_entry> listing_t;
+		// the file names in a folder, so the sidecar covers are not looked for one by one
+		typedef std::set<fs::path> siblings_t;
+
+		// reads the folder once and sorts it; throws fs::filesystem_error
+		listing_t list_folder(const fs::path& path);
+
 		struct path_item : av::items::common_props_item
 		{
 			typedef av::items::media_type media_type;
 			path_item(av::MediaServer* device, const fs::path& path)
 				: av::items::common_props_item(device)
 				, m_path(path)
+				, m_stamp(stamp::of(path))
+			{
+				set_title(m_path.filename().string());
+				set_token(CRC().update(m_path.string()).str());
+			}
+			// restored from the catalog; the file is not even looked at
+			path_item(av::MediaServer* device, const fs::path& path, const stamp& known)
+				: av::items::common_props_item(device)
+				, m_path(path)
+				, m_stamp(known)
 			{
 				set_title(m_path.filename().string());
 				set_token(CRC().update(m_path.string()).str());
-				m_last_write = fs::last_write_time(m_path);
 			}
-			time_t     get_last_write_time() const override { return m_last_write; }
+			time_t     get_last_write_time() const override { return m_stamp.m_last_write; }
 			fs::path   get_path() const                     { return m_path; }
+			const stamp& get_stamp() const                  { return m_stamp; }
+			bool       changed() const;
 			void       set_cover(std::vector<char>&& data);
 			void       set_cover(const std::string& base64);
-			void       set_cover(const fs::path& cover)     { m_cover = media::from_file(cover, false); }
+			void       set_cover(const fs::path& cover)     { m_cover_path = cover; m_cover = media::from_file(cover, false); }
+			void       set_cover(const fs::path& cover, const net::dlna::Profile& profile) { m_cover_path = cover; m_cover = media::from_file(cover, profile, false); }
+			// the picture is read, when it is asked for the first time
+			void       set_cover(const net::dlna::Profile& profile, const std::function<std::string ()>& base64);
 			media_ptr  get_cover() const                    { return m_cover; }
+			fs::path   get_cover_path() const               { return m_cover_path; }
+			// the picture found inside of the file, if it is already read
+			bool       get_cover_data(std::string& base64) const;
 
 		protected:
 			fs::path   m_path;
 			media_ptr  m_cover;
-			time_t     m_last_write;
+			fs::path   m_cover_path;
+			stamp      m_stamp;
 		};
 
 		struct common_file : path_item
@@ -79,6 +138,10 @@ namespace lan
 				: path_item(device, path)
 			{
 			}
+			common_file(av::MediaServer* device, const fs::path& path, const stamp& known)
+				: path_item(device, path, known)
+			{
+			}
 			container_type list(net::ulong /*start_from*/, net::ulong /*max_count*/)       override { return container_type(); }
 			net::ulong     predict_count(net::ulong served) const                          override { return served; }
 			net::ulong     update_id() const                                               override { return 0; }
@@ -91,11 +154,20 @@ namespace lan
 		struct ffmpeg_file : common_file
 		{
 			net::dlna::Item m_item;
+			media_ptr m_main;
 			ffmpeg_file(av::MediaServer* device, const fs::path& path, const net::dlna::Item& item)
 				: common_file(device, path)
 				, m_item(item)
+				, m_main(item.m_profile.m_mime ? media::from_file(path, item.m_profile, true) : nullptr)
+			{
+			}
+			ffmpeg_file(av::MediaServer* device, const fs::path& path, const net::dlna::Item& item, const stamp& known)
+				: common_file(device, path, known)
+				, m_item(item)
+				, m_main(item.m_profile.m_mime ? media::from_file(path, item.m_profile, true) : nullptr)
 			{
 			}
+			media_ptr get_media(media_type type) const override;
 			const char* get_upnp_class() const override
 			{
 				switch (m_item.m_class)
@@ -135,41 +207,108 @@ namespace lan
 				}
 			};
 
+			typedef std::function<void ()> ready_type;
+
+			struct container_waiter
+			{
+				net::ulong m_start_from;
+				net::ulong m_max_count;
+				ready_type m_ready;
+				container_waiter(net::ulong start_from, net::ulong max_count, const ready_type& ready)
+					: m_start_from(start_from)
+					, m_max_count(max_count)
+					, m_ready(ready)
+				{
+				}
+			};
+
+			typedef std::shared_ptr<const container_type> snapshot_ptr;
+
 			container_file(av::MediaServer* device, const fs::path& path)
 				: path_item(device, path)
+				, m_current_max(0)
+				, m_children(std::make_shared<container_type>())
 				, m_update_id(1)
+				, m_estimate(0)
+				, m_ticket(std::make_shared<scanner::ticket>())
+				, m_running(false)
+				, m_scanned(false)
+			{
+			}
+			container_file(av::MediaServer* device, const fs::path& path, const stamp& known)
+				: path_item(device, path, known)
 				, m_current_max(0)
+				, m_children(std::make_shared<container_type>())
+				, m_update_id(1)
+				, m_estimate(0)
+				, m_ticket(std::make_shared<scanner::ticket>())
 				, m_running(false)
+				, m_scanned(false)
 			{
 			}
 
 			container_type list(net::ulong start_from, net::ulong max_count)               override;
+			container_type sorted_list(net::ulong start_from, net::ulong max_count,
+			                           const av::sorting::criteria& order)                 override;
 			net::ulong     predict_count(net::ulong served) const                          override;
+			bool           wait_for(net::ulong start_from, net::ulong max_count,
+			                        const ready_type& ready)                               override;
+			container_type peek(net::ulong start_from, net::ulong max_count)               override;
 			net::ulong     update_id() const                                               override { return (net::ulong)m_update_id; }
 			item_ptr       get_item(const std::string& id)                                 override;
 			bool           is_image() const                                                override { return false; }
 			bool           is_folder() const                                               override { return true; }
-			size_t         child_count() const                                             override { return m_children.size(); }
+			size_t         child_count() const                                             override { return children()->size(); }
 			const char*    get_upnp_class() const                                          override { return "object.container.storageFolder"; }
 			media_ptr      get_media(media_type type) const                                override;
 
 			void           rescan_if_needed();
+			// the children from the catalog; shown at once, as if they were scanned
+			void           restore(container_type&& children);
+			// scans the folder behind everything, that was asked for
+			void           verify();
 			virtual bool   rescan_needed()         { return false; }
 			virtual void   rescan()                {}
+			// on the scanner's thread, once the folder is let go by the scan
+			virtual void   scan_finished()         {}
 			virtual void   folder_changed();
 			virtual void   add_child(item_ptr);
 			virtual void   remove_child(item_ptr);
+			void           forget_children();
+
+			// the current children; never changes, a new list is published instead
+			snapshot_ptr   children() const        { return std::atomic_load(&m_children); }
 
 		private:
 			net::ulong m_current_max;
 
 		protected:
-			std::vector<av::items::media_item_ptr> m_children;
-			time_t m_update_id;
+			/*
+			 * Readers take the snapshot without any lock. Writers hold the
+			 * m_guard, build the next list and swap it in with one
+			 * atomic_store.
+			 */
+			snapshot_ptr m_children;
+			av::sorting::permutations m_sorted;
+			std::atomic<time_t> m_update_id;
+			// the expected number of children, while the first scan is still going
+			std::atomic<net::ulong> m_estimate;
+			scanner::ticket_ptr m_ticket;
 			std::list<container_task> m_tasks;
+			std::list<container_waiter> m_waiters;
 			bool m_running;
+			bool m_scanned;
 			mutable std::mutex m_guard;
 
+			void        adopt(const item_ptr& child);
+			// a file written anew keeps the place and the id of the old one
+			void        take_place(const item_ptr& child, const item_ptr& old);
+			void        queue_scan();
+			void        publish(container_type&& next, const container_type& added, const container_type& removed);
+			// the next list is built from the current one under the m_guard; false leaves the list as it is
+			typedef std::function<bool (const container_type& current, container_type& next, container_type& added, container_type& removed)> transform_type;
+			void        publish(const transform_type& transform);
+
 			bool mark_start()
 			{
 				std::lock_guard<std::mutex> lock(m_guard);
@@ -180,14 +319,25 @@ namespace lan
 			}
 			void mark_stop()
 			{
-				std::lock_guard<std::mutex> lock(m_guard);
-				m_running = false;
-				fulfill_promises(true);
+				std::vector<ready_type> ready;
+				{
+					std::lock_guard<std::mutex> lock(m_guard);
+					m_running = false;
+					m_scanned = true;
+					ready = fulfill_promises(true);
+				}
+
+				for (auto && call : ready)
+					call();
 			}
 			bool        is_running() const { return m_running; }
+			// only a folder scanned for the first time has nothing to show yet
+			bool        must_wait() const  { return m_running && !m_scanned; }
+			bool        has_page(net::ulong start_from, net::ulong max_count) const;
 			future_type async_list(net::ulong start_from, net::ulong max_count);
 			void        fill_request(async_promise_type promise, net::ulong start_from, net::ulong max_count);
-			void        fulfill_promises(bool forced);
+			// the waiters are called by the caller, after the m_guard is released
+			std::vector<ready_type> fulfill_promises(bool forced);
 		};
 
 		struct directory_item : container_file
@@ -195,20 +345,28 @@ namespace lan
 			directory_item(av::MediaServer* device, const fs::path& path)
 				: container_file(device, path)
 				, m_last_scan(0)
+				, m_watched(false)
+				, m_stale(false)
+			{
+			}
+			directory_item(av::MediaServer* device, const fs::path& path, const stamp& known)
+				: container_file(device, path, known)
+				, m_last_scan(0)
+				, m_watched(false)
+				, m_stale(false)
 			{
 			}
 
 			void check_updates() override;
 			bool rescan_needed() override;
 			void rescan()        override;
+			void scan_finished() override;
 
-			struct contents
-			{
-				fs::path m_path;
-				contents(const fs::path& path) : m_path(path) {}
-				fs::directory_iterator begin() const { return fs::directory_iterator(m_path); }
-				fs::directory_iterator end() const { return fs::directory_iterator(); }
-			};
+			// called by the watcher, with the names, which changed since the last time
+			void changed(watcher::names_t&& names);
+			void update(const watcher::names_t& names);
+
+			enum { PUBLISH_BATCH = 32 };
 
 			static fs::path get_path(const av::items::media_item_ptr& ptr)
 			{
@@ -218,10 +376,19 @@ namespace lan
 				return static_cast<path_item*>(ptr.get())->get_path();
 			}
 		private:
-			time_t m_last_scan;
+			std::atomic<time_t> m_last_scan;
+			// a watched folder is told about its changes and does not need to look
+			std::atomic<bool> m_watched;
+			std::atomic<bool> m_stale;
+			// the changes, which came while the folder was being scanned
+			std::mutex m_pending_guard;
+			watcher::names_t m_pending;
 		};
 
-		av::items::media_item_ptr from_path(const fs::path& path);
+		av::items::media_item_ptr from_path(av::MediaServer* device, const fs::path& path);
+		// the siblings, if known, tell which of the cover files exist
+		av::items::media_item_ptr from_path(av::MediaServer* device, const fs::path& path, const siblings_t* siblings);
+		av::items::media_item_ptr from_folder(av::MediaServer* device, const fs::path& path);
 	}
 }
 
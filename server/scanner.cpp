@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "scanner.hpp"
+#include "fs_items.hpp"
+#include <algorithm>
+#include <thread>
+#include <threads.hpp>
+
+namespace lan
+{
+	scanner& scanner::get()
+	{
+		// never destroyed: the threads are detached and may still wait on it at exit
+		static scanner* instance = new scanner();
+		return *instance;
+	}
+
+	void scanner::start(size_t listers, size_t probers)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_guard);
+			if (m_started)
+				return;
+			m_started = true;
+		}
+
+		if (!listers)
+			listers = 1;
+		if (!probers)
+			probers = std::max(std::thread::hardware_concurrency(), 1u);
+
+		log::info() << "Scanning with " << listers << " lister(s) and " << probers << " prober(s)";
+
+		for (size_t i = 0; i < listers; ++i)
+		{
+			std::thread([this, i]
+			{
+				threads::set_name("I/O Thread #" + std::to_string(i));
+				while (true)
+					list_next();
+			}).detach();
+		}
+
+		for (size_t i = 0; i < probers; ++i)
+		{
+			std::thread([this, i]
+			{
+				threads::set_name("Probe Thread #" + std::to_string(i));
+				while (true)
+					probe_next();
+			}).detach();
+		}
+	}
+
+	void scanner::bump(const ticket_ptr& ticket)
+	{
+		ticket->m_priority = ++m_clock;
+	}
+
+	void scanner::scan(const ticket_ptr& ticket, const task_type& task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_guard);
+			m_folders.push_back(folder_task { ticket, task });
+		}
+		m_folders_cv.notify_one();
+	}
+
+	scanner::probe_job_ptr scanner::probe(const ticket_ptr& ticket, size_t count, const probe_type& probe)
+	{
+		auto job = std::make_shared<probe_job>(ticket, count, probe);
+		if (!count)
+			return job;
+
+		{
+			std::lock_guard<std::mutex> lock(m_guard);
+			m_probes.push_back(job);
+		}
+		m_probes_cv.notify_all();
+		return job;
+	}
+
+	void scanner::list_next()
+	{
+		folder_task next;
+		{
+			std::unique_lock<std::mutex> lock(m_guard);
+			m_folders_cv.wait(lock, [this] { return !m_folders.empty(); });
+
+			// a handful of folders at a time, at most; no need for a heap
+			auto it = std::max_element(m_folders.begin(), m_folders.end(), [](const folder_task& lhs, const folder_task& rhs)
+			{
+				return lhs.m_ticket->m_priority < rhs.m_ticket->m_priority;
+			});
+
+			next = std::move(*it);
+			m_folders.erase(it);
+		}
+
+		try
+		{
+			next.m_task();
+		}
+		catch (std::exception& e)
+		{
+			log::error() << "Exception: " << e.what();
+		}
+		catch (...)
+		{
+			log::error() << "Unknown exception";
+		}
+	}
+
+	void scanner::probe_next()
+	{
+		probe_job_ptr job;
+		size_t index = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_guard);
+			m_probes_cv.wait(lock, [this] { return !m_probes.empty(); });
+
+			auto it = std::max_element(m_probes.begin(), m_probes.end(), [](const probe_job_ptr& lhs, const probe_job_ptr& rhs)
+			{
+				return lhs->m_ticket->m_priority < rhs->m_ticket->m_priority;
+			});
+
+			job = *it;
+			index = job->m_next++;
+			if (job->m_next == job->m_count)
+				m_probes.erase(it);
+		}
+
+		job->run(index);
+	}
+
+	void scanner::probe_job::run(size_t index)
+	{
+		try
+		{
+			m_probe(index);
+		}
+		catch (std::exception& e)
+		{
+			log::error() << "Exception: " << e.what();
+		}
+		catch (...)
+		{
+			log::error() << "Unknown exception";
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_guard);
+			m_done[index] = true;
+		}
+		m_cv.notify_all();
+	}
+
+	void scanner::probe_job::wait(size_t index)
+	{
+		std::unique_lock<std::mutex> lock(m_guard);
+		m_cv.wait(lock, [this, index] { return m_done[index]; });
+	}
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SCANNER_HPP__
+#define __SCANNER_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lan
+{
+	/*
+	 * The scans of the whole server, run by two fixed groups of threads.
+	 * The listers walk the folders, one folder scan at a time each; the
+	 * probers open the files found, which is where the CPU goes. Both
+	 * pick up the work of the folder wanted most recently first: every
+	 * Browse bumps the ticket of the folder looked at.
+	 */
+	class scanner
+	{
+	public:
+		typedef std::function<void ()> task_type;
+		typedef std::function<void (size_t)> probe_type;
+
+		struct ticket
+		{
+			std::atomic<unsigned long> m_priority;
+			ticket() : m_priority(0) {}
+		};
+		typedef std::shared_ptr<ticket> ticket_ptr;
+
+		/*
+		 * The probes of one folder. They run in parallel, but the
+		 * lister consumes them in the original order, waiting for each
+		 * one in turn; this keeps the order of the children stable.
+		 */
+		class probe_job
+		{
+			friend class scanner;
+
+			ticket_ptr m_ticket;
+			probe_type m_probe;
+			size_t m_count;
+			size_t m_next; // guarded by the scanner
+			std::vector<bool> m_done;
+			std::mutex m_guard;
+			std::condition_variable m_cv;
+
+			void run(size_t index);
+		public:
+			probe_job(const ticket_ptr& ticket, size_t count, const probe_type& probe)
+				: m_ticket(ticket)
+				, m_probe(probe)
+				, m_count(count)
+				, m_next(0)
+				, m_done(count, false)
+			{
+			}
+
+			void wait(size_t index);
+		};
+		typedef std::shared_ptr<probe_job> probe_job_ptr;
+
+		static scanner& get();
+
+		// 0 probers means one for each core
+		void start(size_t listers, size_t probers);
+
+		// the renderer looks at this folder (again)
+		void bump(const ticket_ptr& ticket);
+		// queued with the ticket as it is; a folder never bumped waits for all the others
+		void scan(const ticket_ptr& ticket, const task_type& task);
+		probe_job_ptr probe(const ticket_ptr& ticket, size_t count, const probe_type& probe);
+
+	private:
+		struct folder_task
+		{
+			ticket_ptr m_ticket;
+			task_type m_task;
+		};
+
+		scanner() : m_clock(0), m_started(false) {}
+
+		void list_next();
+		void probe_next();
+
+		std::atomic<unsigned long> m_clock;
+		bool m_started;
+		std::mutex m_guard;
+		std::condition_variable m_folders_cv;
+		std::condition_variable m_probes_cv;
+		std::vector<folder_task> m_folders;
+		std::vector<probe_job_ptr> m_probes;
+	};
+}
+
+#endif // __SCANNER_HPP__
@@ -35,7 +35,7 @@ namespace db
 #define SQLITE(ev) if (!(ev)) { log::error() << db()->errorMessage(); return err_value; }
 #define SQLITE_(ev, db) if (!(ev)) { log::error() << (db)->errorMessage(); return err_value; }
 
-	enum { DB_VERSION = 1 };
+	enum { DB_VERSION = 2 };
 	schema::schema()
 		: database_helper("data.ini", DB_VERSION)
 	{
@@ -60,6 +60,12 @@ namespace db
 			if (!run(db(), schema_v1_sql))
 				return false;
 		}
+		if (current_version < 2)
+		{
+#include "schema_v2_sql.hpp"
+			if (!run(db(), schema_v2_sql))
+				return false;
+		}
 		return true;
 	}
 
@@ -128,4 +134,273 @@ namespace db
 		return c->getLongLong(0);
 	}
 
+	long long schema::folder_id(const boost::filesystem::path& folder) const
+	{
+		auto tmp = normalize(folder);
+
+		BEGIN_TRANSACTION(db());
+
+		auto here = file_id(tmp);
+		if (here != -1)
+			RETURN_AND_COMMIT(here);
+
+		auto parent = tmp.parent_path();
+		if (parent.empty() || parent == tmp)
+			return -1;
+
+		auto parent_id = folder_id(parent);
+		if (parent_id == -1)
+			return -1;
+
+		RETURN_AND_COMMIT(add_file(tmp, parent_id));
+		END_TRANSACTION_RETURN(-1);
+	}
+
+	static inline std::string text(const db::cursor_ptr& c, int column)
+	{
+		return c->isNull(column) ? std::string() : c->getText(column);
+	}
+
+	static inline bool bind_text(const db::statement_ptr& query, int arg, const std::string& value)
+	{
+		return value.empty() ? query->bindNull(arg) : query->bind(arg, value.c_str());
+	}
+
+	bool schema::scanned(long long folder) const
+	{
+		bool err_value = false;
+		BEGIN_TRANSACTION(db());
+
+		auto query = db()->prepare("SELECT scanned FROM entries WHERE _id=?");
+		SQLITE(query && query->bind(0, folder));
+
+		auto c = query->query();
+		RETURN_AND_COMMIT(c && c->next() && c->getInt(0) != 0);
+		END_TRANSACTION_RETURN(err_value);
+	}
+
+	bool schema::children(long long parent, std::vector<entry>& rows) const
+	{
+		bool err_value = false;
+		BEGIN_TRANSACTION(db());
+
+		auto query = db()->prepare(
+			"SELECT e._id, e.parent, e.filepath, e.item_class, e.inode, e.org_pn, e.mime, "
+			"e.title, e.artist, e.album_artist, e.composer, e.album, e.genre, e.date, e.comment, e.track, "
+			"e.last_write_time, e.size, e.bitrate, e.duration, e.sample_freq, e.channels, e.width, e.height, e.bps, "
+			"c.path, c.org_pn, c.mime, c.data IS NOT NULL, e.scanned "
+			"FROM entries AS e LEFT JOIN covers AS c ON c.entry_id = e._id "
+			"WHERE e.parent=? AND e._id > 0 ORDER BY e._id"
+			);
+		SQLITE(query && query->bind(0, parent));
+
+		auto c = query->query();
+		SQLITE(c);
+
+		while (c->next())
+		{
+			entry row;
+			row.m_id                    = c->getLongLong(0);
+			row.m_parent                = c->getLongLong(1);
+			row.m_path                  = text(c, 2);
+			row.m_class                 = (net::dlna::Class) c->getInt(3);
+			row.m_inode                 = c->getLongLong(4);
+			row.m_profile               = text(c, 5);
+			row.m_mime                  = text(c, 6);
+			row.m_meta.m_title          = text(c, 7);
+			row.m_meta.m_artist         = text(c, 8);
+			row.m_meta.m_album_artist   = text(c, 9);
+			row.m_meta.m_composer       = text(c, 10);
+			row.m_meta.m_album          = text(c, 11);
+			row.m_meta.m_genre          = text(c, 12);
+			row.m_meta.m_date           = text(c, 13);
+			row.m_meta.m_comment        = text(c, 14);
+			row.m_meta.m_track          = c->getInt(15);
+			row.m_props.m_last_write_time = (time_t) c->getLongLong(16);
+			row.m_props.m_size          = (net::dlna::size_t) c->getLongLong(17);
+			row.m_props.m_bitrate       = c->getLong(18);
+			row.m_props.m_duration      = c->getLong(19);
+			row.m_props.m_sample_freq   = c->getLong(20);
+			row.m_props.m_channels      = c->getLong(21);
+			row.m_props.m_width         = c->getLong(22);
+			row.m_props.m_height        = c->getLong(23);
+			row.m_props.m_bps           = c->getLong(24);
+			row.m_cover_path            = text(c, 25);
+			row.m_cover_profile         = text(c, 26);
+			row.m_cover_mime            = text(c, 27);
+			row.m_cover_stored          = !c->isNull(26) && c->getInt(28) != 0;
+			row.m_scanned               = c->getInt(29) != 0;
+
+			if (!row.m_path.empty())
+				rows.push_back(std::move(row));
+		}
+
+		RETURN_AND_COMMIT(true);
+		END_TRANSACTION_RETURN(err_value);
+	}
+
+	bool schema::store(const boost::filesystem::path& folder, std::vector<entry>& rows, const std::vector<boost::filesystem::path>& removed) const
+	{
+		bool err_value = false;
+		BEGIN_TRANSACTION(db());
+
+		auto parent = folder_id(folder);
+		if (parent == -1)
+			return false;
+
+		for (auto && file : removed)
+		{
+			if (!remove(file))
+				return false;
+		}
+
+		for (auto && row : rows)
+		{
+			row.m_parent = parent;
+			row.m_id = store(row);
+			if (row.m_id == -1)
+				return false;
+		}
+
+		auto query = db()->prepare("UPDATE entries SET scanned=1 WHERE _id=?");
+		SQLITE(query && query->bind(0, parent) && query->execute());
+
+		RETURN_AND_COMMIT(true);
+		END_TRANSACTION_RETURN(err_value);
+	}
+
+	long long schema::store(const entry& row) const
+	{
+		long long err_value = -1;
+		BEGIN_TRANSACTION(db());
+
+		auto path = normalize(row.m_path);
+		auto id = file_id(path);
+
+		auto query = id == -1
+			? db()->prepare(
+				"INSERT INTO entries (parent, item_class, inode, org_pn, mime, "
+				"title, artist, album_artist, composer, album, genre, date, comment, track, "
+				"last_write_time, size, bitrate, duration, sample_freq, channels, width, height, bps, filepath) "
+				"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)")
+			: db()->prepare(
+				"UPDATE entries SET parent=?, item_class=?, inode=?, org_pn=?, mime=?, "
+				"title=?, artist=?, album_artist=?, composer=?, album=?, genre=?, date=?, comment=?, track=?, "
+				"last_write_time=?, size=?, bitrate=?, duration=?, sample_freq=?, channels=?, width=?, height=?, bps=? "
+				"WHERE _id=?");
+		SQLITE(query);
+
+		SQLITE(query->bind(0, row.m_parent));
+		SQLITE(query->bind(1, (int) row.m_class));
+		SQLITE(query->bind(2, row.m_inode));
+		SQLITE(bind_text(query, 3, row.m_profile));
+		SQLITE(bind_text(query, 4, row.m_mime));
+		SQLITE(query->bind(5, row.m_meta.m_title.c_str()));
+		SQLITE(bind_text(query, 6, row.m_meta.m_artist));
+		SQLITE(bind_text(query, 7, row.m_meta.m_album_artist));
+		SQLITE(bind_text(query, 8, row.m_meta.m_composer));
+		SQLITE(bind_text(query, 9, row.m_meta.m_album));
+		SQLITE(bind_text(query, 10, row.m_meta.m_genre));
+		SQLITE(bind_text(query, 11, row.m_meta.m_date));
+		SQLITE(bind_text(query, 12, row.m_meta.m_comment));
+		SQLITE(query->bind(13, (long long) row.m_meta.m_track));
+		SQLITE(query->bind(14, (long long) row.m_props.m_last_write_time));
+		SQLITE(query->bind(15, (long long) row.m_props.m_size));
+		SQLITE(query->bind(16, (long long) row.m_props.m_bitrate));
+		SQLITE(query->bind(17, (long long) row.m_props.m_duration));
+		SQLITE(query->bind(18, (long long) row.m_props.m_sample_freq));
+		SQLITE(query->bind(19, (long long) row.m_props.m_channels));
+		SQLITE(query->bind(20, (long long) row.m_props.m_width));
+		SQLITE(query->bind(21, (long long) row.m_props.m_height));
+		SQLITE(query->bind(22, (long long) row.m_props.m_bps));
+		if (id == -1)
+		{
+			SQLITE(query->bind(23, path.string().c_str()));
+		}
+		else
+		{
+			SQLITE(query->bind(23, id));
+		}
+
+		SQLITE(query->execute());
+
+		if (id == -1)
+			id = db()->last_rowid();
+
+		auto covers = db()->prepare("DELETE FROM covers WHERE entry_id=?");
+		SQLITE(covers && covers->bind(0, id) && covers->execute());
+
+		if (!row.m_cover_path.empty() || !row.m_cover_data.empty())
+		{
+			covers = db()->prepare("INSERT INTO covers (entry_id, org_pn, mime, width, height, path, data) VALUES (?, ?, ?, 0, 0, ?, ?)");
+			SQLITE(covers);
+			SQLITE(covers->bind(0, id));
+			SQLITE(covers->bind(1, row.m_cover_profile.c_str()));
+			SQLITE(covers->bind(2, row.m_cover_mime.c_str()));
+			SQLITE(bind_text(covers, 3, row.m_cover_path));
+			SQLITE(bind_text(covers, 4, row.m_cover_data));
+			SQLITE(covers->execute());
+		}
+
+		RETURN_AND_COMMIT(id);
+		END_TRANSACTION_RETURN(err_value);
+	}
+
+	bool schema::remove(const boost::filesystem::path& file) const
+	{
+		BEGIN_TRANSACTION(db());
+
+		auto id = file_id(normalize(file));
+		if (id == -1)
+			RETURN_AND_COMMIT(true);
+
+		RETURN_AND_COMMIT(remove(id));
+		END_TRANSACTION_RETURN(false);
+	}
+
+	bool schema::remove(long long id) const
+	{
+		bool err_value = false;
+		BEGIN_TRANSACTION(db());
+
+		std::vector<long long> inside;
+		{
+			auto query = db()->prepare("SELECT _id FROM entries WHERE parent=? AND _id > 0");
+			SQLITE(query && query->bind(0, id));
+			auto c = query->query();
+			while (c && c->next())
+				inside.push_back(c->getLongLong(0));
+		}
+
+		for (auto && child : inside)
+		{
+			if (!remove(child))
+				return false;
+		}
+
+		auto query = db()->prepare("DELETE FROM covers WHERE entry_id=?");
+		SQLITE(query && query->bind(0, id) && query->execute());
+		query = db()->prepare("DELETE FROM entries WHERE _id=?");
+		SQLITE(query && query->bind(0, id) && query->execute());
+
+		RETURN_AND_COMMIT(true);
+		END_TRANSACTION_RETURN(err_value);
+	}
+
+	std::string schema::cover_data(const boost::filesystem::path& file) const
+	{
+		std::string err_value;
+		BEGIN_TRANSACTION(db());
+
+		auto query = db()->prepare("SELECT c.data FROM covers AS c JOIN entries AS e ON e._id = c.entry_id WHERE e.filepath=?");
+		SQLITE(query && query->bind(0, normalize(file).string().c_str()));
+
+		auto c = query->query();
+		if (!c || !c->next())
+			return err_value;
+
+		RETURN_AND_COMMIT(text(c, 0));
+		END_TRANSACTION_RETURN(err_value);
+	}
+
 }
\ No newline at end of file
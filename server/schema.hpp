@@ -28,9 +28,48 @@
 #include <dbconn.hpp>
 #include <dbconn_driver.hpp>
 #include <boost/filesystem.hpp>
+#include <dlna_media.hpp>
+#include <vector>
 
 namespace db
 {
+	/*
+	 * One row of the entries, with its cover. The cover is either a file
+	 * next to the media (m_cover_path), or a picture found inside of it
+	 * and kept in the covers table; the picture itself is only read, when
+	 * it is asked for.
+	 */
+	struct entry
+	{
+		long long m_id;
+		long long m_parent;
+		boost::filesystem::path m_path;
+		net::dlna::Class m_class;
+		long long m_inode;
+		bool m_scanned; // a folder with its children stored
+		std::string m_profile; // ORG_PN
+		std::string m_mime;
+		net::dlna::ItemMetadata m_meta;
+		net::dlna::ItemProperties m_props;
+
+		std::string m_cover_path;
+		std::string m_cover_profile;
+		std::string m_cover_mime;
+		std::string m_cover_data; // base64; only when stored, never when loaded
+		bool m_cover_stored;
+
+		entry()
+			: m_id(-1)
+			, m_parent(-1)
+			, m_class(net::dlna::Class::Unknown)
+			, m_inode(0)
+			, m_scanned(false)
+			, m_cover_stored(false)
+		{
+			m_meta.clear();
+		}
+	};
+
 	class schema: public database_helper
 	{
 	public:
@@ -39,9 +78,22 @@ namespace db
 		long long add_root(const boost::filesystem::path& file) const;
 		long long add_file(const boost::filesystem::path& file) const;
 		long long file_id(const boost::filesystem::path& file) const;
+
+		bool scanned(long long folder) const;
+		bool children(long long parent, std::vector<entry>& rows) const;
+		// the results of one scan of the folder, in one transaction
+		bool store(const boost::filesystem::path& folder, std::vector<entry>& rows, const std::vector<boost::filesystem::path>& removed) const;
+		std::string cover_data(const boost::filesystem::path& file) const;
 	protected:
 		long long add_file(const boost::filesystem::path& file, long long parent) const;
 		bool upgrade_schema(int current_version, int new_version) override;
+		// the id of the folder, with the folders above it up to the closest one known
+		long long folder_id(const boost::filesystem::path& folder) const;
+		// inserts or updates the row of the m_path; a known file keeps its _id
+		long long store(const entry& row) const;
+		// the file and, if it was a folder, everything inside of it
+		bool remove(const boost::filesystem::path& file) const;
+		bool remove(long long id) const;
 	};
 }
 
@@ -0,0 +1,9 @@
+ALTER TABLE entries ADD COLUMN inode INTEGER NOT NULL DEFAULT(0);
+-- a folder, which has its children stored
+ALTER TABLE entries ADD COLUMN scanned INTEGER NOT NULL DEFAULT(0);
+ALTER TABLE covers ADD COLUMN path TEXT;
+ALTER TABLE covers ADD COLUMN data TEXT;
+
+-- the children are read by their parent, the scan results are matched by their path
+CREATE INDEX entries_parent ON entries(parent);
+CREATE UNIQUE INDEX entries_filepath ON entries(filepath);
@@ -37,6 +37,8 @@
 #include "postmortem.hpp"
 #include <dlna_media.hpp>
 #include "schema.hpp"
+#include "scanner.hpp"
+#include "catalog.hpp"
 
 #include <sqlite3.hpp>
 REGISTER_DRIVER("sqlite", db::sqlite3::sqlite3_driver);
@@ -194,8 +196,9 @@ int main(int argc, char* argv [])
 		dbg::postmortem guard;
 		signal(SIGABRT, onabort);
 
-		db::schema data;
-		if (!data.open())
+		// shared with the scans, which may still be running, when main is left
+		auto data = std::make_shared<db::schema>();
+		if (!data->open())
 		{
 			lan::log::error() << "Database not opened.";
 			return 1;
@@ -212,8 +215,14 @@ int main(int argc, char* argv [])
 		auto config = net::config::config::from_file("lanradio.conf");
 		set_terminal_title(config);
 
+		lan::scanner::get().start(std::max((int) config->listers, 0), std::max((int) config->probers, 0));
+		lan::catalog::get().open(data);
+
 		auto server = std::make_shared<av::MediaServer>(info, config);
 
+		// grows as the folders below are scanned
+		server->add_root_element(server->library());
+
 		for (int arg = 1; arg < argc; ++arg)
 		{
 			auto path = fs::absolute(argv[arg]);
@@ -222,7 +231,13 @@ int main(int argc, char* argv [])
 
 			if (fs::is_directory(path) && path.filename() == ".")
 				path = path.parent_path();
-			auto item = lan::item::from_path(server.get(), path);
+
+			// what was found the last time is shown at once; the scans only catch up
+			av::items::media_item_ptr item;
+			if (fs::is_directory(path))
+				item = lan::catalog::get().restore(server.get(), path);
+			if (!item)
+				item = lan::item::from_path(server.get(), path);
 			if (item)
 			{
 				lan::log::info() << "Adding " << path;
@@ -255,6 +270,7 @@ int main(int argc, char* argv [])
 		lan::radio lanRadio(server, config);
 
 		lanRadio.run();
+		lan::catalog::get().close();
 #if defined(DBG_ALLOCS)
 		lan::memlog::info() << all_allocs;
 #endif
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __WATCHER_HPP__
+#define __WATCHER_HPP__
+
+#include <boost/filesystem.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace lan
+{
+	/*
+	 * Tells the scanned folders about their changes, so they can be
+	 * updated a file at a time, instead of being listed again. A burst of
+	 * events, like an album being copied, is collected until the folder
+	 * stays quiet for a while and then reported once, as the names which
+	 * changed; the folder looks at each of them to see, what happened.
+	 * An empty list means, the events were lost and the folder needs
+	 * a full rescan. Where there is nothing to watch with, watch()
+	 * returns false and the folder polls its last write time instead.
+	 */
+	class watcher
+	{
+	public:
+		typedef std::vector<std::string> names_t;
+		typedef std::function<void (names_t&& names)> listener_t;
+
+		enum
+		{
+			QUIET_MS = 500,      // a burst ends after this much silence...
+			MAX_DELAY_MS = 5000  // ...or after this long, whichever comes first
+		};
+
+		static watcher& get();
+
+		bool watch(const boost::filesystem::path& dir, const listener_t& listener);
+
+		struct impl;
+	private:
+		watcher();
+		impl* pimpl;
+	};
+}
+
+#endif // __WATCHER_HPP__
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "watcher.hpp"
+#include "fs_items.hpp"
+#include <threads.hpp>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace lan
+{
+	struct watcher::impl
+	{
+		typedef std::chrono::steady_clock clock;
+		typedef std::map<int, std::set<std::string>> pending_t;
+
+		// a moved folder keeps its watch; the parent reports the move, and the folder
+		// under the new name gets the same descriptor, with its own listener
+		static const uint32_t MASK =
+			IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+		struct watched
+		{
+			boost::filesystem::path m_path;
+			listener_t m_listener;
+		};
+
+		int m_fd;
+		std::mutex m_guard;
+		std::unordered_map<int, watched> m_watches;
+
+		impl()
+			: m_fd(inotify_init1(IN_CLOEXEC))
+		{
+			if (m_fd < 0)
+			{
+				log::warning() << "No inotify (" << strerror(errno) << "), the folders will be polled";
+				return;
+			}
+
+			std::thread([this]
+			{
+				threads::set_name("Watcher");
+				run();
+			}).detach();
+		}
+
+		// the watch is taken on these, but the changes made by the other hosts are never reported
+		static bool remote(const boost::filesystem::path& dir)
+		{
+			static const unsigned long magic [] = {
+				0x6969,     // NFS_SUPER_MAGIC
+				0x517B,     // SMB_SUPER_MAGIC
+				0xFF534D42, // CIFS_MAGIC_NUMBER
+				0xFE534D42, // SMB2_MAGIC_NUMBER
+				0x65735546, // FUSE_SUPER_MAGIC
+				0x01021997, // V9FS_MAGIC
+				0x00C36400, // CEPH_SUPER_MAGIC
+				0x73757245, // CODA_SUPER_MAGIC
+				0x5346414F, // AFS_SUPER_MAGIC
+			};
+
+			struct statfs info;
+			if (statfs(dir.string().c_str(), &info) < 0)
+				return false;
+
+			auto type = (unsigned long) (unsigned int) info.f_type;
+			for (auto m : magic)
+			{
+				if (type == m)
+					return true;
+			}
+			return false;
+		}
+
+		bool watch(const boost::filesystem::path& dir, const listener_t& listener)
+		{
+			if (m_fd < 0)
+				return false;
+
+			if (remote(dir))
+			{
+				log::info() << dir << " is on a network or FUSE filesystem, it will be polled";
+				return false;
+			}
+
+			int wd = inotify_add_watch(m_fd, dir.string().c_str(), MASK);
+			if (wd < 0)
+			{
+				log::warning() << "Cannot watch " << dir << " (" << strerror(errno) << "), it will be polled";
+				return false;
+			}
+
+			std::lock_guard<std::mutex> lock(m_guard);
+			m_watches[wd] = watched { dir, listener };
+			return true;
+		}
+
+		void forget(int wd)
+		{
+			std::lock_guard<std::mutex> lock(m_guard);
+			m_watches.erase(wd);
+		}
+
+		static long long elapsed(clock::time_point since, clock::time_point now)
+		{
+			return std::chrono::duration_cast<std::chrono::milliseconds>(now - since).count();
+		}
+
+		void run()
+		{
+			std::vector<char> buffer(64 * 1024);
+			pending_t pending;
+			bool overflow = false;
+			clock::time_point first, last;
+
+			while (true)
+			{
+				int timeout = -1;
+				if (overflow || !pending.empty())
+				{
+					auto now = clock::now();
+					auto quiet = QUIET_MS - elapsed(last, now);
+					auto limit = MAX_DELAY_MS - elapsed(first, now);
+					timeout = (int) std::max(0ll, std::min(quiet, limit));
+				}
+
+				pollfd fd { m_fd, POLLIN, 0 };
+				int ret = poll(&fd, 1, timeout);
+				if (ret < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					log::error() << "Watcher stopped: " << strerror(errno);
+					return;
+				}
+
+				if (ret > 0)
+				{
+					auto size = read(m_fd, buffer.data(), buffer.size());
+					if (size > 0)
+					{
+						auto now = clock::now();
+						if (!overflow && pending.empty())
+							first = now;
+						last = now;
+						collect(buffer.data(), buffer.data() + size, pending, overflow);
+					}
+				}
+
+				if (!overflow && pending.empty())
+					continue;
+
+				auto now = clock::now();
+				if (elapsed(last, now) >= QUIET_MS || elapsed(first, now) >= MAX_DELAY_MS)
+				{
+					flush(pending, overflow);
+					pending.clear();
+					overflow = false;
+				}
+			}
+		}
+
+		void collect(const char* ptr, const char* end, pending_t& pending, bool& overflow)
+		{
+			while (ptr < end)
+			{
+				auto event = reinterpret_cast<const inotify_event*>(ptr);
+				ptr += sizeof(inotify_event) + event->len;
+
+				if (event->mask & IN_Q_OVERFLOW)
+				{
+					overflow = true;
+					continue;
+				}
+
+				// the folder itself is gone; its parent reports that
+				if (event->mask & IN_IGNORED)
+				{
+					forget(event->wd);
+					pending.erase(event->wd);
+					continue;
+				}
+
+				// a new file is reported, when it is closed after writing
+				if ((event->mask & IN_CREATE) && !(event->mask & IN_ISDIR))
+					continue;
+
+				if (event->len && event->name[0])
+					pending[event->wd].insert(event->name);
+			}
+		}
+
+		void flush(const pending_t& pending, bool overflow)
+		{
+			std::vector<std::pair<listener_t, names_t>> calls;
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+				if (overflow)
+				{
+					log::warning() << "Watcher lost some events, rescanning " << m_watches.size() << " folder(s)";
+					for (auto && watch : m_watches)
+						calls.emplace_back(watch.second.m_listener, names_t());
+				}
+				else
+				{
+					for (auto && dir : pending)
+					{
+						auto it = m_watches.find(dir.first);
+						if (it != m_watches.end())
+							calls.emplace_back(it->second.m_listener, names_t(dir.second.begin(), dir.second.end()));
+					}
+				}
+			}
+
+			for (auto && call : calls)
+			{
+				try
+				{
+					call.first(std::move(call.second));
+				}
+				catch (std::exception& e)
+				{
+					log::error() << "Exception: " << e.what();
+				}
+				catch (...)
+				{
+					log::error() << "Unknown exception";
+				}
+			}
+		}
+	};
+
+	watcher& watcher::get()
+	{
+		// never destroyed: the thread is detached and may still use it at exit
+		static watcher* instance = new watcher();
+		return *instance;
+	}
+
+	watcher::watcher()
+		: pimpl(new impl())
+	{
+	}
+
+	bool watcher::watch(const boost::filesystem::path& dir, const listener_t& listener)
+	{
+		return pimpl->watch(dir, listener);
+	}
+}
@@ -28,6 +28,7 @@
 #include <ssdp.hpp>
 #include <boost/filesystem.hpp>
 #include <iostream>
+#include <map>
 #include <service_description.hpp>
 
 namespace fs = boost::filesystem;
@@ -250,6 +251,23 @@ struct printer
 				"			return " << type << "_UNKNOWN;\n"
 				"		};\n"
 				"\n"
+				"		static void write(std::string& out, " << type << " rhs)\n"
+				"		{\n"
+				"			switch(rhs)\n"
+				"			{";
+
+			for (auto && val : var.m_values)
+				o <<
+				"\n"
+				"			case " << safe_name << "::VALUE_" << val << ": out.append(\"" << val << "\", " << val.length() << "); return;";
+
+			o <<
+				"\n"
+				"			};\n"
+				"\n"
+				"			out.append(to_string(rhs));\n"
+				"		}\n"
+				"\n"
 				"		static void get_config(std::ostream& o)\n"
 				"		{\n"
 				"			o <<\n"
@@ -340,6 +358,102 @@ struct printer
 			"		};\n";
 	}
 
+	void print_writer(header& o, const action& action)
+	{
+		// SOAP_BODY_START, the action's opening tag and the first argument's
+		// opening tag are all literals, so they are glued by the compiler
+		std::vector<const action_arg*> outs;
+		for (auto && arg : action.m_args)
+		{
+			if (!arg.m_input)
+				outs.push_back(&arg);
+		}
+
+		o <<
+			"\n"
+			"		static void write_" << action.m_name << "(soap_output& out, const Raw" << action.m_name << "::response&" << (outs.empty() ? " /*response*/" : " response") << ")\n"
+			"		{\n"
+			"			static const char prefix[] =\n"
+			"				SOAP_BODY_START\n"
+			"				\"<u:" << action.m_name << "Response xmlns:u=\\\"" << class_type << "\\\">\\n";
+
+		if (!outs.empty())
+			o << "<" << outs.front()->m_name << ">";
+
+		o << "\";\n"
+			"			static const char suffix[] =\n"
+			"				\"";
+
+		if (!outs.empty())
+			o << "</" << outs.back()->m_name << ">";
+
+		o << "\\n</u:" << action.m_name << "Response>\"\n"
+			"				SOAP_BODY_STOP;\n"
+			"\n"
+			"			out.reserve(sizeof(prefix) + sizeof(suffix) + " << (outs.size() * 32) << ");\n"
+			"			out.append(prefix, sizeof(prefix) - 1);";
+
+		for (size_t i = 0; i < outs.size(); ++i)
+		{
+			auto arg = outs[i];
+			if (i)
+			{
+				auto glue = "</" + outs[i - 1]->m_name + "><" + arg->m_name + ">";
+				o <<
+					"\n"
+					"			out.append(\"" << glue << "\", " << glue.length() << ");";
+			}
+			o <<
+				"\n"
+				"			type_info<" << arg->getCType(descr.m_variables) << ">::write(out, response." << arg->m_name << ");";
+		}
+
+		o <<
+			"\n"
+			"			out.append(suffix, sizeof(suffix) - 1);\n"
+			"		}\n";
+	}
+
+	void print_dispatch(header& o)
+	{
+		// action names are bucketed by length, so a SOAPAction is compared
+		// with at most a handful of names before the method is picked
+		std::map<size_t, std::vector<std::pair<std::string, size_t>>> buckets;
+		size_t id = 0;
+		for (auto && action : descr.m_actions)
+			buckets[action.m_name.length()].emplace_back(action.m_name, id++);
+
+		o <<
+			"\n"
+			"		bool answer(const std::string& name, const client_info_ptr& info, const http::http_request& req, http::response& response, const http::module_version& server) override\n"
+			"		{\n"
+			"			switch (name.length())\n"
+			"			{";
+
+		for (auto && bucket : buckets)
+		{
+			o <<
+				"\n"
+				"			case " << bucket.first << ":";
+			for (auto && action : bucket.second)
+			{
+				o <<
+					"\n"
+					"				if (!name.compare(\"" << action.first << "\")) return call_method(" << action.second << ", info, req, response, server);";
+			}
+			o <<
+				"\n"
+				"				break;";
+		}
+
+		o <<
+			"\n"
+			"			};\n"
+			"\n"
+			"			return false;\n"
+			"		}\n";
+	}
+
 	void print_proxy(header& o)
 	{
 		size_t name_len = 0, ref_len = 0;
@@ -422,18 +536,27 @@ struct printer
 
 				o << " &Raw" << action.m_name << "::" << (arg.m_input ? "request" : "response") << "::" << arg.m_name << ")";
 			}
-			o << ";\n";
+			o <<
+				"\n"
+				"				.writer(&" << class_name << "ServerProxy::write_" << action.m_name << ");\n";
 		}
 
 		o <<
 			"\n"
 			"		}\n";
 
+		print_dispatch(o);
+
 		for (auto && action : descr.m_actions)
 		{
 			print_proxy(o, action);
 		}
 
+		for (auto && action : descr.m_actions)
+		{
+			print_writer(o, action);
+		}
+
 		o <<
 			"	};\n"
 			"\n"
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __BROWSE_CACHE_HPP__
+#define __BROWSE_CACHE_HPP__
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+namespace net { namespace ssdp { namespace import { namespace av {
+
+	/*
+	 * Rendered BrowseDirectChildren pages, escaped and ready to be put
+	 * inside <Result>. A key covers everything the page depends on:
+	 * container, window, compiled filter, sort order, client profile, the
+	 * host:port spliced into the resource URLs and the update ID of the
+	 * container. Pages of a container are dropped as
+	 * soon as the container reports a change; a page, which started
+	 * rendering before any change, is never stored.
+	 */
+	class browse_cache
+	{
+	public:
+		struct page
+		{
+			std::string m_result;
+			unsigned int m_returned;
+			unsigned int m_total;
+		};
+		typedef std::shared_ptr<const page> page_ptr;
+
+		enum
+		{
+			MAX_PAGES = 256,
+			MAX_BYTES = 16 * 1024 * 1024,
+			MAX_PAGE_BYTES = 1024 * 1024
+		};
+
+		browse_cache() : m_bytes(0), m_generation(0), m_hits(0), m_misses(0) {}
+
+		static std::string key(const std::string& object_id, unsigned int start, unsigned int count,
+		                       unsigned long filter, const std::string& order, const std::string& client, const std::string& host,
+		                       unsigned long update_id);
+
+		page_ptr find(const std::string& key);
+		void store(const std::string& object_id, const std::string& key, const page_ptr& page, unsigned long generation);
+		void invalidate(const std::string& object_id);
+		void clear();
+
+		// take it before rendering a page and give it back to store()
+		unsigned long generation() const { return m_generation.load(); }
+		unsigned long hits() const { return m_hits.load(); }
+		unsigned long misses() const { return m_misses.load(); }
+
+	private:
+		struct entry
+		{
+			std::string m_key;
+			std::string m_object_id;
+			page_ptr m_page;
+		};
+		typedef std::list<entry> lru_type;
+
+		void erase(lru_type::iterator it);
+
+		std::mutex m_guard;
+		lru_type m_lru;
+		std::unordered_map<std::string, lru_type::iterator> m_pages;
+		size_t m_bytes;
+		std::atomic<unsigned long> m_generation;
+		std::atomic<unsigned long> m_hits;
+		std::atomic<unsigned long> m_misses;
+	};
+
+}}}} // net::ssdp::import::av
+
+#endif // __BROWSE_CACHE_HPP__
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DIDL_HPP__
+#define __DIDL_HPP__
+
+#include <string>
+#include <cstring>
+#include <type_traits>
+#include <bitset>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <utils.hpp>
+
+namespace net { namespace ssdp { namespace import { namespace av { namespace didl {
+
+	/*
+	 * An item, rendered once and written many times. The host:port of the
+	 * server is left out of the text; m_holes tell, where it goes.
+	 */
+	struct fragment
+	{
+		std::string m_text;
+		std::vector<size_t> m_holes;
+	};
+
+	/*
+	 * Appends DIDL-Lite to a string. Whatever goes through operator<< is
+	 * markup and is written as-is; text() escapes character data. With
+	 * "escaped" set, everything is written one level deeper (markup
+	 * escaped once, text twice), ready to be placed inside the SOAP
+	 * <Result> element without another pass.
+	 */
+	class writer
+	{
+		std::string& m_out;
+		bool m_escaped;
+		std::vector<size_t>* m_holes;
+
+		template <typename T>
+		writer& unsigned_value(T value, int width = 0)
+		{
+			char buffer[sizeof(T) * 3 + 1];
+			auto ptr = buffer + sizeof(buffer);
+			do
+			{
+				*--ptr = (char) ('0' + value % 10);
+				value /= 10;
+				--width;
+			} while (value);
+
+			while (width-- > 0)
+				*--ptr = '0';
+
+			m_out.append(ptr, buffer + sizeof(buffer) - ptr);
+			return *this;
+		}
+	public:
+		writer(std::string& out, bool escaped) : m_out(out), m_escaped(escaped), m_holes(nullptr) {}
+		writer(fragment& out, bool escaped) : m_out(out.m_text), m_escaped(escaped), m_holes(&out.m_holes) {}
+
+		std::string& str() { return m_out; }
+		bool escaped() const { return m_escaped; }
+
+		writer& markup(const char* s, size_t length)
+		{
+			if (m_escaped)
+				xmlencode(m_out, s, length);
+			else
+				m_out.append(s, length);
+			return *this;
+		}
+
+		writer& text(const char* s, size_t length)
+		{
+			if (m_escaped)
+				xmlencode_twice(m_out, s, length);
+			else
+				xmlencode(m_out, s, length);
+			return *this;
+		}
+		writer& text(const std::string& s) { return text(s.c_str(), s.length()); }
+
+		writer& operator << (const char* s) { return markup(s, strlen(s)); }
+		writer& operator << (const std::string& s) { return markup(s.c_str(), s.length()); }
+		writer& operator << (char c) { return markup(&c, 1); }
+
+		template <typename T>
+		typename std::enable_if<std::is_integral<T>::value, writer&>::type operator << (T value)
+		{
+			if (value < 0)
+			{
+				m_out.push_back('-');
+				return unsigned_value(0ULL - (unsigned long long) value);
+			}
+			return unsigned_value((unsigned long long) value);
+		}
+
+		// the "host:port" part of an URL; left for later, if writing a fragment
+		writer& host(const std::string& host_port)
+		{
+			if (m_holes)
+				m_holes->push_back(m_out.length());
+			else
+				m_out.append(host_port);
+			return *this;
+		}
+
+		writer& splice(const fragment& frag, const std::string& host_port)
+		{
+			size_t from = 0;
+			for (auto hole : frag.m_holes)
+			{
+				m_out.append(frag.m_text, from, hole - from);
+				host(host_port);
+				from = hole;
+			}
+			m_out.append(frag.m_text, from, std::string::npos);
+			return *this;
+		}
+
+		// zero-padded, as in durations
+		writer& padded(unsigned long long value, int width) { return unsigned_value(value, width); }
+
+		writer& hex(unsigned int value, int width)
+		{
+			static const char digits[] = "0123456789abcdef";
+			char buffer[sizeof(value) * 2];
+			auto ptr = buffer + sizeof(buffer);
+			do
+			{
+				*--ptr = digits[value & 0xF];
+				value >>= 4;
+				--width;
+			} while (value);
+
+			while (width-- > 0)
+				m_out.push_back('0');
+
+			m_out.append(ptr, buffer + sizeof(buffer) - ptr);
+			return *this;
+		}
+	};
+
+	// the optional properties, which a Browse Filter may ask for
+	enum property
+	{
+		childCount,
+		dc_date,
+		dc_creator,
+		dc_description,
+		upnp_artist,
+		upnp_album,
+		upnp_genre,
+		upnp_originalTrackNumber,
+		upnp_albumArtURI,
+		upnp_albumArtURI_dlna_profileID,
+		res,
+		res_protocolInfo,
+		res_bitrate,
+		res_duration,
+		res_sampleFrequency,
+		res_nrAudioChannels,
+		res_size,
+		res_resolution,
+
+		property_count
+	};
+
+	// a Filter argument, compiled into a set of properties; "*" and "" ask for everything
+	class filter
+	{
+		std::bitset<property_count> m_properties;
+	public:
+		filter() { m_properties.set(); }
+		explicit filter(const std::string& text);
+
+		bool contains(property prop) const { return m_properties.test(prop); }
+		unsigned long bits() const { return m_properties.to_ulong(); }
+	};
+	typedef std::shared_ptr<const filter> filter_ptr;
+
+	// renderers keep sending the same few Filters; compile each one once
+	class filter_cache
+	{
+		enum { MAX_FILTERS = 64 };
+
+		std::mutex m_guard;
+		std::unordered_map<std::string, filter_ptr> m_filters;
+		filter_ptr m_all;
+	public:
+		filter_cache() : m_all(std::make_shared<filter>()) {}
+		filter_ptr get(const std::string& text);
+	};
+
+}}}}} // net::ssdp::import::av::didl
+
+#endif // __DIDL_HPP__
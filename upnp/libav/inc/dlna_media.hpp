@@ -25,6 +25,11 @@
 #define __DLNA_MEDIA_HPP__
 
 #include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 #include <utils.hpp>
 #include <boost/filesystem.hpp>
 
@@ -79,6 +84,59 @@ namespace net { namespace dlna {
 		static const Profile* guess_from_memory(const char* data, size_t size);
 	};
 
+	/*
+	 * The protocolInfo strings of the profiles actually served, each one
+	 * rendered once for every renderer variant. A variant tells, if the
+	 * renderer wants the DLNA.ORG_PN at all ([MediaServer] Send_ORG_PN,
+	 * on by default) and which of the names should be sent as something
+	 * else ([MediaServer] ProfilePatches = "NAME=OTHER,NAME2=OTHER2").
+	 * Variant 0 sends every name as-is.
+	 */
+	class protocol_table
+	{
+	public:
+		typedef std::map<std::string, std::string> patches_t;
+
+		protocol_table() { m_variants.push_back(variant { true, patches_t() }); }
+
+		// the mime types, which will be reported as the Source of the ConnectionManager
+		void add_mime(const char* mime);
+		const std::string& source() const { return m_source; }
+
+		std::size_t add_variant(bool send_pn, const patches_t& patches);
+		static patches_t parse_patches(const std::string& text);
+
+		// index of the entry for the given res; profile may be nullptr
+		std::size_t find(const Profile* profile, unsigned int flags);
+		const std::string& get(std::size_t entry, std::size_t variant);
+
+	private:
+		struct variant
+		{
+			bool m_send_pn;
+			patches_t m_patches;
+		};
+
+		struct entry
+		{
+			std::string m_mime;
+			std::string m_name;
+			unsigned int m_flags;
+			std::deque<std::string> m_rendered;
+		};
+
+		std::string render(const entry& item, const variant& var) const;
+
+		std::mutex m_guard;
+		std::string m_source;
+		std::vector<std::string> m_mimes;
+		std::deque<variant> m_variants;
+		std::deque<entry> m_entries;
+		std::unordered_map<std::string, std::size_t> m_index;
+	};
+
+	protocol_table& protocols();
+
 	struct ItemMetadata
 	{
 		std::string m_title;
@@ -142,6 +200,19 @@ namespace net { namespace dlna {
 		}
 	};
 
+	/*
+	 * Who looks inside the file: the header-only native probers, which
+	 * understand JPEG, PNG, MP3 and AAC in MP4, or ffmpeg, which
+	 * understands everything else. The default is native first, with ffmpeg
+	 * for anything the native probers cannot tell.
+	 */
+	enum class prober
+	{
+		any,
+		native,
+		ffmpeg
+	};
+
 	struct Item
 	{
 		ItemMetadata m_meta;
@@ -155,7 +226,7 @@ namespace net { namespace dlna {
 		{
 		}
 
-		bool open(const boost::filesystem::path& path);
+		bool open(const boost::filesystem::path& path, prober use = prober::any);
 	};
 
 }} // net::dlna
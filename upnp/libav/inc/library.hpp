@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __LIBRARY_HPP__
+#define __LIBRARY_HPP__
+
+#include <media_server.hpp>
+#include <atomic>
+
+namespace net { namespace ssdp { namespace import { namespace av { namespace items {
+
+	/*
+	 * A container, which is not a folder on disk. Its children are kept in
+	 * memory, in the order given at construction. Owned children get their
+	 * ids from this container; the others are items living somewhere else
+	 * in the tree, only listed here.
+	 */
+	struct virtual_container : common_props_item
+	{
+		virtual_container(MediaServer* device, const std::string& title, const char* upnp_class, const std::string& order, bool owns_children);
+
+		container_type list(ulong start_from, ulong max_count)           override;
+		container_type sorted_list(ulong start_from, ulong max_count,
+		                           const sorting::criteria& order)       override;
+		ulong          predict_count(ulong served) const                 override;
+		ulong          update_id() const                                 override { return m_update_id; }
+		media_item_ptr get_item(const std::string& id)                   override;
+		bool           is_image() const                                  override { return false; }
+		bool           is_folder() const                                 override { return true; }
+		size_t         child_count() const                               override;
+		const char*    get_upnp_class() const                            override { return m_class; }
+
+		void           add_child(const media_item_ptr& child);
+		void           remove_child(const media_item_ptr& child);
+		// false, if the children are only listed here and live somewhere else
+		bool           owns_children() const { return m_owns_children; }
+
+		// drops the children past the max_count, returns what is left
+		size_t         trim(size_t max_count);
+	private:
+		void           changed();
+
+		mutable std::mutex    m_guard;
+		const char*           m_class;
+		sorting::criteria     m_order;
+		bool                  m_owns_children;
+		container_type        m_children;
+		sorting::permutations m_sorted;
+		std::atomic<ulong>    m_update_id;
+		ulong                 m_current_max;
+	};
+	typedef std::shared_ptr<virtual_container> virtual_container_ptr;
+
+	/*
+	 * The "Library" root container: the items found so far, grouped by
+	 * their tags (artist, album, genre, year) and the most recently
+	 * changed ones. Kept up to date by MediaServer::item_added and
+	 * item_removed, so it grows as the folders are scanned.
+	 */
+	class library
+	{
+	public:
+		typedef std::string (*grouping)(const dlna::ItemMetadata& meta);
+
+		explicit library(MediaServer* device);
+
+		media_item_ptr root() const { return m_root; }
+		void add(const media_item_ptr& item);
+		void remove(const media_item_ptr& item);
+
+	private:
+		enum { MAX_RECENT = 256 };
+
+		struct view
+		{
+			virtual_container_ptr m_container;
+			grouping m_key;
+			const char* m_group_class;
+			std::string m_items_order;
+			std::unordered_map<std::string, virtual_container_ptr> m_groups;
+		};
+
+		MediaServer* m_device;
+		std::mutex m_guard;
+		virtual_container_ptr m_root;
+		virtual_container_ptr m_recent;
+		std::vector<view> m_views;
+	};
+
+}}}}} // net::ssdp::import::av::items
+
+#endif // __LIBRARY_HPP__
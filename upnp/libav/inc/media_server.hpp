@@ -25,10 +25,18 @@
 #define __SSDP_MEDIA_SERVER_HPP__
 
 #include <device.hpp>
+#include <client_matcher_set.hpp>
 #include <directory.hpp>
 #include <manager.hpp>
 #include <dlna_media.hpp>
+#include <didl.hpp>
+#include <browse_cache.hpp>
+#include <search.hpp>
+#include <sort.hpp>
 #include <zlib.h>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
 
 #ifdef _MSC_VER
 #pragma comment(lib, "libz.lib")
@@ -87,8 +95,14 @@ namespace net { namespace ssdp { namespace import { namespace av {
 
 	struct client_interface: client_info
 	{
-		client_interface(const std::string& name) : client_info(name) {}
+		client_interface(const std::string& name) : client_info(name), m_protocol_variant(0) {}
 		virtual ~client_interface() {}
+
+		// the dlna::protocols() variant for this renderer
+		size_t protocol_variant() const { return m_protocol_variant; }
+		void set_protocol_variant(size_t variant) { m_protocol_variant = variant; }
+	private:
+		size_t m_protocol_variant;
 	};
 	typedef std::shared_ptr<client_interface> client_interface_ptr;
 
@@ -106,6 +120,8 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		{
 			return m_matcher.matches(request);
 		}
+		const std::string& other_header() const { return m_matcher.other_header(); }
+		const client_matcher& matcher() const { return m_matcher; }
 	private:
 		client_matcher m_matcher;
 	};
@@ -124,6 +140,8 @@ namespace net { namespace ssdp { namespace import { namespace av {
 			virtual const dlna::Profile* profile() const { return nullptr; }
 			virtual media_ptr get_thumbnail() = 0;
 			static media_ptr from_file(const boost::filesystem::path& path, bool main_resource);
+			// the profile is known already, e.g. from a scan; it is probed again only, if the file changes
+			static media_ptr from_file(const boost::filesystem::path& path, const dlna::Profile& profile, bool main_resource);
 		};
 
 		struct media_item;
@@ -149,8 +167,15 @@ namespace net { namespace ssdp { namespace import { namespace av {
 
 			//enumeration
 			virtual container_type list(ulong start_from, ulong max_count)          = 0;
+			virtual container_type sorted_list(ulong start_from, ulong max_count,
+			                                   const sorting::criteria& order);
 			virtual ulong          predict_count(ulong served) const                = 0;
 			virtual void           check_updates()                                  {}
+			// true, if list() would not wait; otherwise, ready (if given) is called once it would not
+			virtual bool           wait_for(ulong /*start_from*/, ulong /*max_count*/,
+			                                const std::function<void ()>& /*ready*/) { return true; }
+			// whatever there is right now, even if a scan is still going
+			virtual container_type peek(ulong start_from, ulong max_count)          { return list(start_from, max_count); }
 			virtual ulong          update_id() const                                = 0;
 
 			//navigation
@@ -161,10 +186,11 @@ namespace net { namespace ssdp { namespace import { namespace av {
 			//output
 			virtual bool           is_folder() const                                = 0;
 			virtual bool           is_image() const                                 = 0;
-			virtual void           output(std::ostream& o,
-			                              const std::vector<std::string>& filter,
+			virtual void           output(didl::writer& o,
+			                              const didl::filter& filter,
 			                              const client_interface_ptr& client,
 			                              const config::config_ptr& config) const   = 0;
+			virtual void           invalidate_output()                              {}
 
 			//attributes
 			virtual void           set_objectId_attr(const std::string& object_id) { m_object_id = object_id; }
@@ -197,23 +223,73 @@ namespace net { namespace ssdp { namespace import { namespace av {
 
 		struct root_item;
 		typedef std::shared_ptr<root_item> root_item_ptr;
+		class library;
+
+		std::pair<media_item_ptr, std::string> find_item(const std::vector<media_item_ptr>& items, const std::string& id);
 
-		std::pair<media_item_ptr, std::string> find_item(std::vector<media_item_ptr>& items, const std::string& id);
+		/*
+		 * Every item, which was added to a container, by its raw object id
+		 * ("0.3.17") and by its token. Entries are weak, so an item dropped
+		 * along with its whole folder simply stops being found; such entries
+		 * are cleaned up when looked at.
+		 */
+		class item_index
+		{
+			enum { SHARD_COUNT = 8 };
+			typedef std::unordered_map<std::string, std::weak_ptr<media_item>> map_t;
+
+			struct shard
+			{
+				std::mutex m_guard;
+				map_t m_items;
+			};
+
+			shard m_ids[SHARD_COUNT];
+			shard m_tokens[SHARD_COUNT];
+
+			static shard& shard_for(shard (&shards)[SHARD_COUNT], const std::string& key);
+			static media_item_ptr find(shard (&shards)[SHARD_COUNT], const std::string& key);
+			static void insert(shard (&shards)[SHARD_COUNT], const std::string& key, const media_item_ptr& item);
+			static void erase(shard (&shards)[SHARD_COUNT], const std::string& key, const media_item* item);
+		public:
+			void add(const media_item_ptr& item);
+			void remove(const media_item_ptr& item);
+
+			// the id as seen in DIDL: raw object id, optionally followed by ",token"
+			media_item_ptr find(const std::string& id);
+		};
 
 		struct common_props_item : media_item
 		{
 			common_props_item(MediaServer* device) : media_item(device) {}
 
-			void output(std::ostream& o,
-				const std::vector<std::string>& filter,
+			void output(didl::writer& o,
+				const didl::filter& filter,
 				const client_interface_ptr& client,
 				const net::config::config_ptr& config) const  override;
+			void invalidate_output()                          override;
 			virtual const char* get_upnp_class() const        = 0;
 			virtual size_t      child_count() const           = 0;
 			virtual time_t      get_last_write_time() const   { return 0; }
 		protected:
-			void main_res(std::ostream& o, const std::vector<std::string>& filter, const client_interface_ptr& client, const config::config_ptr& config) const;
-			void cover(std::ostream& o, const std::vector<std::string>& filter, const client_interface_ptr& client, const config::config_ptr& config) const;
+			void render(didl::writer& o, const didl::filter& filter, const client_interface_ptr& client, const std::string& host) const;
+			void main_res(didl::writer& o, const didl::filter& filter, const client_interface_ptr& client, const std::string& host) const;
+			void cover(didl::writer& o, const didl::filter& filter, const client_interface_ptr& client, const std::string& host) const;
+
+		private:
+			// an item looks the same for every request with the same filter from the same kind of client
+			struct cached_output
+			{
+				bool m_escaped;
+				unsigned long m_filter;
+				std::string m_client;
+				didl::fragment m_fragment;
+			};
+			typedef std::shared_ptr<const cached_output> cached_output_ptr;
+			enum { MAX_OUTPUTS = 4 };
+
+			mutable std::mutex m_output_guard;
+			mutable std::vector<cached_output_ptr> m_outputs;
 		};
 	}
 
@@ -223,15 +299,19 @@ namespace net { namespace ssdp { namespace import { namespace av {
 	struct ContentDirectory: ContentDirectoryServerProxy
 	{
 		MediaServer* m_device;
+		didl::filter_cache m_filters;
+		browse_cache m_pages;
 		ContentDirectory(MediaServer* device) : m_device(device) {}
 
+		void get_events(event_state& out) const override;
+
 		error_code GetSystemUpdateID(const client_info_ptr& client, const http::http_request& http_request,
 		                             ui4& Id) override;
 
 		error_code Search(const client_info_ptr& client, const http::http_request& http_request,
 		                  const std::string& ContainerID, const std::string& SearchCriteria,
 		                  const std::string& Filter, ui4 StartingIndex, ui4 RequestedCount,
-		                  const std::string& SortCriteria, std::string& Result, ui4& NumberReturned,
+		                  const std::string& SortCriteria, xml_escaped& Result, ui4& NumberReturned,
 		                  ui4& TotalMatches, ui4& UpdateID) override;
 
 		error_code GetSearchCapabilities(const client_info_ptr& client, const http::http_request& http_request,
@@ -243,7 +323,7 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		error_code Browse(const client_info_ptr& client, const http::http_request& http_request,
 		                  const std::string& ObjectID, A_ARG_TYPE_BrowseFlag BrowseFlag,
 		                  const std::string& Filter, ui4 StartingIndex, ui4 RequestedCount,
-		                  const std::string& SortCriteria, std::string& Result, ui4& NumberReturned,
+		                  const std::string& SortCriteria, xml_escaped& Result, ui4& NumberReturned,
 		                  ui4& TotalMatches, ui4& UpdateID) override;
 	};
 
@@ -252,6 +332,8 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		MediaServer* m_device;
 		ConnectionManager(MediaServer* device) : m_device(device) {}
 
+		void get_events(event_state& out) const override;
+
 		error_code GetCurrentConnectionInfo(const client_info_ptr& client, const http::http_request& http_request,
 		                                    i4 ConnectionID, i4& RcsID, i4& AVTransportID,
 		                                    std::string& ProtocolInfo, std::string& PeerConnectionManager,
@@ -284,11 +366,13 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		{
 			add(m_directory);
 			add(m_manager);
+			m_library = create_library();
 		}
 
+		std::vector<std::string> get_http_roots() const         override;
 		bool                  call_http(const http::http_request& req,
-		                                const boost::filesystem::path& root,
-		                                const boost::filesystem::path& rest,
+		                                size_t root,
+		                                const std::string& rest,
 		                                http::response& resp)   override;
 		const char*           get_type() const                  override { return "urn:schemas-upnp-org:device:MediaServer:1"; }
 		const char*           get_description() const           override { return "UPnP/AV 1.0 Compliant Media Server"; }
@@ -296,9 +380,14 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		items::media_item_ptr get_item(const std::string& id);
 		void                  add_root_element(items::media_item_ptr);
 		void                  remove_root_element(items::media_item_ptr);
-		void                  object_changed();
+		items::media_item_ptr library() const;
+		void                  item_added(const items::media_item_ptr& item);
+		void                  item_removed(const items::media_item_ptr& item);
+		std::vector<items::media_item_ptr> search(const search::criteria& query, const items::media_item_ptr& scope) { return m_search.find(query, scope); }
+		void                  object_changed(const items::media_item* container = nullptr);
 		void                  add_renderer_conf(const boost::filesystem::path& conf);
 		client_info_ptr       match_from_request(const http::http_request& request) const override;
+		std::vector<std::string> get_client_headers() const     override;
 
 	private:
 		items::root_item_ptr               m_root_item;
@@ -306,9 +395,14 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		std::shared_ptr<ConnectionManager> m_manager;
 		time_t                             m_system_update_id;
 		std::vector<client_ptr>            m_known_clients;
+		items::item_index                  m_index;
+		search::index                      m_search;
+		std::shared_ptr<items::library>    m_library;
+		client_matcher_set                 m_matchers;
 
 		static client_interface_ptr create_default_client(const http::http_request& request);
 		items::root_item_ptr create_root_item();
+		std::shared_ptr<items::library> create_library();
 	};
 
 }}}} // net::ssdp::import::av
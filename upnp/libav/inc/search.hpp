@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SEARCH_HPP__
+#define __SEARCH_HPP__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace net { namespace ssdp { namespace import { namespace av {
+
+	namespace items
+	{
+		struct media_item;
+		typedef std::shared_ptr<media_item> media_item_ptr;
+	}
+
+	namespace search {
+
+	// the properties a SearchCriteria can look at; dc:creator is the upnp:artist
+	enum field
+	{
+		upnp_class,
+		dc_title,
+		upnp_artist,
+		upnp_album,
+		upnp_genre,
+
+		field_count,
+		unknown_field = field_count
+	};
+
+	enum op
+	{
+		op_equal,
+		op_not_equal,
+		op_less,
+		op_less_equal,
+		op_greater,
+		op_greater_equal,
+		op_contains,
+		op_not_contains,
+		op_derived_from,
+		op_exists
+	};
+
+	struct node;
+	typedef std::unique_ptr<node> node_ptr;
+
+	struct node
+	{
+		enum kind { leaf, and_node, or_node };
+
+		kind m_kind;
+		field m_field;
+		op m_op;
+		std::string m_value; // lowercase
+		bool m_exists;
+		node_ptr m_left;
+		node_ptr m_right;
+
+		node(kind k) : m_kind(k), m_field(unknown_field), m_op(op_equal), m_exists(true) {}
+	};
+
+	/*
+	 * A SearchCriteria, compiled. "*" leaves the plan empty, which matches
+	 * everything. Properties not listed in the field enum are treated as
+	 * missing from every object, so "@refID exists false" is always true,
+	 * while any comparison with them is always false.
+	 */
+	class criteria
+	{
+		node_ptr m_root;
+		friend class index;
+	public:
+		// false, if the text is not a valid SearchCriteria
+		bool compile(const std::string& text);
+	};
+
+	/*
+	 * Inverted indexes over the titles, artists, albums, genres and classes
+	 * of all the items in the server, kept up to date by item_added and
+	 * item_removed. Every value is kept lowercased, split into words for
+	 * the lookup and as a whole for the final check.
+	 */
+	class index
+	{
+		typedef unsigned int doc_id;
+		typedef std::vector<doc_id> postings;
+
+		struct document
+		{
+			std::weak_ptr<items::media_item> m_item;
+			const items::media_item* m_ptr;
+			std::string m_fields[field_count];
+			bool m_alive;
+		};
+
+		std::mutex m_guard;
+		std::vector<document> m_docs;
+		std::unordered_map<const items::media_item*, doc_id> m_ids;
+		std::unordered_map<std::string, postings> m_tokens[field_count];
+		size_t m_alive;
+
+		enum { MIN_COMPACT = 1024 };
+
+		void purge(doc_id id);
+		// drops the purged documents, once they are the most of them
+		void compact();
+		postings all() const;
+		postings candidates(field fld, op oper, const std::string& value) const;
+		postings evaluate(const node* plan) const;
+		bool matches(const document& doc, const node* plan) const;
+	public:
+		index() : m_alive(0) {}
+
+		void add(const items::media_item_ptr& item);
+		void remove(const items::media_item_ptr& item);
+
+		// in the order they were added; the items below the scope, owned or listed by reference
+		std::vector<items::media_item_ptr> find(const criteria& query, const items::media_item_ptr& scope);
+	};
+
+}}}}} // net::ssdp::import::av::search
+
+#endif // __SEARCH_HPP__
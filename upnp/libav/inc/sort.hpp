@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SORT_HPP__
+#define __SORT_HPP__
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <utils.hpp>
+
+namespace net { namespace ssdp { namespace import { namespace av {
+
+	namespace items
+	{
+		struct media_item;
+		typedef std::shared_ptr<media_item> media_item_ptr;
+	}
+
+	namespace sorting {
+
+	enum key
+	{
+		dc_title,
+		upnp_artist,
+		upnp_album,
+		upnp_originalTrackNumber,
+		dc_date
+	};
+
+	// a SortCriteria, compiled; doubles as the comparator for the items
+	class criteria
+	{
+		std::vector<std::pair<key, bool>> m_keys; // key, ascending
+		std::string m_text;
+	public:
+		// false, if the text names a property, which cannot be sorted on
+		bool compile(const std::string& text);
+
+		bool empty() const { return m_keys.empty(); }
+		const std::string& str() const { return m_text; }
+
+		bool less(const items::media_item* lhs, const items::media_item* rhs) const;
+		bool operator()(const items::media_item_ptr& lhs, const items::media_item_ptr& rhs) const { return less(lhs.get(), rhs.get()); }
+	};
+
+	typedef std::vector<items::media_item_ptr> container_type;
+
+	// the same window, list(start_from, max_count) would return
+	container_type slice(const container_type& items, ulong start_from, ulong max_count);
+
+	/*
+	 * The children of a container, in the orders renderers asked for. An
+	 * order is sorted when asked for the first time and then kept in order
+	 * by add() and remove(). Not guarded; the container's lock covers it.
+	 */
+	class permutations
+	{
+		enum { MAX_ORDERS = 4 };
+
+		struct entry
+		{
+			criteria m_order;
+			container_type m_items;
+		};
+
+		std::list<entry> m_orders;
+	public:
+		container_type slice(const container_type& children, const criteria& order, ulong start_from, ulong max_count);
+		void add(const items::media_item_ptr& item);
+		void remove(const items::media_item_ptr& item);
+		void clear() { m_orders.clear(); }
+	};
+
+}}}}} // net::ssdp::import::av::sorting
+
+#endif // __SORT_HPP__
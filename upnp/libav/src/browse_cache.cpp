@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <browse_cache.hpp>
+
+namespace net { namespace ssdp { namespace import { namespace av {
+
+	std::string browse_cache::key(const std::string& object_id, unsigned int start, unsigned int count,
+	                              unsigned long filter, const std::string& order, const std::string& client, const std::string& host,
+	                              unsigned long update_id)
+	{
+		// object IDs and client names never contain a newline
+		std::string out;
+		out.reserve(object_id.length() + order.length() + client.length() + host.length() + 48);
+		out.append(object_id).push_back('\n');
+		out.append(std::to_string(start)).push_back('\n');
+		out.append(std::to_string(count)).push_back('\n');
+		out.append(std::to_string(filter)).push_back('\n');
+		out.append(order).push_back('\n');
+		out.append(client).push_back('\n');
+		out.append(host).push_back('\n');
+		out.append(std::to_string(update_id));
+		return out;
+	}
+
+	browse_cache::page_ptr browse_cache::find(const std::string& key)
+	{
+		std::lock_guard<std::mutex> lock(m_guard);
+		auto it = m_pages.find(key);
+		if (it == m_pages.end())
+		{
+			++m_misses;
+			return nullptr;
+		}
+
+		++m_hits;
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		return it->second->m_page;
+	}
+
+	void browse_cache::store(const std::string& object_id, const std::string& key, const page_ptr& page, unsigned long generation)
+	{
+		if (!page || page->m_result.length() > MAX_PAGE_BYTES)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_guard);
+
+		// something changed while the page was rendered
+		if (generation != m_generation.load())
+			return;
+
+		auto it = m_pages.find(key);
+		if (it != m_pages.end())
+			erase(it->second);
+
+		m_lru.push_front(entry { key, object_id, page });
+		m_pages[key] = m_lru.begin();
+		m_bytes += page->m_result.length();
+
+		while (m_lru.size() > MAX_PAGES || m_bytes > MAX_BYTES)
+			erase(std::prev(m_lru.end()));
+	}
+
+	void browse_cache::invalidate(const std::string& object_id)
+	{
+		std::lock_guard<std::mutex> lock(m_guard);
+		++m_generation;
+
+		auto it = m_lru.begin();
+		while (it != m_lru.end())
+		{
+			auto cur = it++;
+			if (cur->m_object_id == object_id)
+				erase(cur);
+		}
+	}
+
+	void browse_cache::clear()
+	{
+		std::lock_guard<std::mutex> lock(m_guard);
+		++m_generation;
+		m_pages.clear();
+		m_lru.clear();
+		m_bytes = 0;
+	}
+
+	void browse_cache::erase(lru_type::iterator it)
+	{
+		m_bytes -= it->m_page->m_result.length();
+		m_pages.erase(it->m_key);
+		m_lru.erase(it);
+	}
+
+}}}} // net::ssdp::import::av
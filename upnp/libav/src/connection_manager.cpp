@@ -28,6 +28,17 @@
 
 namespace net { namespace ssdp { namespace import { namespace av {
 
+	void ConnectionManager::get_events(event_state& out) const
+	{
+		std::string source, sink;
+		const_cast<ConnectionManager*>(this)->GetProtocolInfo(nullptr, http::http_request(), source, sink);
+
+		out.emplace_back("SourceProtocolInfo", source);
+		out.emplace_back("SinkProtocolInfo", sink);
+		// no PrepareForConnection, so the only connection is the default one
+		out.emplace_back("CurrentConnectionIDs", "0");
+	}
+
 	error_code ConnectionManager::GetCurrentConnectionInfo(const client_info_ptr& /*client*/,
 	                                                       const http::http_request& /*http_request*/,
 	                                                       /* IN  */ i4 /*ConnectionID*/,
@@ -67,25 +78,7 @@ namespace net { namespace ssdp { namespace import { namespace av {
 	                                              /* OUT */ std::string& Source,
 	                                              /* OUT */ std::string& /*Sink*/)
 	{
-		Source =
-			"http-get:*:image/jpeg:*,"
-			"http-get:*:image/png:*,"
-			"http-get:*:image/gif:*,"
-			"http-get:*:image/bmp:*,"
-
-			"http-get:*:audio/vnd.dolby.dd-raw:*,"
-			"http-get:*:audio/mp4:*,"
-			"http-get:*:audio/3gpp:*,"
-			"http-get:*:audio/x-sony-oma:*,"
-			"http-get:*:audio/vnd.dlna.adts:*,"
-			"http-get:*:audio/L16:*,"
-			"http-get:*:audio/mpeg:*,"
-			"http-get:*:audio/x-ms-wma:*,"
-
-			"http-get:*:video/mpeg:*,"
-			"http-get:*:video/mp4:*,"
-			"http-get:*:video/vnd.dlna.mpeg-tts:*,"
-			"http-get:*:video/x-ms-wmv:*";
+		Source = dlna::protocols().source();
 
 		return error::no_error;
 	}
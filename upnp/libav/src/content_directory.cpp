@@ -45,27 +45,11 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		return val;
 	}
 
-	static std::vector<std::string> parse_filter(const std::string& filter)
+	void ContentDirectory::get_events(event_state& out) const
 	{
-		if (filter.empty() || filter == "*")
-			return std::vector<std::string>();
-
-		std::vector<std::string> out;
-
-		std::string::size_type pos = 0;
-		for (;;)
-		{
-			auto comma = filter.find(',', pos);
-			if (comma == std::string::npos)
-			{
-				out.push_back(filter.substr(pos));
-				break;
-			}
-			out.push_back(filter.substr(pos, comma - pos));
-			pos = comma + 1;
-		}
-
-		return out;
+		out.emplace_back("SystemUpdateID", std::to_string(m_device->system_update_id()));
+		out.emplace_back("ContainerUpdateIDs", std::string());
+		out.emplace_back("TransferIDs", std::string());
 	}
 
 	error_code ContentDirectory::GetSystemUpdateID(const client_info_ptr& /*client*/,
@@ -76,35 +60,212 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		return error::no_error;
 	}
 
-	error_code ContentDirectory::Search(const client_info_ptr& /*client*/,
-	                                    const http::http_request& /*http_request*/,
-	                                    /* IN  */ const std::string& /*ContainerID*/,
-	                                    /* IN  */ const std::string& /*SearchCriteria*/,
-	                                    /* IN  */ const std::string& /*Filter*/,
-	                                    /* IN  */ ui4 /*StartingIndex*/,
-	                                    /* IN  */ ui4 /*RequestedCount*/,
-	                                    /* IN  */ const std::string& /*SortCriteria*/,
-	                                    /* OUT */ std::string& /*Result*/,
-	                                    /* OUT */ ui4& /*NumberReturned*/,
-	                                    /* OUT */ ui4& /*TotalMatches*/,
-	                                    /* OUT */ ui4& /*UpdateID*/)
-	{
-		return error::not_implemented;
-	}
-
 	error_code ContentDirectory::GetSearchCapabilities(const client_info_ptr& /*client*/,
 	                                                   const http::http_request& /*http_request*/,
-	                                                   /* OUT */ std::string& /*SearchCaps*/)
+	                                                   /* OUT */ std::string& SearchCaps)
 	{
-		//SearchCaps = "*";
+		SearchCaps = "upnp:class,dc:title,dc:creator,upnp:artist,upnp:album,upnp:genre";
 		return error::no_error;
 	}
 
 	error_code ContentDirectory::GetSortCapabilities(const client_info_ptr& /*client*/,
 	                                                 const http::http_request& /*http_request*/,
-	                                                 /* OUT */ std::string& /*SortCaps*/)
+	                                                 /* OUT */ std::string& SortCaps)
 	{
-		//SortCaps = "*";
+		SortCaps = "dc:title,upnp:artist,dc:creator,upnp:album,upnp:originalTrackNumber,dc:date";
+		return error::no_error;
+	}
+
+	namespace
+	{
+		void open_didl(didl::writer& value)
+		{
+			value << R"(<DIDL-Lite xmlns="urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/" xmlns:dc="http://purl.org/dc/elements/1.1/" xmlns:upnp="urn:schemas-upnp-org:metadata-1-0/upnp/">)" "\n";
+		}
+
+		// collects a page while it is being sent, to hand it over to the browse_cache at the end
+		struct page_recorder
+		{
+			browse_cache* m_cache;
+			std::string m_object_id;
+			std::string m_key;
+			unsigned long m_generation;
+			std::shared_ptr<browse_cache::page> m_page;
+
+			page_recorder(browse_cache* cache, const std::string& object_id, std::string&& key, unsigned long generation, ui4 returned, ui4 total)
+				: m_cache(cache)
+				, m_object_id(object_id)
+				, m_key(std::move(key))
+				, m_generation(generation)
+				, m_page(std::make_shared<browse_cache::page>())
+			{
+				m_page->m_returned = returned;
+				m_page->m_total = total;
+			}
+
+			void record(const std::string& out, size_t from)
+			{
+				if (!m_page)
+					return;
+
+				m_page->m_result.append(out, from, std::string::npos);
+				if (m_page->m_result.length() > browse_cache::MAX_PAGE_BYTES)
+					m_page = nullptr;
+			}
+
+			void finish()
+			{
+				if (m_page)
+					m_cache->store(m_object_id, m_key, m_page, m_generation);
+			}
+		};
+
+		// the children, which are already there, ordered the way the renderer asked for
+		items::media_item::container_type peek_page(const items::media_item_ptr& item, ui4 start_from, ui4 max_count, const sorting::criteria& order)
+		{
+			if (order.empty())
+				return item->peek(start_from, max_count);
+
+			auto children = item->peek(0, items::INVALID_ID);
+			std::stable_sort(children.begin(), children.end(), order);
+			return sorting::slice(children, start_from, max_count);
+		}
+
+		// writes the children of a container a page at a time, while the response is being sent
+		struct didl_pages
+		{
+			enum { PAGE_SIZE = 32 };
+
+			std::shared_ptr<items::media_item::container_type> m_children;
+			didl::filter_ptr m_filter;
+			client_interface_ptr m_client;
+			config::config_ptr m_config;
+			std::shared_ptr<page_recorder> m_recorder;
+			size_t m_next;
+
+			didl_pages(items::media_item::container_type&& children, const didl::filter_ptr& filter, const client_interface_ptr& client, const config::config_ptr& config,
+			           const std::shared_ptr<page_recorder>& recorder = nullptr)
+				: m_children(std::make_shared<items::media_item::container_type>(std::move(children)))
+				, m_filter(filter)
+				, m_client(client)
+				, m_config(config)
+				, m_recorder(recorder)
+				, m_next(0)
+			{
+			}
+
+			bool operator()(std::string& out)
+			{
+				auto from = out.length();
+				bool more = write(out);
+
+				if (m_recorder)
+				{
+					m_recorder->record(out, from);
+					if (!more)
+						m_recorder->finish();
+				}
+
+				return more;
+			}
+
+			bool write(std::string& out)
+			{
+				didl::writer value(out, true);
+
+				auto& children = *m_children;
+				auto end = std::min(m_next + PAGE_SIZE, children.size());
+				for (; m_next < end; ++m_next)
+				{
+					auto& child = children[m_next];
+					auto mark = out.length();
+					try
+					{
+						log::debug() << "    [" << child->get_objectId_attr() << "] \"" << child->get_title() << "\"";
+						child->output(value, *m_filter, m_client, m_config);
+					}
+					catch (std::exception& e)
+					{
+						// the header is already sent, so the item is left out, and the DIDL-Lite stays whole
+						log::error() << "    [" << child->get_objectId_attr() << "] " << e.what();
+						out.resize(mark);
+						drop_page();
+					}
+					catch (...)
+					{
+						log::error() << "    [" << child->get_objectId_attr() << "] cannot be written";
+						out.resize(mark);
+						drop_page();
+					}
+				}
+
+				if (m_next < children.size())
+					return true;
+
+				value << "</DIDL-Lite>";
+				return false;
+			}
+
+			// a page with an item missing is not worth keeping
+			void drop_page()
+			{
+				if (m_recorder)
+					m_recorder->m_page = nullptr;
+			}
+		};
+	}
+
+	error_code ContentDirectory::Search(const client_info_ptr& client,
+	                                    const http::http_request& /*http_request*/,
+	                                    /* IN  */ const std::string& ContainerID,
+	                                    /* IN  */ const std::string& SearchCriteria,
+	                                    /* IN  */ const std::string& Filter,
+	                                    /* IN  */ ui4 StartingIndex,
+	                                    /* IN  */ ui4 RequestedCount,
+	                                    /* IN  */ const std::string& SortCriteria,
+	                                    /* OUT */ xml_escaped& Result,
+	                                    /* OUT */ ui4& NumberReturned,
+	                                    /* OUT */ ui4& TotalMatches,
+	                                    /* OUT */ ui4& UpdateID)
+	{
+		search::criteria query;
+		if (!query.compile(SearchCriteria))
+		{
+			log::warning() << "Search [" << ContainerID << "] cannot understand " << SearchCriteria;
+			return error::unsupported_or_invalid_search_criteria;
+		}
+
+		sorting::criteria order;
+		if (!order.compile(SortCriteria))
+			return error::unsupported_or_invalid_sort_criteria;
+
+		auto container = m_device->get_item(ContainerID);
+		if (!container || !container->is_folder())
+			return error::no_such_container;
+
+		auto found = m_device->search(query, container);
+
+		log::debug() << "Search [" << ContainerID << "] " << SearchCriteria << ": " << found.size() << " item(s)";
+
+		if (!order.empty())
+			std::stable_sort(found.begin(), found.end(), order);
+
+		TotalMatches = found.size();
+		auto start = std::min<size_t>(StartingIndex, found.size());
+		auto count = found.size() - start;
+		if (RequestedCount && count > RequestedCount)
+			count = RequestedCount;
+
+		items::media_item::container_type page(found.begin() + start, found.begin() + start + count);
+		NumberReturned = page.size();
+		UpdateID = container->update_id();
+
+		Result.clear();
+		didl::writer value(Result, true);
+		open_didl(value);
+
+		auto client_ptr = std::static_pointer_cast<client_interface>(client);
+		Result.stream(didl_pages(std::move(page), m_filters.get(Filter), client_ptr, m_device->config()));
 		return error::no_error;
 	}
 
@@ -115,8 +276,8 @@ namespace net { namespace ssdp { namespace import { namespace av {
 	                                    /* IN  */ const std::string& Filter,
 	                                    /* IN  */ ui4 StartingIndex,
 	                                    /* IN  */ ui4 RequestedCount,
-	                                    /* IN  */ const std::string& /*SortCriteria*/,
-	                                    /* OUT */ std::string& Result,
+	                                    /* IN  */ const std::string& SortCriteria,
+	                                    /* OUT */ xml_escaped& Result,
 	                                    /* OUT */ ui4& NumberReturned,
 	                                    /* OUT */ ui4& TotalMatches,
 	                                    /* OUT */ ui4& UpdateID)
@@ -124,13 +285,18 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		if (BrowseFlag == A_ARG_TYPE_BrowseFlag_UNKNOWN)
 			return error::invalid_action;
 
-		std::ostringstream value;
+		sorting::criteria order;
+		if (!order.compile(SortCriteria))
+			return error::unsupported_or_invalid_sort_criteria;
+
+		Result.clear();
+		didl::writer value(Result, true);
 		NumberReturned = 0;
 		TotalMatches = 0;
 		UpdateID = m_device->system_update_id();
 
+		open_didl(value);
 		{
-			value << R"(<DIDL-Lite xmlns="urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/" xmlns:dc="http://purl.org/dc/elements/1.1/" xmlns:upnp="urn:schemas-upnp-org:metadata-1-0/upnp/">)" "\n";
 			auto item = m_device->get_item(ObjectID);
 
 			if (item)
@@ -141,36 +307,120 @@ namespace net { namespace ssdp { namespace import { namespace av {
 			if (item)
 			{
 				auto client_ptr = std::static_pointer_cast<client_interface>(client);
-				auto filter = parse_filter(Filter);
+				auto filter = m_filters.get(Filter);
 
 				if (BrowseFlag == VALUE_BrowseDirectChildren)
 				{
-					auto children = item->list(StartingIndex, RequestedCount);
-					for (auto && child : children)
+					// a stale folder bumps its update ID here, which makes for a different key
+					item->check_updates();
+					UpdateID = item->update_id();
+
+					// the page has the address of the server in it, which changes with the interface
+					auto config = m_device->config();
+					auto host = net::to_string(config->iface) + ":" + std::to_string((int) config->port);
+
+					auto key = browse_cache::key(ObjectID, StartingIndex, RequestedCount, filter->bits(), order.str(), client ? client->get_name() : std::string(), host, UpdateID);
+					auto page = m_pages.find(key);
+					if (page)
 					{
-						log::debug() << "    [" << child->get_objectId_attr() << "] \"" << child->get_title() << "\"";
-						child->output(value, filter, client_ptr, m_device->config());
+						log::debug() << "    cached (" << m_pages.hits() << " hits, " << m_pages.misses() << " misses)";
+						Result.append(page->m_result);
+						NumberReturned = page->m_returned;
+						TotalMatches = page->m_total;
+						return error::no_error;
 					}
 
-					NumberReturned = children.size();
-					TotalMatches = item->predict_count(StartingIndex + NumberReturned);
-				}
-				else
-				{
-					item->check_updates();
-					item->output(value, filter, client_ptr, m_device->config());
-					NumberReturned = 1;
-					TotalMatches = 1;
+					auto generation = m_pages.generation();
+					auto pages = &m_pages;
+					auto result = &Result;
+					auto returned = &NumberReturned;
+					auto total = &TotalMatches;
+					auto update_id = &UpdateID;
+
+					// the output arguments live as long as the pending answer, so this may run on the scanner's thread
+					auto answer = [=](bool partial)
+					{
+						auto children = partial
+							? peek_page(item, StartingIndex, RequestedCount, order)
+							: item->sorted_list(StartingIndex, RequestedCount, order);
+
+						*returned = children.size();
+						*total = item->predict_count(StartingIndex + *returned);
+
+						// could change during the item->list
+						*update_id = item->update_id();
+
+						// a partial page will be stale as soon as the scan moves on
+						std::shared_ptr<page_recorder> recorder;
+						if (!partial)
+							recorder = std::make_shared<page_recorder>(pages, item->get_objectId_attr(), std::string(key), generation, *returned, *total);
+
+						// the items, and the closing tag, will be written by the response itself
+						result->stream(didl_pages(std::move(children), filter, client_ptr, config, recorder));
+					};
+
+					// closes the DIDL-Lite, when the page could not be had
+					auto empty_page = [=]
+					{
+						result->stream(nullptr);
+						didl::writer value(*result, true);
+						value << "</DIDL-Lite>";
+						*returned = 0;
+						*total = 0;
+					};
+
+					// any order needs the whole folder
+					auto wait_from = order.empty() ? StartingIndex : 0;
+					auto wait_count = order.empty() ? RequestedCount : items::INVALID_ID;
+
+					bool partial = config->partial_browse;
+					auto pending = std::make_shared<pending_answer>();
+					bool ready = partial
+						? item->wait_for(wait_from, wait_count, nullptr)
+						: item->wait_for(wait_from, wait_count, [=]
+						{
+							// the header is out already; whatever happens, the response has to be finished
+							try
+							{
+								answer(false);
+							}
+							catch (std::exception& e)
+							{
+								log::error() << "Browse [" << ObjectID << "]: " << e.what();
+								empty_page();
+							}
+							catch (...)
+							{
+								log::error() << "Browse [" << ObjectID << "] failed";
+								empty_page();
+							}
+							pending->done();
+						});
+
+					if (ready || partial)
+					{
+						if (!ready)
+							log::debug() << "    partial, the scan is still going";
+						answer(!ready);
+						return error::no_error;
+					}
+
+					// the page comes from the scanner, when it is filled; the Web thread is free meanwhile
+					log::debug() << "    waiting for the scan";
+					Result.defer(pending);
+					return error::no_error;
 				}
 
-				// could change during the item->list
+				item->check_updates();
+				item->output(value, *filter, client_ptr, m_device->config());
+				NumberReturned = 1;
+				TotalMatches = 1;
 				UpdateID = item->update_id();
 			}
 
 			value << "</DIDL-Lite>";
 		}
 
-		Result = std::move(value.str());
 		return error::no_error;
 	}
 
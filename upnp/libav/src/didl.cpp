@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <didl.hpp>
+
+namespace net { namespace ssdp { namespace import { namespace av { namespace didl {
+
+	static struct
+	{
+		const char* name;
+		property prop;
+	} s_properties [] = {
+		{ "@childCount",                     childCount },
+		{ "dc:date",                         dc_date },
+		{ "dc:creator",                      dc_creator },
+		{ "dc:description",                  dc_description },
+		{ "upnp:artist",                     upnp_artist },
+		{ "upnp:album",                      upnp_album },
+		{ "upnp:genre",                      upnp_genre },
+		{ "upnp:originalTrackNumber",        upnp_originalTrackNumber },
+		{ "upnp:albumArtURI",                upnp_albumArtURI },
+		{ "upnp:albumArtURI@dlna:profileID", upnp_albumArtURI_dlna_profileID },
+		{ "res",                             res },
+		{ "res@protocolInfo",                res_protocolInfo },
+		{ "res@bitrate",                     res_bitrate },
+		{ "res@duration",                    res_duration },
+		{ "res@sampleFrequency",             res_sampleFrequency },
+		{ "res@nrAudioChannels",             res_nrAudioChannels },
+		{ "res@size",                        res_size },
+		{ "res@resolution",                  res_resolution }
+	};
+
+	filter::filter(const std::string& text)
+	{
+		if (text.empty() || text == "*")
+		{
+			m_properties.set();
+			return;
+		}
+
+		std::string::size_type pos = 0;
+		for (;;)
+		{
+			auto comma = text.find(',', pos);
+			auto length = (comma == std::string::npos ? text.length() : comma) - pos;
+
+			for (auto&& known : s_properties)
+			{
+				if (!text.compare(pos, length, known.name))
+				{
+					m_properties.set(known.prop);
+					break;
+				}
+			}
+
+			if (comma == std::string::npos)
+				break;
+			pos = comma + 1;
+		}
+	}
+
+	filter_ptr filter_cache::get(const std::string& text)
+	{
+		if (text.empty() || text == "*")
+			return m_all;
+
+		std::lock_guard<std::mutex> lock(m_guard);
+		auto it = m_filters.find(text);
+		if (it != m_filters.end())
+			return it->second;
+
+		// a misbehaving client could send a new Filter every time
+		if (m_filters.size() >= MAX_FILTERS)
+			m_filters.clear();
+
+		auto compiled = std::make_shared<filter>(text);
+		m_filters[text] = compiled;
+		return compiled;
+	}
+
+}}}}} // net::ssdp::import::av::didl
@@ -223,6 +223,25 @@ namespace net
 					{ BSAC_ER,  48000, 6,  128000, audio::profile::AAC_BSAC_MULT5 },
 				};
 
+				static audio::profile guess_aac_priv(object_type type, int sample_rate, int channels, int bit_rate)
+				{
+					if (type == BSAC_ER && sample_rate < 16000)
+						return audio::profile::INVALID;
+					if (sample_rate < 8000)
+						return audio::profile::INVALID;
+
+					for (auto && priv : priv_profiles)
+					{
+						if (type != priv.m_type) continue;
+						if (sample_rate > priv.m_max_sample_rate) continue;
+						if (channels > priv.m_max_channels) continue;
+						if (bit_rate > priv.m_max_bit_rate) continue;
+						return priv.m_profile;
+					}
+
+					return audio::profile::INVALID;
+				}
+
 				static audio::profile guess_aac_priv(AVCodecContext *ac, object_type type)
 				{
 					if (!ac)
@@ -232,21 +251,21 @@ namespace net
 					if (ac->codec_id != AV_CODEC_ID_AAC)
 						return audio::profile::INVALID;
 
-					if (type == BSAC_ER && ac->sample_rate < 16000)
-						return audio::profile::INVALID;
-					if (ac->sample_rate < 8000)
-						return audio::profile::INVALID;
+					return guess_aac_priv(type, ac->sample_rate, ac->channels, ac->bit_rate);
+				}
 
-					for (auto && priv : priv_profiles)
+				static const Profile * from_profile(container_type type, audio::profile profile)
+				{
+					if (profile == audio::profile::INVALID)
+						return nullptr;
+
+					for (auto && map : mapping)
 					{
-						if (type != priv.m_type) continue;
-						if (ac->sample_rate > priv.m_max_sample_rate) continue;
-						if (ac->channels > priv.m_max_channels) continue;
-						if (ac->bit_rate > priv.m_max_bit_rate) continue;
-						return priv.m_profile;
+						if (map.m_container == type && map.m_audio_profile == profile)
+							return map.m_profile;
 					}
 
-					return audio::profile::INVALID;
+					return nullptr;
 				}
 
 				audio::profile guess_aac(AVCodecContext *ac)
@@ -276,16 +295,7 @@ namespace net
 					else
 						profile = guess_aac(codecs.m_audio.m_codec);
 
-					if (profile == audio::profile::INVALID)
-						return nullptr;
-
-					for (auto && map : mapping)
-					{
-						if (map.m_container == type && map.m_audio_profile == profile)
-							return map.m_profile;
-					}
-
-					return nullptr;
+					return from_profile(type, profile);
 				}
 			}
 
@@ -296,38 +306,38 @@ namespace net
 				static Profile mp3_upnp  { "MP3",  mime::AUDIO_MPEG, labels::AUDIO_2CH, Class::Audio, mp3 };
 				static Profile mp3x_upnp { "MP3X", mime::AUDIO_MPEG, labels::AUDIO_2CH, Class::Audio, mp3x };
 
-				static bool is_valid_mp3_common(AVCodecContext *ac)
+				struct params
 				{
-					if (ac->codec_id != AV_CODEC_ID_MP3) return false;
-					if (ac->channels > 2) return false;
+					int sample_rate;
+					int channels;
+					int bit_rate;
+				};
+
+				static bool is_valid_mp3_common(const params& ac)
+				{
+					if (ac.channels > 2) return false;
 					return true;
 				}
 
-				static bool is_valid_mp3_upnp(AVCodecContext *ac)
+				static bool is_valid_mp3_upnp(const params& ac)
 				{
-					if (!ac)
-						return false;
-
 					if (!is_valid_mp3_common(ac))
 						return false;
 
-					if (ac->sample_rate != 32000 &&
-						ac->sample_rate != 44100 &&
-						ac->sample_rate != 48000)
+					if (ac.sample_rate != 32000 &&
+						ac.sample_rate != 44100 &&
+						ac.sample_rate != 48000)
 						return false;
 
 					return true;
 				}
 
-				static bool is_valid_mp3(AVCodecContext *ac)
+				static bool is_valid_mp3(const params& ac)
 				{
-					if (!ac)
-						return false;
-
 					if (!is_valid_mp3_upnp(ac))
 						return false;
 
-					switch (ac->bit_rate)
+					switch (ac.bit_rate)
 					{
 					case 32000:
 					case 40000:
@@ -351,31 +361,25 @@ namespace net
 					return false;
 				}
 
-				static bool is_valid_mp3x_upnp(AVCodecContext *ac)
+				static bool is_valid_mp3x_upnp(const params& ac)
 				{
-					if (!ac)
-						return false;
-
 					if (!is_valid_mp3_common(ac))
 						return false;
 
-					if (ac->sample_rate != 16000 &&
-						ac->sample_rate != 22050 &&
-						ac->sample_rate != 24000)
+					if (ac.sample_rate != 16000 &&
+						ac.sample_rate != 22050 &&
+						ac.sample_rate != 24000)
 						return false;
 
 					return true;
 				}
 
-				static bool is_valid_mp3x(AVCodecContext *ac)
+				static bool is_valid_mp3x(const params& ac)
 				{
-					if (!ac)
-						return false;
-
 					if (!is_valid_mp3x_upnp(ac))
 						return false;
 
-					switch (ac->bit_rate)
+					switch (ac.bit_rate)
 					{
 					case 8000:
 					case 16000:
@@ -402,11 +406,8 @@ namespace net
 					return false;
 				}
 
-				profile guess_mp3(AVCodecContext *ac)
+				static profile guess_mp3(const params& ac)
 				{
-					if (!ac)
-						return profile::INVALID;
-
 					if (is_valid_mp3x(ac))
 						return profile::MP3_EXTENDED;
 
@@ -425,15 +426,20 @@ namespace net
 					return profile::INVALID;
 				}
 
-				static const Profile * probe(AVFormatContext *ctx, container::container_type container, const stream_codec& codecs)
+				profile guess_mp3(AVCodecContext *ac)
 				{
-					if (!stream_is_audio(ctx, container, codecs))
-						return nullptr;
+					if (!ac)
+						return profile::INVALID;
 
-					if (container != dlna::container::MP3)
-						return nullptr;
+					if (ac->codec_id != AV_CODEC_ID_MP3)
+						return profile::INVALID;
+
+					return guess_mp3(params { ac->sample_rate, ac->channels, ac->bit_rate });
+				}
 
-					switch (guess_mp3(codecs.m_audio.m_codec))
+				static const Profile * from_profile(profile profile)
+				{
+					switch (profile)
 					{
 					case profile::MP3:
 						return &mp3;
@@ -449,6 +455,28 @@ namespace net
 
 					return nullptr;
 				}
+
+				static const Profile * probe(AVFormatContext *ctx, container::container_type container, const stream_codec& codecs)
+				{
+					if (!stream_is_audio(ctx, container, codecs))
+						return nullptr;
+
+					if (container != dlna::container::MP3)
+						return nullptr;
+
+					return from_profile(guess_mp3(codecs.m_audio.m_codec));
+				}
+			}
+
+			const Profile* mp3_profile(int sample_rate, int channels, int bit_rate)
+			{
+				return mp3::from_profile(mp3::guess_mp3(mp3::params { sample_rate, channels, bit_rate }));
+			}
+
+			const Profile* aac_profile(int object_type, int sample_rate, int channels, int bit_rate)
+			{
+				auto profile = aac::guess_aac_priv((aac::object_type) object_type, sample_rate, channels, bit_rate);
+				return aac::from_profile(aac::MUXED, profile);
 			}
 
 #define GUESS(ns) { auto audio_profile = ns::guess_##ns(codec); if (audio_profile != profile::INVALID) return audio_profile; }
@@ -135,6 +135,16 @@ namespace net
 			}
 		}
 
+		const Profile* image::jpeg_profile(int width, int height)
+		{
+			return fit(jpeg::boundaries, width, height);
+		}
+
+		const Profile* image::png_profile(int width, int height)
+		{
+			return fit(png::boundaries, width, height);
+		}
+
 		void register_image_profiles()
 		{
 			image::jpeg::module::register_profiles("jpg,jpe,jpeg");
@@ -41,6 +41,30 @@ namespace net { namespace dlna {
 		register_image_profiles();
 		register_audio_profiles();
 		register_video_profiles();
+
+		static const char* served [] = {
+			mime::IMAGE_JPEG,
+			mime::IMAGE_PNG,
+			mime::IMAGE_GIF,
+			mime::IMAGE_BMP,
+
+			mime::AUDIO_DOLBY_DIGITAL,
+			mime::AUDIO_MPEG_4,
+			mime::AUDIO_3GP,
+			mime::AUDIO_ATRAC,
+			mime::AUDIO_ADTS,
+			mime::AUDIO_LPCM,
+			mime::AUDIO_MPEG,
+			mime::AUDIO_WMA,
+
+			mime::VIDEO_MPEG,
+			mime::VIDEO_MPEG_4,
+			mime::VIDEO_MPEG_TS,
+			mime::VIDEO_WMV
+		};
+
+		for (auto mime : served)
+			protocols().add_mime(mime);
 	}
 
 	init::~init()
@@ -432,6 +456,14 @@ namespace net { namespace dlna {
 		if (fs::is_directory(path))
 			return nullptr;
 
+		const Profile* profile = nullptr;
+		switch (native::probe(path, nullptr, profile))
+		{
+		case native::result::media: return profile;
+		case native::result::rejected: return nullptr;
+		default: break;
+		}
+
 		av_format_contex ctx { path };
 		if (!ctx)
 			return nullptr;
@@ -444,6 +476,14 @@ namespace net { namespace dlna {
 
 	const Profile* Profile::guess_from_memory(const char* data, size_t size)
 	{
+		const Profile* profile = nullptr;
+		switch (native::probe(data, size, nullptr, profile))
+		{
+		case native::result::media: return profile;
+		case native::result::rejected: return nullptr;
+		default: break;
+		}
+
 		av_format_contex ctx { data, size };
 		if (!ctx)
 			return nullptr;
@@ -454,7 +494,7 @@ namespace net { namespace dlna {
 		return ctx.guess_profile("MEMORY");
 	}
 
-	bool Item::open(const boost::filesystem::path& path)
+	bool Item::open(const boost::filesystem::path& path, prober use)
 	{
 		m_profile.clear();
 		m_meta.clear();
@@ -476,6 +516,27 @@ namespace net { namespace dlna {
 		}
 
 		m_class = Class::Unknown;
+
+		if (use != prober::ffmpeg)
+		{
+			m_props.clear();
+			m_cover.clear();
+
+			const Profile* profile = nullptr;
+			switch (native::probe(path, this, profile))
+			{
+			case native::result::media:
+				m_props.m_last_write_time = fs::last_write_time(path, ec);
+				if (ec) m_props.m_last_write_time = 0;
+				return true;
+			case native::result::rejected:
+				return false;
+			default:
+				if (use == prober::native)
+					return false;
+			}
+		}
+
 		av_format_contex ctx { path };
 		if (!ctx)
 			return false;
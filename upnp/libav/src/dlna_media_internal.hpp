@@ -314,11 +314,16 @@ namespace net
 			int m_max_width;
 			int m_max_height;
 
-			inline bool encases(const AVCodecContext* codec) const
+			inline bool encases(int width, int height) const
 			{
 				return
-					codec->width <= m_max_width &&
-					codec->height <= m_max_height;
+					width <= m_max_width &&
+					height <= m_max_height;
+			}
+
+			inline bool encases(const AVCodecContext* codec) const
+			{
+				return encases(codec->width, codec->height);
 			}
 		};
 
@@ -347,19 +352,25 @@ namespace net
 
 		namespace image
 		{
+			template <size_t len>
+			static inline const Profile* fit(const boundary(&boundaries)[len], int width, int height)
+			{
+				for (const auto& boundary : boundaries)
+				{
+					if (boundary.encases(width, height))
+						return boundary.m_profile;
+				}
+
+				return nullptr;
+			}
+
 			template <typename Final, AVCodecID... list>
 			struct image_module
 			{
 				template <size_t len>
 				static inline const Profile* probe(const boundary(&boundaries)[len], const AVCodecContext* codec)
 				{
-					for (const auto& boundary : boundaries)
-					{
-						if (boundary.encases(codec))
-							return boundary.m_profile;
-					}
-
-					return nullptr;
+					return fit(boundaries, codec->width, codec->height);
 				}
 
 				template <size_t len>
@@ -384,6 +395,41 @@ namespace net
 		void register_image_profiles();
 		void register_audio_profiles();
 		void register_video_profiles();
+
+		/*
+		 * The same profiles, for the native probers, which know the
+		 * parameters from the headers, without any AVCodecContext.
+		 */
+		namespace image
+		{
+			const Profile* jpeg_profile(int width, int height);
+			const Profile* png_profile(int width, int height);
+		}
+
+		namespace audio
+		{
+			const Profile* mp3_profile(int sample_rate, int channels, int bit_rate);
+			const Profile* aac_profile(int object_type, int sample_rate, int channels, int bit_rate);
+		}
+
+		/*
+		 * Header-only probers for the most common formats. They read a
+		 * few KiB of the file and fill the Item, or give up, in which case
+		 * ffmpeg has to look at the file.
+		 */
+		namespace native
+		{
+			enum class result
+			{
+				unknown,  // not a format known here; ffmpeg decides
+				media,    // the item is filled
+				rejected  // known, but there is no profile for it
+			};
+
+			// the item may be nullptr, if only the profile is needed
+			result probe(const boost::filesystem::path& path, Item* item, const Profile*& profile);
+			result probe(const char* data, size_t size, Item* item, const Profile*& profile);
+		}
 	}
 }
 
@@ -0,0 +1,1205 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "dlna_media_internal.hpp"
+#include <boost/filesystem/fstream.hpp>
+#include <cctype>
+#include <cstring>
+
+namespace fs = boost::filesystem;
+
+namespace net { namespace dlna { namespace native {
+
+	namespace
+	{
+		/*
+		 * The probers never look at the whole file. They ask for the few
+		 * bytes they need at a given offset, and the source either has
+		 * them or not.
+		 */
+		class source
+		{
+		public:
+			virtual ~source() {}
+			virtual uint64_t size() const = 0;
+			virtual std::size_t read(uint64_t offset, void* dst, std::size_t len) = 0;
+
+			bool read_all(uint64_t offset, void* dst, std::size_t len)
+			{
+				return read(offset, dst, len) == len;
+			}
+
+			bool read_all(uint64_t offset, std::size_t len, std::vector<char>& dst)
+			{
+				if (offset > size() || len > size() - offset)
+					return false;
+
+				dst.resize(len);
+				if (len && !read_all(offset, &dst[0], len))
+				{
+					dst.clear();
+					return false;
+				}
+				return true;
+			}
+		};
+
+		class file_source : public source
+		{
+		public:
+			file_source(const fs::path& path)
+				: m_file(path, std::ios::in | std::ios::binary)
+				, m_size(0)
+			{
+				boost::system::error_code ec;
+				m_size = fs::file_size(path, ec);
+				if (ec) m_size = 0;
+			}
+
+			explicit operator bool() const { return m_file.is_open() && m_size > 0; }
+			uint64_t size() const override { return m_size; }
+
+			std::size_t read(uint64_t offset, void* dst, std::size_t len) override
+			{
+				if (offset >= m_size)
+					return 0;
+
+				m_file.clear();
+				m_file.seekg(offset);
+				m_file.read((char*) dst, len);
+				return (std::size_t) m_file.gcount();
+			}
+
+		private:
+			fs::ifstream m_file;
+			uint64_t m_size;
+		};
+
+		class memory_source : public source
+		{
+		public:
+			memory_source(const char* data, std::size_t size)
+				: m_data(data)
+				, m_size(data ? size : 0)
+			{
+			}
+
+			uint64_t size() const override { return m_size; }
+
+			std::size_t read(uint64_t offset, void* dst, std::size_t len) override
+			{
+				if (offset >= m_size)
+					return 0;
+
+				if (len > m_size - offset)
+					len = (std::size_t) (m_size - offset);
+
+				memcpy(dst, m_data + offset, len);
+				return len;
+			}
+
+		private:
+			const char* m_data;
+			std::size_t m_size;
+		};
+
+		inline uint32_t be16(const uint8_t* p) { return (p[0] << 8) | p[1]; }
+		inline uint32_t be24(const uint8_t* p) { return (p[0] << 16) | (p[1] << 8) | p[2]; }
+		inline uint32_t be32(const uint8_t* p) { return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+		inline uint64_t be64(const uint8_t* p) { return ((uint64_t) be32(p) << 32) | be32(p + 4); }
+		inline uint32_t syncsafe(const uint8_t* p) { return ((p[0] & 0x7F) << 21) | ((p[1] & 0x7F) << 14) | ((p[2] & 0x7F) << 7) | (p[3] & 0x7F); }
+
+#define FOURCC(a, b, c, d) (((uint32_t) (uint8_t) (a) << 24) | ((uint8_t) (b) << 16) | ((uint8_t) (c) << 8) | (uint8_t) (d))
+
+		// tags are not going to be read, if they claim to be larger
+		static const std::size_t MAX_TEXT = 64 * 1024;
+		static const std::size_t MAX_COVER = 16 * 1024 * 1024;
+
+		void put_utf8(std::string& out, uint32_t ch)
+		{
+			if (ch < 0x80)
+				out.push_back((char) ch);
+			else if (ch < 0x800)
+			{
+				out.push_back((char) (0xC0 | (ch >> 6)));
+				out.push_back((char) (0x80 | (ch & 0x3F)));
+			}
+			else if (ch < 0x10000)
+			{
+				out.push_back((char) (0xE0 | (ch >> 12)));
+				out.push_back((char) (0x80 | ((ch >> 6) & 0x3F)));
+				out.push_back((char) (0x80 | (ch & 0x3F)));
+			}
+			else
+			{
+				out.push_back((char) (0xF0 | (ch >> 18)));
+				out.push_back((char) (0x80 | ((ch >> 12) & 0x3F)));
+				out.push_back((char) (0x80 | ((ch >> 6) & 0x3F)));
+				out.push_back((char) (0x80 | (ch & 0x3F)));
+			}
+		}
+
+		std::string from_latin1(const uint8_t* data, std::size_t len)
+		{
+			std::string out;
+			out.reserve(len);
+			for (std::size_t i = 0; i < len && data[i]; ++i)
+				put_utf8(out, data[i]);
+			return out;
+		}
+
+		std::string from_utf16(const uint8_t* data, std::size_t len, bool big_endian)
+		{
+			if (len >= 2)
+			{
+				if (data[0] == 0xFF && data[1] == 0xFE) { big_endian = false; data += 2; len -= 2; }
+				else if (data[0] == 0xFE && data[1] == 0xFF) { big_endian = true; data += 2; len -= 2; }
+			}
+
+			std::string out;
+			out.reserve(len / 2);
+			for (std::size_t i = 0; i + 1 < len; i += 2)
+			{
+				uint32_t ch = big_endian ? (data[i] << 8) | data[i + 1] : (data[i + 1] << 8) | data[i];
+				if (!ch)
+					break;
+
+				if (ch >= 0xD800 && ch < 0xDC00 && i + 3 < len)
+				{
+					uint32_t lo = big_endian ? (data[i + 2] << 8) | data[i + 3] : (data[i + 3] << 8) | data[i + 2];
+					if (lo >= 0xDC00 && lo < 0xE000)
+					{
+						ch = 0x10000 + ((ch - 0xD800) << 10) + (lo - 0xDC00);
+						i += 2;
+					}
+				}
+				put_utf8(out, ch);
+			}
+			return out;
+		}
+
+		std::string from_utf8(const uint8_t* data, std::size_t len)
+		{
+			std::size_t i = 0;
+			while (i < len && data[i]) ++i;
+			return std::string((const char*) data, i);
+		}
+
+		void trim(std::string& s)
+		{
+			auto pos = s.find_last_not_of(" \t\r\n");
+			s.erase(pos == std::string::npos ? 0 : pos + 1);
+		}
+
+		// the ID3v1 genres, together with the Winamp extensions
+		static const char* genres [] = {
+			"Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge", "Hip-Hop",
+			"Jazz", "Metal", "New Age", "Oldies", "Other", "Pop", "R&B", "Rap",
+			"Reggae", "Rock", "Techno", "Industrial", "Alternative", "Ska", "Death Metal", "Pranks",
+			"Soundtrack", "Euro-Techno", "Ambient", "Trip-Hop", "Vocal", "Jazz+Funk", "Fusion", "Trance",
+			"Classical", "Instrumental", "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise",
+			"AlternRock", "Bass", "Soul", "Punk", "Space", "Meditative", "Instrumental Pop", "Instrumental Rock",
+			"Ethnic", "Gothic", "Darkwave", "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream",
+			"Southern Rock", "Comedy", "Cult", "Gangsta", "Top 40", "Christian Rap", "Pop/Funk", "Jungle",
+			"Native American", "Cabaret", "New Wave", "Psychadelic", "Rave", "Showtunes", "Trailer", "Lo-Fi",
+			"Tribal", "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll", "Hard Rock",
+			"Folk", "Folk-Rock", "National Folk", "Swing", "Fast Fusion", "Bebob", "Latin", "Revival",
+			"Celtic", "Bluegrass", "Avantgarde", "Gothic Rock", "Progressive Rock", "Psychedelic Rock", "Symphonic Rock", "Slow Rock",
+			"Big Band", "Chorus", "Easy Listening", "Acoustic", "Humour", "Speech", "Chanson", "Opera",
+			"Chamber Music", "Sonata", "Symphony", "Booty Bass", "Primus", "Porn Groove", "Satire", "Slow Jam",
+			"Club", "Tango", "Samba", "Folklore", "Ballad", "Power Ballad", "Rhythmic Soul", "Freestyle",
+			"Duet", "Punk Rock", "Drum Solo", "A capella", "Euro-House", "Dance Hall", "Goa", "Drum & Bass",
+			"Club-House", "Hardcore", "Terror", "Indie", "BritPop", "Negerpunk", "Polsk Punk", "Beat",
+			"Christian Gangsta", "Heavy Metal", "Black Metal", "Crossover", "Contemporary Christian", "Christian Rock", "Merengue", "Salsa",
+			"Thrash Metal", "Anime", "JPop", "Synthpop"
+		};
+
+		const char* genre(unsigned id)
+		{
+			if (id < sizeof(genres) / sizeof(genres[0]))
+				return genres[id];
+			return nullptr;
+		}
+
+		// "(17)", "17", "(17)Rock" and "Rock" all end up as "Rock"
+		std::string id3_genre(const std::string& value)
+		{
+			const char* ptr = value.c_str();
+			bool paren = *ptr == '(';
+			if (paren) ++ptr;
+
+			if (!isdigit((unsigned char) *ptr))
+				return value;
+
+			char* end = nullptr;
+			unsigned long id = strtoul(ptr, &end, 10);
+			if (paren && *end == ')') ++end;
+			if (*end && paren)
+				return end;
+			if (*end)
+				return value;
+
+			auto name = genre((unsigned) id);
+			return name ? name : value;
+		}
+
+		/*
+		 * JPEG: the dimensions are in the first SOFn segment; everything
+		 * before it (EXIF and other APPn included) is skipped by its length.
+		 */
+		result probe_jpeg(source& src, Item* item, const Profile*& profile)
+		{
+			uint64_t offset = 2;
+			for (int segments = 0; segments < 256; ++segments)
+			{
+				uint8_t hdr[4];
+				if (!src.read_all(offset, hdr, 2) || hdr[0] != 0xFF)
+					return result::unknown;
+
+				uint8_t marker = hdr[1];
+				if (marker == 0xFF)
+				{
+					++offset;
+					continue;
+				}
+
+				if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8))
+				{
+					offset += 2;
+					continue;
+				}
+
+				// the image data or the end of it, without any frame header
+				if (marker == 0xD9 || marker == 0xDA)
+					return result::unknown;
+
+				if (!src.read_all(offset, hdr, 4))
+					return result::unknown;
+
+				uint32_t len = be16(hdr + 2);
+				if (len < 2)
+					return result::unknown;
+
+				if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+				{
+					uint8_t sof[6];
+					if (len < 8 || !src.read_all(offset + 4, sof, sizeof(sof)))
+						return result::unknown;
+
+					int height = be16(sof + 1);
+					int width = be16(sof + 3);
+					if (!width || !height)
+						return result::unknown;
+
+					profile = image::jpeg_profile(width, height);
+					if (!profile)
+						return result::rejected;
+
+					if (item)
+					{
+						item->m_props.m_width = width;
+						item->m_props.m_height = height;
+					}
+					return result::media;
+				}
+
+				offset += 2 + len;
+			}
+
+			return result::unknown;
+		}
+
+		/*
+		 * PNG: the IHDR must be the very first chunk.
+		 */
+		result probe_png(source& src, Item* item, const Profile*& profile)
+		{
+			uint8_t ihdr[16];
+			if (!src.read_all(8, ihdr, sizeof(ihdr)))
+				return result::unknown;
+
+			if (be32(ihdr) < 13 || be32(ihdr + 4) != FOURCC('I', 'H', 'D', 'R'))
+				return result::unknown;
+
+			int width = be32(ihdr + 8);
+			int height = be32(ihdr + 12);
+			if (width <= 0 || height <= 0)
+				return result::unknown;
+
+			profile = image::png_profile(width, height);
+			if (!profile)
+				return result::rejected;
+
+			if (item)
+			{
+				item->m_props.m_width = width;
+				item->m_props.m_height = height;
+			}
+			return result::media;
+		}
+
+		namespace mp3
+		{
+			struct frame
+			{
+				int version;     // 0: MPEG-2.5, 2: MPEG-2, 3: MPEG-1
+				int bit_rate;
+				int sample_rate;
+				int channels;
+				uint32_t length;
+				uint32_t samples;
+				uint32_t side_info;
+
+				bool parse(const uint8_t* p)
+				{
+					static const int mpeg1_rates [] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 };
+					static const int mpeg2_rates [] = { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 };
+					static const int sample_rates [] = { 44100, 48000, 32000 };
+
+					if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0)
+						return false;
+
+					version = (p[1] >> 3) & 3;
+					int layer = (p[1] >> 1) & 3; // 1: Layer III
+					int rate_index = p[2] >> 4;
+					int freq_index = (p[2] >> 2) & 3;
+					int padding = (p[2] >> 1) & 1;
+
+					// Layers I and II are not guessed here
+					if (version == 1 || layer != 1 || freq_index == 3)
+						return false;
+
+					// free format is not guessed; the header is good enough for ffmpeg
+					if (rate_index == 0 || rate_index == 15)
+						return false;
+
+					bool mpeg1 = version == 3;
+					sample_rate = sample_rates[freq_index] >> (mpeg1 ? 0 : version == 2 ? 1 : 2);
+					channels = (p[3] >> 6) == 3 ? 1 : 2;
+
+					bit_rate = (mpeg1 ? mpeg1_rates : mpeg2_rates)[rate_index] * 1000;
+					samples = mpeg1 ? 1152 : 576;
+					length = (mpeg1 ? 144 : 72) * bit_rate / sample_rate + padding;
+					side_info = mpeg1 ? (channels == 1 ? 17 : 32) : (channels == 1 ? 9 : 17);
+					return true;
+				}
+			};
+
+			struct id3_reader
+			{
+				source& m_src;
+				Item* m_item;
+				int m_version;
+				bool m_has_cover;
+
+				id3_reader(source& src, Item* item, int version)
+					: m_src(src)
+					, m_item(item)
+					, m_version(version)
+					, m_has_cover(false)
+				{
+				}
+
+				std::string text(uint8_t encoding, const uint8_t* data, std::size_t len)
+				{
+					switch (encoding)
+					{
+					case 0: return from_latin1(data, len);
+					case 1: return from_utf16(data, len, false);
+					case 2: return from_utf16(data, len, true);
+					case 3: return from_utf8(data, len);
+					}
+					return std::string();
+				}
+
+				// the length of a zero-terminated string, including the terminator
+				static std::size_t skip_string(uint8_t encoding, const uint8_t* data, std::size_t len)
+				{
+					if (encoding == 1 || encoding == 2)
+					{
+						for (std::size_t i = 0; i + 1 < len; i += 2)
+							if (!data[i] && !data[i + 1])
+								return i + 2;
+						return len;
+					}
+
+					for (std::size_t i = 0; i < len; ++i)
+						if (!data[i])
+							return i + 1;
+					return len;
+				}
+
+				void text_frame(uint32_t id, const uint8_t* data, std::size_t len)
+				{
+					if (len < 2)
+						return;
+
+					auto value = text(data[0], data + 1, len - 1);
+					trim(value);
+					if (value.empty())
+						return;
+
+					auto& meta = m_item->m_meta;
+					switch (id)
+					{
+					case FOURCC('T', 'I', 'T', '2'): meta.m_title = value; break;
+					case FOURCC('T', 'P', 'E', '1'): meta.m_artist = value; break;
+					case FOURCC('T', 'P', 'E', '2'): meta.m_album_artist = value; break;
+					case FOURCC('T', 'C', 'O', 'M'): meta.m_composer = value; break;
+					case FOURCC('T', 'A', 'L', 'B'): meta.m_album = value; break;
+					case FOURCC('T', 'C', 'O', 'N'): meta.m_genre = id3_genre(value); break;
+					case FOURCC('T', 'D', 'R', 'C'):
+					case FOURCC('T', 'Y', 'E', 'R'): if (meta.m_date.empty()) meta.m_date = value; break;
+					case FOURCC('T', 'R', 'C', 'K'): meta.m_track = atoi(value.c_str()); break;
+					}
+				}
+
+				void comment_frame(const uint8_t* data, std::size_t len)
+				{
+					if (len < 5 || !m_item->m_meta.m_comment.empty())
+						return;
+
+					uint8_t encoding = data[0];
+					auto descr = skip_string(encoding, data + 4, len - 4);
+					if (!text(encoding, data + 4, descr).empty())
+						return; // only the comment without a description is the comment
+
+					auto value = text(encoding, data + 4 + descr, len - 4 - descr);
+					trim(value);
+					m_item->m_meta.m_comment = value;
+				}
+
+				// only the header of the picture frame is in the data; the picture itself is read from its offset
+				void picture_frame(bool v22, const uint8_t* data, std::size_t len, uint64_t offset, uint64_t size)
+				{
+					if (m_has_cover || len < 2)
+						return;
+
+					uint8_t encoding = data[0];
+					std::size_t pos = 1;
+					if (v22)
+						pos += 3;
+					else
+						pos += skip_string(0, data + pos, len - pos);
+
+					pos += 1; // picture type
+					if (pos >= len)
+						return;
+
+					pos += skip_string(encoding, data + pos, len - pos);
+					if (pos >= size || size - pos > MAX_COVER)
+						return;
+
+					m_has_cover = m_src.read_all(offset + pos, (std::size_t) (size - pos), m_item->m_cover);
+				}
+
+				// false means the tag is something, this reader does not understand
+				bool read(uint64_t offset, uint64_t end)
+				{
+					bool v22 = m_version == 2;
+					std::size_t header = v22 ? 6 : 10;
+
+					while (offset + header <= end)
+					{
+						uint8_t hdr[10];
+						if (!m_src.read_all(offset, hdr, header))
+							return false;
+
+						if (!hdr[0])
+							break; // padding
+
+						uint32_t id;
+						uint64_t size;
+						uint8_t flags = 0;
+						if (v22)
+						{
+							// v2.2 names are mapped onto their v2.3 counterparts
+							switch (be24(hdr))
+							{
+							case FOURCC(0, 'T', 'T', '2'): id = FOURCC('T', 'I', 'T', '2'); break;
+							case FOURCC(0, 'T', 'P', '1'): id = FOURCC('T', 'P', 'E', '1'); break;
+							case FOURCC(0, 'T', 'P', '2'): id = FOURCC('T', 'P', 'E', '2'); break;
+							case FOURCC(0, 'T', 'C', 'M'): id = FOURCC('T', 'C', 'O', 'M'); break;
+							case FOURCC(0, 'T', 'A', 'L'): id = FOURCC('T', 'A', 'L', 'B'); break;
+							case FOURCC(0, 'T', 'C', 'O'): id = FOURCC('T', 'C', 'O', 'N'); break;
+							case FOURCC(0, 'T', 'Y', 'E'): id = FOURCC('T', 'Y', 'E', 'R'); break;
+							case FOURCC(0, 'T', 'R', 'K'): id = FOURCC('T', 'R', 'C', 'K'); break;
+							case FOURCC(0, 'C', 'O', 'M'): id = FOURCC('C', 'O', 'M', 'M'); break;
+							case FOURCC(0, 'P', 'I', 'C'): id = FOURCC('A', 'P', 'I', 'C'); break;
+							default: id = 0;
+							}
+							size = be24(hdr + 3);
+						}
+						else
+						{
+							id = be32(hdr);
+							size = m_version == 4 ? syncsafe(hdr + 4) : be32(hdr + 4);
+							flags = hdr[9];
+						}
+
+						uint64_t data = offset + header;
+						offset = data + size;
+						if (offset > end)
+							return false;
+
+						if (m_version == 3)
+						{
+							if (flags & 0xC0) continue; // compressed or encrypted
+							if (flags & 0x20) { ++data; --size; } // group id
+						}
+						else if (m_version == 4)
+						{
+							if (flags & 0x0E) continue; // compressed, encrypted or unsynchronised
+							if (flags & 0x40) { ++data; --size; } // group id
+							if (flags & 0x01) { data += 4; size -= 4; } // data length indicator
+						}
+
+						if ((int64_t) size <= 0)
+							continue;
+
+						bool is_text = (id >> 24) == 'T' && id != FOURCC('T', 'X', 'X', 'X');
+						bool is_comment = id == FOURCC('C', 'O', 'M', 'M');
+						bool is_picture = id == FOURCC('A', 'P', 'I', 'C');
+						if (!is_text && !is_comment && !is_picture)
+							continue;
+
+						// for the picture, the mime type and the description is enough
+						std::size_t len = (std::size_t) std::min<uint64_t>(size, is_picture ? 1024 : MAX_TEXT);
+						std::vector<char> buffer;
+						if (!m_src.read_all(data, len, buffer))
+							return false;
+
+						auto bytes = (const uint8_t*) buffer.data();
+						if (is_text)
+							text_frame(id, bytes, len);
+						else if (is_comment)
+							comment_frame(bytes, len);
+						else
+							picture_frame(v22, bytes, len, data, size);
+					}
+
+					return true;
+				}
+			};
+
+			void read_id3v1(source& src, uint64_t offset, ItemMetadata& meta)
+			{
+				uint8_t tag[128];
+				if (!src.read_all(offset, tag, sizeof(tag)) || memcmp(tag, "TAG", 3))
+					return;
+
+				auto fill = [](std::string& dst, const uint8_t* data, std::size_t len)
+				{
+					if (!dst.empty())
+						return;
+					dst = from_latin1(data, len);
+					trim(dst);
+				};
+
+				fill(meta.m_title, tag + 3, 30);
+				fill(meta.m_artist, tag + 33, 30);
+				fill(meta.m_album, tag + 63, 30);
+				fill(meta.m_date, tag + 93, 4);
+				fill(meta.m_comment, tag + 97, tag[125] ? 30 : 28);
+				if (!tag[125] && tag[126] && !meta.m_track)
+					meta.m_track = tag[126];
+				if (meta.m_genre.empty())
+				{
+					auto name = genre(tag[127]);
+					if (name)
+						meta.m_genre = name;
+				}
+			}
+
+			result probe(source& src, Item* item, const Profile*& profile)
+			{
+				uint64_t audio = 0;
+				uint64_t end = src.size();
+
+				uint8_t hdr[10];
+				if (!src.read_all(0, hdr, sizeof(hdr)))
+					return result::unknown;
+
+				int id3_version = 0;
+				uint8_t id3_flags = 0;
+				if (!memcmp(hdr, "ID3", 3))
+				{
+					id3_version = hdr[3];
+					id3_flags = hdr[5];
+					if (id3_version < 2 || id3_version > 4)
+						return result::unknown;
+
+					// the unsynchronisation of the whole tag is left to ffmpeg
+					if (id3_flags & 0x80)
+						return result::unknown;
+
+					audio = 10 + syncsafe(hdr + 6);
+					if (id3_version == 4 && (id3_flags & 0x10))
+						audio += 10;
+				}
+
+				uint8_t buffer[4096];
+				std::size_t len = src.read(audio, buffer, sizeof(buffer));
+
+				// the first frame must be followed by another one
+				frame first;
+				std::size_t pos = 0;
+				for (; pos + 4 <= len; ++pos)
+				{
+					if (!first.parse(buffer + pos))
+						continue;
+
+					uint8_t next_hdr[4];
+					frame next;
+					if (src.read_all(audio + pos + first.length, next_hdr, 4) &&
+						next.parse(next_hdr) &&
+						next.version == first.version &&
+						next.sample_rate == first.sample_rate)
+						break;
+				}
+
+				if (pos + 4 > len)
+					return result::unknown;
+
+				audio += pos;
+
+				// Xing/Info or VBRI frame tells the length of the file; the bit rate is taken from the first real frame
+				uint64_t frames = 0;
+				uint8_t vbr[64];
+				if (src.read_all(audio, vbr, sizeof(vbr)))
+				{
+					const uint8_t* xing = vbr + 4 + first.side_info;
+					if (!memcmp(xing, "Xing", 4) || !memcmp(xing, "Info", 4))
+					{
+						if (be32(xing + 4) & 1)
+							frames = be32(xing + 8);
+					}
+					else if (!memcmp(vbr + 36, "VBRI", 4))
+						frames = be32(vbr + 36 + 14);
+
+					if (frames)
+					{
+						uint8_t next_hdr[4];
+						frame next;
+						if (src.read_all(audio + first.length, next_hdr, 4) && next.parse(next_hdr))
+						{
+							first.bit_rate = next.bit_rate;
+							first.channels = next.channels;
+						}
+					}
+				}
+
+				uint8_t tag[3];
+				bool has_id3v1 = end >= 128 && src.read_all(end - 128, tag, 3) && !memcmp(tag, "TAG", 3);
+				if (has_id3v1)
+					end -= 128;
+
+				profile = audio::mp3_profile(first.sample_rate, first.channels, first.bit_rate);
+				if (!profile)
+					return result::unknown;
+
+				if (!item)
+					return result::media;
+
+				auto& props = item->m_props;
+				props.m_sample_freq = first.sample_rate;
+				props.m_channels = first.channels;
+				uint64_t bytes = end > audio ? end - audio : 0;
+				if (frames)
+					props.m_duration = (net::ulong) (frames * first.samples / first.sample_rate);
+				else if (first.bit_rate)
+					props.m_duration = (net::ulong) (bytes * 8 / first.bit_rate);
+
+				props.m_bitrate = props.m_duration ? (net::ulong) (bytes / props.m_duration) : first.bit_rate / 8;
+
+				if (id3_version)
+				{
+					id3_reader reader { src, item, id3_version };
+					uint64_t offset = 10;
+					if (id3_flags & 0x40)
+					{
+						// extended header
+						uint8_t size[4];
+						if (!src.read_all(offset, size, sizeof(size)))
+							return result::unknown;
+						offset += id3_version == 4 ? syncsafe(size) : 4 + be32(size);
+					}
+
+					if (!reader.read(offset, 10 + syncsafe(hdr + 6)))
+					{
+						item->m_meta.clear();
+						item->m_cover.clear();
+						return result::unknown;
+					}
+				}
+
+				if (has_id3v1)
+					read_id3v1(src, end, item->m_meta);
+
+				return result::media;
+			}
+		}
+
+		namespace mp4
+		{
+			struct box
+			{
+				uint32_t type;
+				uint64_t offset; // of the contents
+				uint64_t size;   // of the contents
+			};
+
+			// reads the header of the box at pos and moves pos past the box
+			bool next(source& src, uint64_t& pos, uint64_t end, box& out)
+			{
+				uint8_t hdr[16];
+				if (pos + 8 > end || !src.read_all(pos, hdr, 8))
+					return false;
+
+				uint64_t size = be32(hdr);
+				uint64_t header = 8;
+				out.type = be32(hdr + 4);
+
+				if (size == 1)
+				{
+					if (!src.read_all(pos + 8, hdr + 8, 8))
+						return false;
+					size = be64(hdr + 8);
+					header = 16;
+				}
+				else if (size == 0)
+					size = end - pos;
+
+				if (size < header || size > end - pos)
+					return false;
+
+				out.offset = pos + header;
+				out.size = size - header;
+				pos += size;
+				return true;
+			}
+
+			bool find(source& src, uint64_t begin, uint64_t end, uint32_t type, box& out)
+			{
+				while (next(src, begin, end, out))
+				{
+					if (out.type == type)
+						return true;
+				}
+				return false;
+			}
+
+			bool find(source& src, const box& parent, uint32_t type, box& out)
+			{
+				return find(src, parent.offset, parent.offset + parent.size, type, out);
+			}
+
+			// descriptor length: up to four bytes, seven bits each
+			bool descriptor(const uint8_t*& ptr, const uint8_t* end, uint8_t& tag, uint32_t& len)
+			{
+				if (ptr >= end)
+					return false;
+
+				tag = *ptr++;
+				len = 0;
+				for (int i = 0; i < 4 && ptr < end; ++i)
+				{
+					uint8_t c = *ptr++;
+					len = (len << 7) | (c & 0x7F);
+					if (!(c & 0x80))
+						return len <= (uint32_t) (end - ptr);
+				}
+				return false;
+			}
+
+			struct audio_track
+			{
+				int object_type;
+				int sample_rate;
+				int channels;
+				int bit_rate;
+			};
+
+			bool read_esds(source& src, const box& esds, audio_track& track)
+			{
+				std::vector<char> buffer;
+				if (esds.size > 1024 || !src.read_all(esds.offset, (std::size_t) esds.size, buffer) || buffer.size() < 4)
+					return false;
+
+				const uint8_t* ptr = (const uint8_t*) buffer.data() + 4; // version and flags
+				const uint8_t* end = (const uint8_t*) buffer.data() + buffer.size();
+
+				uint8_t tag;
+				uint32_t len;
+				if (!descriptor(ptr, end, tag, len) || tag != 3 || len < 3)
+					return false;
+
+				end = ptr + len;
+				uint8_t flags = ptr[2];
+				ptr += 3;
+				if (flags & 0x80) ptr += 2;
+				if (flags & 0x40) { if (ptr >= end) return false; ptr += 1 + *ptr; }
+				if (flags & 0x20) ptr += 2;
+
+				if (!descriptor(ptr, end, tag, len) || tag != 4 || len < 13)
+					return false;
+
+				uint8_t oti = ptr[0];
+				if (oti != 0x40 && (oti < 0x66 || oti > 0x68))
+					return false;
+
+				track.bit_rate = be32(ptr + 9);
+				end = ptr + len;
+				ptr += 13;
+
+				if (!descriptor(ptr, end, tag, len) || tag != 5 || len < 2)
+					return false;
+
+				static const int sample_rates [] = {
+					96000, 88200, 64000, 48000, 44100, 32000,
+					24000, 22050, 16000, 12000, 11025, 8000, 7350
+				};
+
+				int freq_index = ((ptr[0] & 0x07) << 1) | (ptr[1] >> 7);
+				if (freq_index >= (int) (sizeof(sample_rates) / sizeof(sample_rates[0])))
+					return false;
+
+				track.object_type = ptr[0] >> 3;
+				track.sample_rate = sample_rates[freq_index];
+				track.channels = (ptr[1] >> 3) & 0x0F;
+				return true;
+			}
+
+			// false for anything other than AAC
+			bool read_stsd(source& src, const box& stsd, audio_track& track)
+			{
+				uint64_t pos = stsd.offset + 8; // version, flags and entry count
+				box entry;
+				if (!next(src, pos, stsd.offset + stsd.size, entry) || entry.type != FOURCC('m', 'p', '4', 'a'))
+					return false;
+
+				uint8_t fields[28];
+				if (entry.size < sizeof(fields) || !src.read_all(entry.offset, fields, sizeof(fields)))
+					return false;
+
+				uint64_t children = 28;
+				switch (be16(fields + 8))
+				{
+				case 0: break;
+				case 1: children += 16; break;
+				case 2: children += 36; break;
+				default: return false;
+				}
+
+				if (children > entry.size)
+					return false;
+
+				box esds;
+				box wave;
+				if (!find(src, entry.offset + children, entry.offset + entry.size, FOURCC('e', 's', 'd', 's'), esds))
+				{
+					if (!find(src, entry.offset + children, entry.offset + entry.size, FOURCC('w', 'a', 'v', 'e'), wave) ||
+						!find(src, wave, FOURCC('e', 's', 'd', 's'), esds))
+						return false;
+				}
+
+				if (!read_esds(src, esds, track))
+					return false;
+
+				if (!track.channels)
+					track.channels = be16(fields + 16);
+
+				return true;
+			}
+
+			struct ilst_reader
+			{
+				source& m_src;
+				Item* m_item;
+
+				bool data(const box& item, box& out)
+				{
+					return find(m_src, item, FOURCC('d', 'a', 't', 'a'), out) && out.size >= 8;
+				}
+
+				bool text(const box& item, std::string& dst)
+				{
+					box value;
+					if (!data(item, value) || value.size - 8 > MAX_TEXT)
+						return false;
+
+					std::vector<char> buffer;
+					if (!m_src.read_all(value.offset + 8, (std::size_t) (value.size - 8), buffer))
+						return false;
+
+					dst = from_utf8((const uint8_t*) buffer.data(), buffer.size());
+					trim(dst);
+					return true;
+				}
+
+				bool binary(const box& item, uint8_t* dst, std::size_t len)
+				{
+					box value;
+					return data(item, value) && value.size >= 8 + len && m_src.read_all(value.offset + 8, dst, len);
+				}
+
+				void read(const box& ilst)
+				{
+					auto& meta = m_item->m_meta;
+					uint64_t pos = ilst.offset;
+					uint64_t end = ilst.offset + ilst.size;
+					box item;
+					while (next(m_src, pos, end, item))
+					{
+						switch (item.type)
+						{
+						case FOURCC(0xA9, 'n', 'a', 'm'): text(item, meta.m_title); break;
+						case FOURCC(0xA9, 'A', 'R', 'T'): text(item, meta.m_artist); break;
+						case FOURCC('a', 'A', 'R', 'T'): text(item, meta.m_album_artist); break;
+						case FOURCC(0xA9, 'w', 'r', 't'): text(item, meta.m_composer); break;
+						case FOURCC(0xA9, 'a', 'l', 'b'): text(item, meta.m_album); break;
+						case FOURCC(0xA9, 'g', 'e', 'n'): text(item, meta.m_genre); break;
+						case FOURCC(0xA9, 'd', 'a', 'y'): text(item, meta.m_date); break;
+						case FOURCC(0xA9, 'c', 'm', 't'): text(item, meta.m_comment); break;
+						case FOURCC('g', 'n', 'r', 'e'):
+							{
+								uint8_t id[2];
+								if (meta.m_genre.empty() && binary(item, id, sizeof(id)) && be16(id))
+								{
+									auto name = genre(be16(id) - 1);
+									if (name)
+										meta.m_genre = name;
+								}
+							}
+							break;
+						case FOURCC('t', 'r', 'k', 'n'):
+							{
+								uint8_t trkn[4];
+								if (binary(item, trkn, sizeof(trkn)))
+									meta.m_track = be16(trkn + 2);
+							}
+							break;
+						case FOURCC('c', 'o', 'v', 'r'):
+							{
+								box value;
+								if (m_item->m_cover.empty() && data(item, value) && value.size - 8 <= MAX_COVER)
+									m_src.read_all(value.offset + 8, (std::size_t) (value.size - 8), m_item->m_cover);
+							}
+							break;
+						}
+					}
+				}
+			};
+
+			void read_udta(source& src, const box& moov, Item* item)
+			{
+				box udta, meta, ilst;
+				if (!find(src, moov, FOURCC('u', 'd', 't', 'a'), udta) ||
+					!find(src, udta, FOURCC('m', 'e', 't', 'a'), meta))
+					return;
+
+				// the ISO meta is a full box, the QuickTime one is not
+				uint8_t hdr[8];
+				if (meta.size >= 12 && src.read_all(meta.offset, hdr, sizeof(hdr)) && be32(hdr + 4) != FOURCC('h', 'd', 'l', 'r'))
+				{
+					meta.offset += 4;
+					meta.size -= 4;
+				}
+
+				if (!find(src, meta, FOURCC('i', 'l', 's', 't'), ilst))
+					return;
+
+				ilst_reader reader { src, item };
+				reader.read(ilst);
+			}
+
+			result probe(source& src, Item* item, const Profile*& profile, bool third_gen)
+			{
+				uint8_t brand[4];
+				if (third_gen || (src.read_all(8, brand, sizeof(brand)) && !memcmp(brand, "3g", 2)))
+					return result::unknown; // 3GPP profiles are guessed by ffmpeg
+
+				box moov;
+				if (!find(src, 0, src.size(), FOURCC('m', 'o', 'o', 'v'), moov))
+					return result::unknown;
+
+				box mvhd;
+				uint8_t header[32];
+				if (!find(src, moov, FOURCC('m', 'v', 'h', 'd'), mvhd) ||
+					mvhd.size < sizeof(header) ||
+					!src.read_all(mvhd.offset, header, sizeof(header)))
+					return result::unknown;
+
+				uint64_t timescale, duration;
+				if (header[0] == 1)
+				{
+					timescale = be32(header + 20);
+					duration = be64(header + 24);
+				}
+				else
+				{
+					timescale = be32(header + 12);
+					duration = be32(header + 16);
+				}
+
+				bool found = false;
+				audio_track track;
+				uint64_t pos = moov.offset;
+				uint64_t end = moov.offset + moov.size;
+				box trak;
+				while (find(src, pos, end, FOURCC('t', 'r', 'a', 'k'), trak))
+				{
+					pos = trak.offset + trak.size;
+
+					box mdia, hdlr;
+					uint8_t handler[12];
+					if (!find(src, trak, FOURCC('m', 'd', 'i', 'a'), mdia) ||
+						!find(src, mdia, FOURCC('h', 'd', 'l', 'r'), hdlr) ||
+						hdlr.size < sizeof(handler) ||
+						!src.read_all(hdlr.offset, handler, sizeof(handler)))
+						return result::unknown;
+
+					uint32_t type = be32(handler + 8);
+					if (type == FOURCC('v', 'i', 'd', 'e'))
+						return result::unknown;
+
+					if (type != FOURCC('s', 'o', 'u', 'n') || found)
+						continue;
+
+					box minf, stbl, stsd;
+					if (!find(src, mdia, FOURCC('m', 'i', 'n', 'f'), minf) ||
+						!find(src, minf, FOURCC('s', 't', 'b', 'l'), stbl) ||
+						!find(src, stbl, FOURCC('s', 't', 's', 'd'), stsd) ||
+						!read_stsd(src, stsd, track))
+						return result::unknown;
+
+					found = true;
+				}
+
+				if (!found || !track.bit_rate)
+					return result::unknown;
+
+				/*
+				 * HE-AAC and the LC streams, which could hide an implicit SBR
+				 * (and would be decoded with twice the sample rate), go to ffmpeg.
+				 */
+				switch (track.object_type)
+				{
+				case 2: case 4: case 17: case 19: break;
+				default: return result::unknown;
+				}
+				if (track.sample_rate <= 24000)
+					return result::unknown;
+
+				profile = audio::aac_profile(track.object_type, track.sample_rate, track.channels, track.bit_rate);
+				if (!profile)
+					return result::unknown;
+
+				if (!item)
+					return result::media;
+
+				auto& props = item->m_props;
+				props.m_sample_freq = track.sample_rate;
+				props.m_channels = track.channels;
+				if (timescale)
+					props.m_duration = (net::ulong) (duration / timescale);
+				props.m_bitrate = props.m_duration ? (net::ulong) (src.size() / props.m_duration) : track.bit_rate / 8;
+
+				read_udta(src, moov, item);
+				return result::media;
+			}
+		}
+
+		result probe(source& src, const fs::path& path, Item* item, const Profile*& profile)
+		{
+			uint8_t magic[12];
+			if (!src.read_all(0, magic, sizeof(magic)))
+				return result::unknown;
+
+			if (magic[0] == 0xFF && magic[1] == 0xD8 && magic[2] == 0xFF)
+				return probe_jpeg(src, item, profile);
+
+			if (!memcmp(magic, "\x89PNG\r\n\x1a\n", 8))
+				return probe_png(src, item, profile);
+
+			if (!memcmp(magic + 4, "ftyp", 4))
+			{
+				auto ext = path.extension().string();
+				std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+				return mp4::probe(src, item, profile, ext == ".3gp" || ext == ".3gpp" || ext == ".3g2");
+			}
+
+			// there is no DLNA profile for neither of those
+			if (!memcmp(magic, "fLaC", 4) || !memcmp(magic, "OggS", 4))
+				return result::rejected;
+
+			// the ADTS streams have the layer bits cleared
+			if (!memcmp(magic, "ID3", 3) || (magic[0] == 0xFF && (magic[1] & 0xE0) == 0xE0 && (magic[1] & 0x06)))
+				return mp3::probe(src, item, profile);
+
+			return result::unknown;
+		}
+
+		result finish(source& src, result ret, Item* item, const Profile* profile)
+		{
+			if (!item)
+				return ret;
+
+			if (ret != result::media)
+			{
+				item->m_meta.clear();
+				item->m_props.clear();
+				item->m_cover.clear();
+				return ret;
+			}
+
+			item->m_profile = *profile;
+			item->m_class = profile->m_class;
+			item->m_props.m_size = (size_t) src.size();
+			return ret;
+		}
+	}
+
+	result probe(const fs::path& path, Item* item, const Profile*& profile)
+	{
+		profile = nullptr;
+
+		file_source src { path };
+		if (!src)
+			return result::unknown;
+
+		auto ret = probe(src, path, item, profile);
+		return finish(src, ret, item, profile);
+	}
+
+	result probe(const char* data, size_t size, Item* item, const Profile*& profile)
+	{
+		profile = nullptr;
+
+		memory_source src { data, (std::size_t) size };
+		auto ret = probe(src, fs::path(), item, profile);
+		return finish(src, ret, item, profile);
+	}
+}}}
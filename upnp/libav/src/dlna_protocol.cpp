@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <dlna_media.hpp>
+
+namespace net { namespace dlna {
+
+	protocol_table& protocols()
+	{
+		static protocol_table table;
+		return table;
+	}
+
+	void protocol_table::add_mime(const char* mime)
+	{
+		std::lock_guard<std::mutex> lock(m_guard);
+		if (std::find(m_mimes.begin(), m_mimes.end(), mime) != m_mimes.end())
+			return;
+
+		m_mimes.push_back(mime);
+		if (!m_source.empty())
+			m_source.push_back(',');
+		m_source.append("http-get:*:").append(mime).append(":*");
+	}
+
+	std::size_t protocol_table::add_variant(bool send_pn, const patches_t& patches)
+	{
+		std::lock_guard<std::mutex> lock(m_guard);
+
+		std::size_t id = 0;
+		for (auto& var : m_variants)
+		{
+			if (var.m_send_pn == send_pn && var.m_patches == patches)
+				return id;
+			++id;
+		}
+
+		m_variants.push_back(variant { send_pn, patches });
+		for (auto& item : m_entries)
+			item.m_rendered.push_back(render(item, m_variants.back()));
+
+		return id;
+	}
+
+	static std::string trim(const std::string& s)
+	{
+		auto b = s.find_first_not_of(" \t");
+		if (b == std::string::npos)
+			return std::string();
+		auto e = s.find_last_not_of(" \t");
+		return s.substr(b, e - b + 1);
+	}
+
+	protocol_table::patches_t protocol_table::parse_patches(const std::string& text)
+	{
+		patches_t out;
+
+		std::string::size_type pos = 0;
+		while (pos < text.length())
+		{
+			auto comma = text.find(',', pos);
+			if (comma == std::string::npos)
+				comma = text.length();
+
+			auto patch = text.substr(pos, comma - pos);
+			pos = comma + 1;
+
+			auto eq = patch.find('=');
+			if (eq == std::string::npos)
+				continue;
+
+			auto from = trim(patch.substr(0, eq));
+			if (!from.empty())
+				out[from] = trim(patch.substr(eq + 1));
+		}
+
+		return out;
+	}
+
+	std::size_t protocol_table::find(const Profile* profile, unsigned int flags)
+	{
+		const char* mime = profile && profile->m_mime && *profile->m_mime ? profile->m_mime : "video/mpeg";
+		const char* name = profile && profile->m_name ? profile->m_name : "";
+
+		std::string key = mime;
+		key.push_back(':');
+		key.append(name).push_back(':');
+		key.append(std::to_string(flags));
+
+		std::lock_guard<std::mutex> lock(m_guard);
+		auto it = m_index.find(key);
+		if (it != m_index.end())
+			return it->second;
+
+		m_entries.push_back(entry { mime, name, flags, std::deque<std::string>() });
+		auto& item = m_entries.back();
+		for (auto& var : m_variants)
+			item.m_rendered.push_back(render(item, var));
+
+		auto id = m_entries.size() - 1;
+		m_index[key] = id;
+		return id;
+	}
+
+	const std::string& protocol_table::get(std::size_t entry, std::size_t variant)
+	{
+		std::lock_guard<std::mutex> lock(m_guard);
+		auto& item = m_entries.at(entry);
+		if (variant >= item.m_rendered.size())
+			variant = 0;
+		return item.m_rendered[variant];
+	}
+
+	std::string protocol_table::render(const entry& item, const variant& var) const
+	{
+		static const char digits[] = "0123456789abcdef";
+
+		std::string out = "http-get:*:";
+		out.append(item.m_mime).append(":DLNA.ORG_PS=1;DLNA.ORG_CI=0;DLNA.ORG_OP=01;");
+
+		if (var.m_send_pn && !item.m_name.empty())
+		{
+			auto patch = var.m_patches.find(item.m_name);
+			auto& name = patch == var.m_patches.end() ? item.m_name : patch->second;
+			if (!name.empty())
+				out.append("DLNA.ORG_PN=").append(name).push_back(';');
+		}
+
+		out.append("DLNA.ORG_FLAGS=");
+		for (int shift = 28; shift >= 0; shift -= 4)
+			out.push_back(digits[(item.m_flags >> shift) & 0xF]);
+		out.append("000000000000000000000000");
+
+		return out;
+	}
+
+}} // net::dlna
@@ -29,8 +29,6 @@
 #include <dom.hpp>
 #include <algorithm>
 
-#include <iomanip>
-
 namespace net { namespace ssdp { namespace import { namespace av { namespace items {
 
 	std::pair<ulong, std::string> pop_id(const std::string& id)
@@ -69,7 +67,7 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 		return make_pair(current_id, std::string());
 	}
 
-	std::pair<media_item_ptr, std::string> find_item(std::vector<media_item_ptr>& items, const std::string& id)
+	std::pair<media_item_ptr, std::string> find_item(const std::vector<media_item_ptr>& items, const std::string& id)
 	{
 		ulong current_id;
 		std::string rest_of_id;
@@ -95,21 +93,79 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 		return make_pair(media_item_ptr(), rest_of_id);
 	}
 
-	bool contains(const std::vector<std::string>& filter, const char* key)
+	item_index::shard& item_index::shard_for(shard (&shards)[SHARD_COUNT], const std::string& key)
 	{
-		if (filter.empty()) return true;
-		return std::find(filter.begin(), filter.end(), key) != filter.end();
+		return shards[std::hash<std::string>()(key) % SHARD_COUNT];
 	}
 
-	struct part
+	media_item_ptr item_index::find(shard (&shards)[SHARD_COUNT], const std::string& key)
 	{
-		part(net::ulong val, int w = 2) : val(val), w(w) {}
-		net::ulong val;
-		int w;
-	};
-	std::ostream& operator << (std::ostream& o, const part& op)
+		auto& s = shard_for(shards, key);
+		std::lock_guard<std::mutex> lock(s.m_guard);
+
+		auto it = s.m_items.find(key);
+		if (it == s.m_items.end())
+			return nullptr;
+
+		auto item = it->second.lock();
+		if (!item)
+			s.m_items.erase(it);
+		return item;
+	}
+
+	void item_index::insert(shard (&shards)[SHARD_COUNT], const std::string& key, const media_item_ptr& item)
+	{
+		auto& s = shard_for(shards, key);
+		std::lock_guard<std::mutex> lock(s.m_guard);
+		s.m_items[key] = item;
+	}
+
+	void item_index::erase(shard (&shards)[SHARD_COUNT], const std::string& key, const media_item* item)
+	{
+		auto& s = shard_for(shards, key);
+		std::lock_guard<std::mutex> lock(s.m_guard);
+
+		auto it = s.m_items.find(key);
+		if (it == s.m_items.end())
+			return;
+
+		// the key could already be taken by the item's replacement
+		auto current = it->second.lock();
+		if (!current || current.get() == item)
+			s.m_items.erase(it);
+	}
+
+	void item_index::add(const media_item_ptr& item)
+	{
+		insert(m_ids, item->get_raw_objectId_attr(), item);
+
+		auto token = item->get_token();
+		if (!token.empty())
+			insert(m_tokens, token, item);
+	}
+
+	void item_index::remove(const media_item_ptr& item)
+	{
+		erase(m_ids, item->get_raw_objectId_attr(), item.get());
+
+		auto token = item->get_token();
+		if (!token.empty())
+			erase(m_tokens, token, item.get());
+	}
+
+	media_item_ptr item_index::find(const std::string& id)
 	{
-		return o << std::setfill('0') << std::setw(op.w) << op.val;
+		auto comma = id.find(',');
+		if (comma == std::string::npos)
+			return find(m_ids, id);
+
+		auto token = id.substr(comma + 1);
+		auto item = find(m_ids, id.substr(0, comma));
+		if (item && item->get_token() == token)
+			return item;
+
+		// the same file, renumbered by a rescan of its folder
+		return find(m_tokens, token);
 	}
 
 	template <typename T>
@@ -117,54 +173,110 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 	bool is_empty(const std::string& t){ return t.empty(); }
 
 	template <typename T>
-	void output(std::ostream& o, T t){ o << t; }
-	void output(std::ostream& o, const std::string& t){ o << net::xmlencode(t); }
+	void output(didl::writer& o, T t){ o << t; }
+	void output(didl::writer& o, const std::string& t){ o.text(t); }
 
-#define PROPERTY(name, item) \
-	if (!is_empty(metadata->name) && contains(filter, item)) \
+#define PROPERTY(name, item, prop) \
+	if (!is_empty(metadata->name) && filter.contains(didl::prop)) \
 	{\
 		o << "    <" item ">"; \
 		items::output(o, metadata->name); \
 		o << "</" item ">\n"; \
 	}
 
-	void common_props_item::output(std::ostream& o, const std::vector<std::string>& filter, const client_interface_ptr& client, const config::config_ptr& config) const
+	void common_props_item::output(didl::writer& o, const didl::filter& filter, const client_interface_ptr& client, const config::config_ptr& config) const
+	{
+		auto host = net::to_string(config->iface) + ":" + std::to_string((int) config->port);
+
+		// the childCount of a folder changes with every file added
+		if (is_folder())
+		{
+			render(o, filter, client, host);
+			return;
+		}
+
+		auto bits = filter.bits();
+		static const std::string no_client;
+		auto& client_name = client ? client->get_name() : no_client;
+
+		cached_output_ptr cached;
+		{
+			std::lock_guard<std::mutex> lock(m_output_guard);
+			for (auto& out : m_outputs)
+			{
+				if (out->m_escaped == o.escaped() && out->m_filter == bits && out->m_client == client_name)
+				{
+					cached = out;
+					break;
+				}
+			}
+		}
+
+		if (!cached)
+		{
+			auto out = std::make_shared<cached_output>();
+			out->m_escaped = o.escaped();
+			out->m_filter = bits;
+			out->m_client = client_name;
+
+			didl::writer frag(out->m_fragment, o.escaped());
+			render(frag, filter, client, host);
+			cached = out;
+
+			std::lock_guard<std::mutex> lock(m_output_guard);
+			if (m_outputs.size() >= MAX_OUTPUTS)
+				m_outputs.erase(m_outputs.begin());
+			m_outputs.push_back(cached);
+		}
+
+		o.splice(cached->m_fragment, host);
+	}
+
+	void common_props_item::invalidate_output()
+	{
+		std::lock_guard<std::mutex> lock(m_output_guard);
+		m_outputs.clear();
+	}
+
+	void common_props_item::render(didl::writer& o, const didl::filter& filter, const client_interface_ptr& client, const std::string& host) const
 	{
 		const char* name = is_folder() ? "container" : "item";
 		auto date = get_last_write_time();
 		auto metadata = get_metadata();
 
 		o << "  <" << name << " id=\"" << get_objectId_attr() << "\"";
-		if (is_folder() && contains(filter, "@childCount"))
+		if (is_folder() && filter.contains(didl::childCount))
 			o << " childCount=\"" << child_count() << "\"";
-		o << " parentId=\"" << get_parent_attr() << "\" restricted=\"true\">\n    <dc:title>" << net::xmlencode(get_title()) << "</dc:title>\n";
+		o << " parentId=\"" << get_parent_attr() << "\" restricted=\"true\">\n    <dc:title>";
+		o.text(get_title());
+		o << "</dc:title>\n";
 
-		if (date && contains(filter, "dc:date"))
+		if (date && filter.contains(didl::dc_date))
 			o << "    <dc:date>" << to_iso8601(time::from_time_t(date)) << "</dc:date>\n";
 
 		if (metadata)
 		{
-			if (!is_empty(metadata->m_artist) && contains(filter, "upnp:artist"))
+			if (!is_empty(metadata->m_artist) && filter.contains(didl::upnp_artist))
 			{
 				o << "    <" "upnp:artist" ">";
 				items::output(o, metadata->m_artist);
 				o << "</" "upnp:artist" ">\n";
 			};
-			PROPERTY(m_artist,       "upnp:artist");
-			PROPERTY(m_artist,       "dc:creator");
+			PROPERTY(m_artist,       "upnp:artist",              upnp_artist);
+			PROPERTY(m_artist,       "dc:creator",               dc_creator);
 			//PROPERTY(m_album_artist, "");
 			//PROPERTY(m_composer,     "");
-			PROPERTY(m_album,        "upnp:album");
-			PROPERTY(m_genre,        "upnp:genre");
+			PROPERTY(m_album,        "upnp:album",               upnp_album);
+			PROPERTY(m_genre,        "upnp:genre",               upnp_genre);
 			//PROPERTY(m_date,         "");
-			PROPERTY(m_comment,      "dc:description");
-			PROPERTY(m_track,        "upnp:originalTrackNumber");
+			PROPERTY(m_comment,      "dc:description",           dc_description);
+			PROPERTY(m_track,        "upnp:originalTrackNumber", upnp_originalTrackNumber);
 		}
 
 		o << "    <upnp:class>" << get_upnp_class() << "</upnp:class>\n";
 
-		cover(o, filter, client, config);
-		main_res(o, filter, client, config);
+		cover(o, filter, client, host);
+		main_res(o, filter, client, host);
 
 		o << "  </" << name << ">\n";
 	}
@@ -193,16 +305,13 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 		};
 	}
 
-	static void protocol_info(std::ostream& o, const dlna::Profile* profile, const client_interface_ptr & /*client*/, unsigned int flags = dlna_org::WMP_DEFAULT)
+	static void protocol_info(didl::writer& o, const dlna::Profile* profile, const client_interface_ptr& client, unsigned int flags = dlna_org::WMP_DEFAULT)
 	{
-		auto mime = profile && profile->m_mime && *profile->m_mime ? profile->m_mime : "video/mpeg";
-		o << "http-get:*:" << mime << ":" << "DLNA.ORG_PS=1;DLNA.ORG_CI=0;DLNA.ORG_OP=01;";
-		if (profile)
-			o << "DLNA.ORG_PN=" << profile->m_name << ";";
-		o << "DLNA.ORG_FLAGS=" << std::setfill('0') << std::setw(8) << std::hex << flags << "000000000000000000000000" << std::dec;
+		auto& table = dlna::protocols();
+		o << table.get(table.find(profile, flags), client ? client->protocol_variant() : 0);
 	}
 
-	void common_props_item::main_res(std::ostream& o, const std::vector<std::string>& filter, const client_interface_ptr& client, const config::config_ptr& config) const
+	void common_props_item::main_res(didl::writer& o, const didl::filter& filter, const client_interface_ptr& client, const std::string& host) const
 	{
 		auto properties = get_properties();
 		auto profile = get_profile();
@@ -215,10 +324,10 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 		auto width       = properties ? properties->m_width : 0;
 		auto height      = properties ? properties->m_height : 0;
 
-		if (!is_folder() && contains(filter, "res"))
+		if (!is_folder() && filter.contains(didl::res))
 		{
 			o << "    <res xmlns:dlna=\"urn:schemas-dlna-org:metadata-1-0/\"";
-			if (contains(filter, "res@protocolInfo"))
+			if (filter.contains(didl::res_protocolInfo))
 			{
 				o << " protocolInfo=\"";
 				protocol_info(o, profile, client);
@@ -231,13 +340,13 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 #endif
 
 #define SIMPLE_RES_ATTR2(name, val) \
-	do { if (val && contains(filter, "res@" #name)) { o << " " #name "=\"" << val << "\""; } } while (0)
+	do { if (val && filter.contains(didl::res_##name)) { o << " " #name "=\"" << val << "\""; } } while (0)
 
 #define SIMPLE_RES_ATTR(name) SIMPLE_RES_ATTR2(name, name)
 
 			SIMPLE_RES_ATTR(bitrate);
 
-			if (duration && contains(filter, "res@duration"))
+			if (duration && filter.contains(didl::res_duration))
 			{
 				auto millis = duration % 1000;
 				auto secs = duration / 1000;
@@ -247,7 +356,11 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 				secs %= 60;
 				mins %= 60;
 
-				o << " duration=\"" << part(hours) << ":" << part(mins) << ":" << part(secs) << "." << part(millis, 3) << "\"";
+				o << " duration=\"";
+				o.padded(hours, 2) << ":";
+				o.padded(mins, 2) << ":";
+				o.padded(secs, 2) << ".";
+				o.padded(millis, 3) << "\"";
 			}
 
 			SIMPLE_RES_ATTR2(sampleFrequency, sample_freq);
@@ -258,12 +371,13 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 #pragma warning(pop)
 #endif
 
-			if (width && height && contains(filter, "res@resolution"))
+			if (width && height && filter.contains(didl::res_resolution))
 			{
 				o << " resolution=\"" << width << "x" << height << "\"";
 			}
 
-			o << ">http://" << net::to_string(config->iface) << ":" << (int) config->port << "/upnp/media/" << get_objectId_attr() << "</res>\n";
+			o << ">http://";
+			o.host(host) << "/upnp/media/" << get_objectId_attr() << "</res>\n";
 		}
 	}
 
@@ -284,28 +398,29 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 		return profile_name;
 	}
 
-	static void write_albumArtURI(std::ostream& o, const common_props_item* _this, media_type type, const std::vector<std::string>& filter, const client_interface_ptr& /*client*/, const config::config_ptr& config)
+	static void write_albumArtURI(didl::writer& o, const common_props_item* _this, media_type type, const didl::filter& filter, const client_interface_ptr& /*client*/, const std::string& host)
 	{
 		auto cover = _this->get_media(type);
 		if (!cover)
 			return;
 
 		o << "    <upnp:albumArtURI";
-		if (contains(filter, "upnp:albumArtURI@dlna:profileID"))
+		if (filter.contains(didl::upnp_albumArtURI_dlna_profileID))
 			o << " dlna:profileID=\"" << get_profile_name(cover->profile(), type) << "\"";
-		o << ">http://" << net::to_string(config->iface) << ":" << (int) config->port << "/upnp/" << (type == thumbnail_160 ? "thumb-160" : "thumb") << "/" << _this->get_objectId_attr() << "</upnp:albumArtURI>\n";
+		o << ">http://";
+		o.host(host) << "/upnp/" << (type == thumbnail_160 ? "thumb-160" : "thumb") << "/" << _this->get_objectId_attr() << "</upnp:albumArtURI>\n";
 	}
-	void common_props_item::cover(std::ostream& o, const std::vector<std::string>& filter, const client_interface_ptr& client, const config::config_ptr& config) const
+	void common_props_item::cover(didl::writer& o, const didl::filter& filter, const client_interface_ptr& client, const std::string& host) const
 	{
 		if (is_image())
 			return;
 
-		if (contains(filter, "upnp:albumArtURI"))
+		if (filter.contains(didl::upnp_albumArtURI))
 		{
-			write_albumArtURI(o, this, thumbnail_160, filter, client, config);
-			write_albumArtURI(o, this, thumbnail, filter, client, config);
+			write_albumArtURI(o, this, thumbnail_160, filter, client, host);
+			write_albumArtURI(o, this, thumbnail, filter, client, host);
 		}
-		else if (contains(filter, "res"))
+		else if (filter.contains(didl::res))
 		{
 			auto cover = get_media(thumbnail_160);
 			if (!cover)
@@ -321,32 +436,38 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 			tn_profile.m_name = forced_pn.c_str();
 
 			o << "    <res xmlns:dlna=\"urn:schemas-dlna-org:metadata-1-0/\"";
-			if (contains(filter, "res@protocolInfo"))
+			if (filter.contains(didl::res_protocolInfo))
 			{
 				o << " protocolInfo=\"";
 				protocol_info(o, &tn_profile, client, dlna_org::WMP_THUMBNAIL);
 				o << "\"";
 			}
 
-			o << ">http://" << net::to_string(config->iface) << ":" << (int) config->port << "/upnp/thumb-160/" << get_objectId_attr() << "</res>\n";
+			o << ">http://";
+			o.host(host) << "/upnp/thumb-160/" << get_objectId_attr() << "</res>\n";
 		}
 	}
 
-	root_item::container_type root_item::list(ulong start_from, ulong max_count)
+	media_item::container_type media_item::sorted_list(ulong start_from, ulong max_count, const sorting::criteria& order)
 	{
-		std::vector<media_item_ptr> out;
-		if (start_from > m_children.size())
-			start_from = m_children.size();
+		if (order.empty())
+			return list(start_from, max_count);
 
-		auto end_at = m_children.size() - start_from;
-		if (end_at > max_count)
-			end_at = max_count;
-		end_at += start_from;
+		auto all = list(0, INVALID_ID);
+		std::stable_sort(all.begin(), all.end(), order);
+		return sorting::slice(all, start_from, max_count);
+	}
 
-		for (auto i = start_from; i < end_at; ++i)
-			out.push_back(m_children.at(i));
+	root_item::container_type root_item::list(ulong start_from, ulong max_count)
+	{
+		return sorting::slice(*children(), start_from, max_count);
+	}
 
-		return out;
+	root_item::container_type root_item::sorted_list(ulong start_from, ulong max_count, const sorting::criteria& order)
+	{
+		auto snapshot = children();
+		std::lock_guard<std::mutex> lock(m_guard);
+		return m_sorted.slice(*snapshot, order, start_from, max_count);
 	}
 
 	media_item_ptr root_item::get_item(const std::string& id)
@@ -354,7 +475,7 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 		media_item_ptr candidate;
 		std::string rest_of_id;
 
-		std::tie(candidate, rest_of_id) = find_item(m_children, id);
+		std::tie(candidate, rest_of_id) = find_item(*children(), id);
 
 		if (!candidate || rest_of_id.empty())
 			return candidate;
@@ -367,41 +488,108 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 
 	void root_item::add_child(media_item_ptr child)
 	{
-		m_children.push_back(child);
-		auto id = ++m_current_max;
-		child->set_id(id);
-		child->set_objectId_attr(get_raw_objectId_attr() + SEP + std::to_string(id));
-		child->set_parent_attr("0");
+		{
+			std::lock_guard<std::mutex> lock(m_guard);
+
+			auto id = ++m_current_max;
+			child->set_id(id);
+			child->set_objectId_attr(get_raw_objectId_attr() + SEP + std::to_string(id));
+			child->set_parent_attr("0");
+			child->invalidate_output();
+
+			auto next = std::make_shared<container_type>(*m_children);
+			next->push_back(child);
+			snapshot_ptr snapshot = next;
+			std::atomic_store(&m_children, snapshot);
+			m_sorted.add(child);
+		}
+
+		m_device->item_added(child);
 	}
 
 	void root_item::remove_child(media_item_ptr child)
 	{
-		auto pos = std::find(m_children.begin(), m_children.end(), child);
-		if (pos != m_children.end())
-			m_children.erase(pos);
+		{
+			std::lock_guard<std::mutex> lock(m_guard);
+
+			auto pos = std::find(m_children->begin(), m_children->end(), child);
+			if (pos == m_children->end())
+				return;
+
+			auto next = std::make_shared<container_type>(m_children->begin(), pos);
+			next->insert(next->end(), pos + 1, m_children->end());
+			snapshot_ptr snapshot = next;
+			std::atomic_store(&m_children, snapshot);
+			m_sorted.remove(child);
+		}
+
+		m_device->item_removed(child);
 	}
 
 	struct media_file : media, std::enable_shared_from_this<media_file>
 	{
 		fs::path      m_path;
-		dlna::Profile m_profile;
+		dlna::Profile m_initial;
+		// either the m_initial, or one of the static profiles; a pointer handed out stays valid
+		std::atomic<const dlna::Profile*> m_profile;
 		bool          m_main_resource;
+		time_t        m_last_write;
+		uintmax_t     m_size;
+		std::mutex    m_guard;
 
 		media_file(const fs::path& path, const dlna::Profile& profile, bool main)
 			: m_path(path)
-			, m_profile(profile)
+			, m_initial(profile)
+			, m_profile(&m_initial)
 			, m_main_resource(main)
-		{}
+			, m_last_write(0)
+			, m_size(0)
+		{
+		}
 
-		bool prep_response(http::response& resp) override
+		// a stat instead of another probe; only a file, which changed since, is looked into again
+		bool refresh(time_t& last_write)
 		{
-			if (!fs::exists(m_path))
+			boost::system::error_code ec;
+			last_write = fs::last_write_time(m_path, ec);
+			if (ec)
+				return false;
+			auto size = fs::file_size(m_path, ec);
+			if (ec)
+				return false;
+
+			std::lock_guard<std::mutex> lock(m_guard);
+			if (last_write == m_last_write && size == m_size)
+				return true;
+
+			// the profile came with the file (from a probe or from the catalog); the first request only takes the stamp
+			if (!m_last_write && !m_size)
+			{
+				m_last_write = last_write;
+				m_size = size;
+				return true;
+			}
+
+			auto profile = dlna::Profile::guess_from_file(m_path);
+			if (!profile)
 				return false;
 
+			log::info() << "Profile of " << m_path << " is now " << (profile->m_name ? profile->m_name : profile->m_mime);
+			m_profile = profile;
+			m_last_write = last_write;
+			m_size = size;
+			return true;
+		}
+
+		bool prep_response(http::response& resp) override
+		{
+			time_t last_write = 0;
+			if (!refresh(last_write))
+				return false;
 
 			auto& header = resp.header();
-			header.append("content-type", m_profile.m_mime);
-			header.append("last-modified")->out() << to_string(time::last_write(m_path));
+			header.append("content-type", m_profile.load()->m_mime);
+			header.append("last-modified")->out() << to_string(time::from_time_t(last_write));
 			resp.content(http::content::from_file(m_path));
 
 			if (m_main_resource && resp.first_range())
@@ -412,7 +600,7 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 			return true;
 		}
 
-		const dlna::Profile* profile() const override { return &m_profile; }
+		const dlna::Profile* profile() const override { return m_profile.load(); }
 		media_ptr get_thumbnail() override
 		{
 			return shared_from_this();
@@ -427,4 +615,9 @@ namespace net { namespace ssdp { namespace import { namespace av { namespace ite
 		return std::make_shared<media_file>(path, *profile, main_resource);
 	}
 
+	media_ptr media::from_file(const boost::filesystem::path& path, const dlna::Profile& profile, bool main_resource)
+	{
+		return std::make_shared<media_file>(path, profile, main_resource);
+	}
+
 }}}}}
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <library.hpp>
+#include "media_server_internal.hpp"
+
+namespace net { namespace ssdp { namespace import { namespace av { namespace items {
+
+	virtual_container::virtual_container(MediaServer* device, const std::string& title, const char* upnp_class, const std::string& order, bool owns_children)
+		: common_props_item(device)
+		, m_class(upnp_class)
+		, m_owns_children(owns_children)
+		, m_update_id(1)
+		, m_current_max(0)
+	{
+		set_title(title);
+		m_order.compile(order);
+	}
+
+	virtual_container::container_type virtual_container::list(ulong start_from, ulong max_count)
+	{
+		std::lock_guard<std::mutex> lock(m_guard);
+		return sorting::slice(m_children, start_from, max_count);
+	}
+
+	virtual_container::container_type virtual_container::sorted_list(ulong start_from, ulong max_count, const sorting::criteria& order)
+	{
+		std::lock_guard<std::mutex> lock(m_guard);
+		if (order.str() == m_order.str())
+			return sorting::slice(m_children, start_from, max_count);
+		return m_sorted.slice(m_children, order, start_from, max_count);
+	}
+
+	ulong virtual_container::predict_count(ulong /*served*/) const
+	{
+		std::lock_guard<std::mutex> lock(m_guard);
+		return m_children.size();
+	}
+
+	size_t virtual_container::child_count() const
+	{
+		std::lock_guard<std::mutex> lock(m_guard);
+		return m_children.size();
+	}
+
+	media_item_ptr virtual_container::get_item(const std::string& id)
+	{
+		// the items listed by reference are found by their own ids
+		if (!m_owns_children)
+			return nullptr;
+
+		media_item_ptr candidate;
+		std::string rest_of_id;
+
+		{
+			std::lock_guard<std::mutex> lock(m_guard);
+			std::tie(candidate, rest_of_id) = find_item(m_children, id);
+		}
+
+		if (!candidate || rest_of_id.empty())
+			return candidate;
+
+		return candidate->get_item(rest_of_id);
+	}
+
+	void virtual_container::add_child(const media_item_ptr& child)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_guard);
+
+			if (m_owns_children)
+			{
+				auto id = ++m_current_max;
+				child->set_id(id);
+				child->set_objectId_attr(get_raw_objectId_attr() + SEP + std::to_string(id));
+				child->set_parent_attr(get_objectId_attr());
+				child->invalidate_output();
+			}
+
+			auto pos = std::upper_bound(m_children.begin(), m_children.end(), child, m_order);
+			m_children.insert(pos, child);
+			m_sorted.add(child);
+		}
+
+		if (m_owns_children)
+			m_device->item_added(child);
+		changed();
+	}
+
+	void virtual_container::remove_child(const media_item_ptr& child)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_guard);
+			auto pos = std::find(m_children.begin(), m_children.end(), child);
+			if (pos == m_children.end())
+				return;
+
+			m_children.erase(pos);
+			m_sorted.remove(child);
+		}
+
+		if (m_owns_children)
+			m_device->item_removed(child);
+		changed();
+	}
+
+	size_t virtual_container::trim(size_t max_count)
+	{
+		container_type dropped;
+		{
+			std::lock_guard<std::mutex> lock(m_guard);
+			if (m_children.size() <= max_count)
+				return m_children.size();
+
+			dropped.assign(m_children.begin() + max_count, m_children.end());
+			m_children.resize(max_count);
+			for (auto& child : dropped)
+				m_sorted.remove(child);
+		}
+
+		if (m_owns_children)
+		{
+			for (auto& child : dropped)
+				m_device->item_removed(child);
+		}
+
+		changed();
+		return max_count;
+	}
+
+	void virtual_container::changed()
+	{
+		++m_update_id;
+		m_device->object_changed(this);
+	}
+
+	namespace
+	{
+		std::string by_artist(const dlna::ItemMetadata& meta) { return meta.m_artist; }
+		std::string by_album(const dlna::ItemMetadata& meta) { return meta.m_album; }
+		std::string by_genre(const dlna::ItemMetadata& meta) { return meta.m_genre; }
+
+		std::string by_year(const dlna::ItemMetadata& meta)
+		{
+			auto& date = meta.m_date;
+			if (date.length() < 4)
+				return std::string();
+
+			for (size_t i = 0; i < 4; ++i)
+			{
+				if (date[i] < '0' || date[i] > '9')
+					return std::string();
+			}
+			return date.substr(0, 4);
+		}
+	}
+
+	library::library(MediaServer* device)
+		: m_device(device)
+		, m_root(std::make_shared<virtual_container>(device, "Library", "object.container", std::string(), true))
+		, m_recent(std::make_shared<virtual_container>(device, "Recently Added", "object.container", "-dc:date", false))
+	{
+		static const struct
+		{
+			const char* title;
+			grouping key;
+			const char* group_class;
+			const char* items_order;
+		} views [] = {
+			{ "Artists", by_artist, "object.container.person.musicArtist", "+upnp:album,+upnp:originalTrackNumber,+dc:title" },
+			{ "Albums",  by_album,  "object.container.album.musicAlbum",   "+upnp:originalTrackNumber,+dc:title" },
+			{ "Genres",  by_genre,  "object.container.genre.musicGenre",   "+upnp:artist,+upnp:album,+upnp:originalTrackNumber" },
+			{ "Years",   by_year,   "object.container",                    "+upnp:artist,+upnp:album,+upnp:originalTrackNumber" },
+		};
+
+		for (auto& v : views)
+		{
+			view out;
+			out.m_container = std::make_shared<virtual_container>(device, v.title, "object.container", "+dc:title", true);
+			out.m_key = v.key;
+			out.m_group_class = v.group_class;
+			out.m_items_order = v.items_order;
+			m_views.push_back(std::move(out));
+		}
+	}
+
+	void library::add(const media_item_ptr& item)
+	{
+		// the library's own containers come through here as well
+		if (!item || item->is_folder())
+			return;
+
+		auto metadata = item->get_metadata();
+		if (!metadata)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_guard);
+
+		// the views are attached the first time there is something to show
+		if (!m_root->child_count())
+		{
+			for (auto& v : m_views)
+				m_root->add_child(v.m_container);
+			m_root->add_child(m_recent);
+		}
+
+		for (auto& v : m_views)
+		{
+			auto key = v.m_key(*metadata);
+			if (key.empty())
+				continue;
+
+			auto& group = v.m_groups[key];
+			if (!group)
+			{
+				group = std::make_shared<virtual_container>(m_device, key, v.m_group_class, v.m_items_order, false);
+				group->set_token(CRC().update(v.m_container->get_title()).update(key).str());
+				v.m_container->add_child(group);
+			}
+			group->add_child(item);
+		}
+
+		m_recent->add_child(item);
+		m_recent->trim(MAX_RECENT);
+	}
+
+	void library::remove(const media_item_ptr& item)
+	{
+		if (!item || item->is_folder())
+			return;
+
+		auto metadata = item->get_metadata();
+		if (!metadata)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_guard);
+
+		for (auto& v : m_views)
+		{
+			auto it = v.m_groups.find(v.m_key(*metadata));
+			if (it == v.m_groups.end())
+				continue;
+
+			auto group = it->second;
+			group->remove_child(item);
+			if (!group->child_count())
+			{
+				v.m_groups.erase(it);
+				v.m_container->remove_child(group);
+			}
+		}
+
+		m_recent->remove_child(item);
+	}
+
+}}}}} // net::ssdp::import::av::items
@@ -25,6 +25,7 @@
 #include "pch.h"
 #include <media_server.hpp>
 #include "media_server_internal.hpp"
+#include <library.hpp>
 #include <http/response.hpp>
 #include <dom.hpp>
 #include <algorithm>
@@ -35,14 +36,31 @@ namespace net { namespace ssdp { namespace import { namespace av {
 
 	Log::Module Multimedia {"AVMS"};
 
-	bool MediaServer::call_http(const http::http_request& /*req*/, const boost::filesystem::path& root, const boost::filesystem::path& rest, http::response& resp)
+	static struct
 	{
-		auto media_type = items::main_resource;
-		if (root == "thumb") media_type = items::thumbnail;
-		else if (root == "thumb-160") media_type = items::thumbnail_160;
-		else if (root != "media") return false;
+		const char* root;
+		items::media_type type;
+	} s_http_roots [] = {
+		{ "media",     items::main_resource },
+		{ "thumb",     items::thumbnail },
+		{ "thumb-160", items::thumbnail_160 }
+	};
 
-		auto item = get_item(rest.string());
+	std::vector<std::string> MediaServer::get_http_roots() const
+	{
+		std::vector<std::string> out;
+		for (auto&& root : s_http_roots)
+			out.push_back(root.root);
+		return out;
+	}
+
+	bool MediaServer::call_http(const http::http_request& /*req*/, size_t root, const std::string& rest, http::response& resp)
+	{
+		if (root >= sizeof(s_http_roots) / sizeof(s_http_roots[0]))
+			return false;
+
+		auto media_type = s_http_roots[root].type;
+		auto item = get_item(rest);
 		if (!item)
 			return false;
 
@@ -56,6 +74,11 @@ namespace net { namespace ssdp { namespace import { namespace av {
 
 	items::media_item_ptr MediaServer::get_item(const std::string& id)
 	{
+		auto indexed = m_index.find(id);
+		if (indexed)
+			return indexed;
+
+		// the root itself, or an item the index does not know (yet)
 		items::media_item_ptr candidate;
 		ulong current_id;
 		std::string rest_of_id;
@@ -70,6 +93,32 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		return candidate->get_item(rest_of_id);
 	}
 
+	std::shared_ptr<items::library> MediaServer::create_library()
+	{
+		return std::make_shared<items::library>(this);
+	}
+
+	items::media_item_ptr MediaServer::library() const
+	{
+		return m_library->root();
+	}
+
+	void MediaServer::item_added(const items::media_item_ptr& item)
+	{
+		m_index.add(item);
+		m_search.add(item);
+		if (m_library)
+			m_library->add(item);
+	}
+
+	void MediaServer::item_removed(const items::media_item_ptr& item)
+	{
+		m_index.remove(item);
+		m_search.remove(item);
+		if (m_library)
+			m_library->remove(item);
+	}
+
 	items::root_item_ptr MediaServer::create_root_item()
 	{
 		auto root = std::make_shared<items::root_item>(this);
@@ -110,19 +159,38 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		return std::make_shared<default_client_info>(request);
 	}
 
-	void MediaServer::object_changed()
+	void MediaServer::object_changed(const items::media_item* container)
 	{
 		::time(&m_system_update_id);
+
+		// the pages of the container list its children, the pages of the parent show its childCount
+		if (container)
+		{
+			m_directory->m_pages.invalidate(container->get_objectId_attr());
+			m_directory->m_pages.invalidate(container->get_parent_attr());
+		}
+		else
+			m_directory->m_pages.clear();
+
+		auto sink = get_event_sink();
+		if (!sink)
+			return;
+
+		sink->property_changed(m_directory->get_id(), "SystemUpdateID", std::to_string(system_update_id()));
+		if (container)
+			sink->list_changed(m_directory->get_id(), "ContainerUpdateIDs", container->get_objectId_attr(), std::to_string(container->update_id()));
 	}
 
 	void MediaServer::add_root_element(items::media_item_ptr ptr)
 	{
 		m_root_item->add_child(ptr);
+		object_changed(m_root_item.get());
 	}
 
 	void MediaServer::remove_root_element(items::media_item_ptr ptr)
 	{
 		m_root_item->remove_child(ptr);
+		object_changed(m_root_item.get());
 	}
 
 	const char* yn(bool b) { return b ? "yes;" : "no;"; }
@@ -150,7 +218,10 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		}
 
 		auto client_info = std::make_shared<client>(name, ua_match, additional_header, additional_header_match);
+		client_info->set_protocol_variant(dlna::protocols().add_variant(config.media_server.send_ORG_PN,
+			dlna::protocol_table::parse_patches(config.media_server.profile_patches)));
 		m_known_clients.push_back(client_info);
+		m_matchers.add(client_info->matcher());
 
 		// other attributes
 
@@ -220,12 +291,26 @@ namespace net { namespace ssdp { namespace import { namespace av {
 
 	client_info_ptr MediaServer::match_from_request(const http::http_request& request) const
 	{
+#ifdef LOG_DEBUG
 		log::debug() << "[MATCHING] User agent: " << request.user_agent();
-		for (auto&& candidate : m_known_clients)
-			if (candidate->matches(request))
-				return candidate;
+#endif
+		auto id = m_matchers.find(request);
+		if (id != client_matcher_set::npos)
+			return m_known_clients[id];
 
 		return create_default_client(request);
 	}
 
+	std::vector<std::string> MediaServer::get_client_headers() const
+	{
+		std::vector<std::string> out;
+		for (auto&& candidate : m_known_clients)
+		{
+			auto& header = candidate->other_header();
+			if (!header.empty())
+				out.push_back(header);
+		}
+		return out;
+	}
+
 }}}}
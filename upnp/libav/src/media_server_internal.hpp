@@ -40,17 +40,20 @@ namespace net { namespace ssdp { namespace import { namespace av {
 		{
 			root_item(MediaServer* device)
 				: common_props_item(device)
-				, m_update_id(1)
 				, m_current_max(0)
+				, m_update_id(1)
+				, m_children(std::make_shared<container_type>())
 			{
 			}
 
 			container_type list(ulong start_from, ulong max_count)           override;
-			ulong          predict_count(ulong /*served*/) const             override { return m_children.size(); }
+			container_type sorted_list(ulong start_from, ulong max_count,
+			                           const sorting::criteria& order)       override;
+			ulong          predict_count(ulong /*served*/) const             override { return children()->size(); }
 			media_item_ptr get_item(const std::string& id)                   override;
 			bool           is_image() const                                  override { return false; }
 			bool           is_folder() const                                 override { return true; }
-			size_t         child_count() const                               override { return m_children.size(); }
+			size_t         child_count() const                               override { return children()->size(); }
 			const char*    get_upnp_class() const                            override { return "object.container.storageFolder"; }
 			ulong          update_id() const                                 override { return m_device->system_update_id(); }
 			virtual void   add_child(media_item_ptr);
@@ -64,9 +67,14 @@ namespace net { namespace ssdp { namespace import { namespace av {
 			}
 
 		private:
-			ulong          m_current_max;
-			time_t         m_update_id;
-			container_type m_children;
+			typedef std::shared_ptr<const container_type> snapshot_ptr;
+			snapshot_ptr children() const { return std::atomic_load(&m_children); }
+
+			ulong                   m_current_max;
+			time_t                  m_update_id;
+			std::mutex              m_guard; // writers only
+			snapshot_ptr            m_children;
+			sorting::permutations   m_sorted;
 		};
 
 		std::pair<ulong, std::string> pop_id(const std::string& id);
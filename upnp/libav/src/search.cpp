@@ -0,0 +1,720 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <media_server.hpp>
+#include <library.hpp>
+#include <search.hpp>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace net { namespace ssdp { namespace import { namespace av { namespace search {
+
+	namespace
+	{
+		inline char lower(char c)
+		{
+			return c >= 'A' && c <= 'Z' ? (char) (c - 'A' + 'a') : c;
+		}
+
+		std::string lowercase(const std::string& s)
+		{
+			std::string out(s);
+			for (auto& c : out)
+				c = lower(c);
+			return out;
+		}
+
+		// anything outside of ASCII is a part of a word, so UTF-8 stays in one piece
+		inline bool word_char(char c)
+		{
+			return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (unsigned char) c >= 0x80;
+		}
+
+		// expects lowercase text
+		std::vector<std::string> tokenize(const std::string& s)
+		{
+			std::vector<std::string> out;
+			size_t pos = 0;
+			while (pos < s.length())
+			{
+				while (pos < s.length() && !word_char(s[pos]))
+					++pos;
+				auto start = pos;
+				while (pos < s.length() && word_char(s[pos]))
+					++pos;
+				if (pos > start)
+					out.emplace_back(s.substr(start, pos - start));
+			}
+
+			std::sort(out.begin(), out.end());
+			out.erase(std::unique(out.begin(), out.end()), out.end());
+			return out;
+		}
+
+		struct syntax_error : std::runtime_error
+		{
+			explicit syntax_error(const char* message) : std::runtime_error(message) {}
+		};
+
+		class parser
+		{
+			const std::string& m_text;
+			size_t m_pos;
+			std::string m_token;
+			bool m_quoted;
+
+			void skip_ws()
+			{
+				while (m_pos < m_text.length() && isspace((unsigned char) m_text[m_pos]))
+					++m_pos;
+			}
+
+			static bool is_op(char c) { return c == '=' || c == '!' || c == '<' || c == '>'; }
+
+			bool next()
+			{
+				m_token.clear();
+				m_quoted = false;
+				skip_ws();
+				if (m_pos >= m_text.length())
+					return false;
+
+				char c = m_text[m_pos];
+				if (c == '(' || c == ')')
+				{
+					m_token.push_back(c);
+					++m_pos;
+					return true;
+				}
+
+				if (c == '"')
+				{
+					m_quoted = true;
+					++m_pos;
+					while (m_pos < m_text.length() && m_text[m_pos] != '"')
+					{
+						if (m_text[m_pos] == '\\' && m_pos + 1 < m_text.length())
+							++m_pos;
+						m_token.push_back(m_text[m_pos++]);
+					}
+					if (m_pos >= m_text.length())
+						throw syntax_error("unterminated string");
+					++m_pos;
+					return true;
+				}
+
+				if (is_op(c))
+				{
+					while (m_pos < m_text.length() && is_op(m_text[m_pos]))
+						m_token.push_back(m_text[m_pos++]);
+					return true;
+				}
+
+				while (m_pos < m_text.length())
+				{
+					c = m_text[m_pos];
+					if (isspace((unsigned char) c) || c == '(' || c == ')' || c == '"' || is_op(c))
+						break;
+					m_token.push_back(c);
+					++m_pos;
+				}
+				return true;
+			}
+
+			bool keyword(const char* kw) const
+			{
+				return !m_quoted && lowercase(m_token) == kw;
+			}
+
+			static field get_field(const std::string& name)
+			{
+				static struct
+				{
+					const char* name;
+					field fld;
+				} fields [] = {
+					{ "upnp:class",  upnp_class },
+					{ "dc:title",    dc_title },
+					{ "dc:creator",  upnp_artist },
+					{ "upnp:artist", upnp_artist },
+					{ "upnp:album",  upnp_album },
+					{ "upnp:genre",  upnp_genre },
+				};
+
+				for (auto& f : fields)
+				{
+					if (name == f.name)
+						return f.fld;
+				}
+				return unknown_field;
+			}
+
+			static op get_op(const std::string& name)
+			{
+				static struct
+				{
+					const char* name;
+					op oper;
+				} ops [] = {
+					{ "=",              op_equal },
+					{ "!=",             op_not_equal },
+					{ "<",              op_less },
+					{ "<=",             op_less_equal },
+					{ ">",              op_greater },
+					{ ">=",             op_greater_equal },
+					{ "contains",       op_contains },
+					{ "doesnotcontain", op_not_contains },
+					{ "derivedfrom",    op_derived_from },
+					{ "exists",         op_exists },
+				};
+
+				auto lower_name = lowercase(name);
+				for (auto& o : ops)
+				{
+					if (lower_name == o.name)
+						return o.oper;
+				}
+				throw syntax_error("unknown operator");
+			}
+
+			node_ptr primary()
+			{
+				if (!m_quoted && m_token == "(")
+				{
+					next();
+					auto inner = or_expr();
+					if (m_quoted || m_token != ")")
+						throw syntax_error("missing )");
+					next();
+					return inner;
+				}
+
+				if (m_quoted || m_token.empty())
+					throw syntax_error("property expected");
+
+				node_ptr out(new node(node::leaf));
+				out->m_field = get_field(m_token);
+
+				if (!next() || m_quoted)
+					throw syntax_error("operator expected");
+				out->m_op = get_op(m_token);
+
+				if (!next())
+					throw syntax_error("value expected");
+
+				if (out->m_op == op_exists)
+				{
+					if (keyword("true"))
+						out->m_exists = true;
+					else if (keyword("false"))
+						out->m_exists = false;
+					else
+						throw syntax_error("true or false expected");
+				}
+				else
+				{
+					if (!m_quoted)
+						throw syntax_error("quoted string expected");
+					out->m_value = lowercase(m_token);
+				}
+
+				next();
+				return out;
+			}
+
+			node_ptr and_expr()
+			{
+				auto left = primary();
+				while (keyword("and"))
+				{
+					next();
+					node_ptr both(new node(node::and_node));
+					both->m_left = std::move(left);
+					both->m_right = primary();
+					left = std::move(both);
+				}
+				return left;
+			}
+
+			node_ptr or_expr()
+			{
+				auto left = and_expr();
+				while (keyword("or"))
+				{
+					next();
+					node_ptr either(new node(node::or_node));
+					either->m_left = std::move(left);
+					either->m_right = and_expr();
+					left = std::move(either);
+				}
+				return left;
+			}
+
+		public:
+			parser(const std::string& text) : m_text(text), m_pos(0), m_quoted(false) {}
+
+			// nullptr for "*"
+			node_ptr parse()
+			{
+				if (!next())
+					throw syntax_error("empty criteria");
+
+				if (!m_quoted && m_token == "*")
+				{
+					if (next())
+						throw syntax_error("unexpected text after *");
+					return nullptr;
+				}
+
+				auto out = or_expr();
+				if (!m_token.empty() || m_quoted)
+					throw syntax_error("unexpected text at the end");
+				return out;
+			}
+		};
+
+		bool derived_from(const std::string& klass, const std::string& base)
+		{
+			if (klass.compare(0, base.length(), base) != 0)
+				return false;
+			return klass.length() == base.length() || klass[base.length()] == '.';
+		}
+
+		bool leaf_matches(const std::string& value, const node* leaf)
+		{
+			switch (leaf->m_op)
+			{
+			case op_equal:         return value == leaf->m_value;
+			case op_not_equal:     return value != leaf->m_value;
+			case op_less:          return value < leaf->m_value;
+			case op_less_equal:    return value <= leaf->m_value;
+			case op_greater:       return value > leaf->m_value;
+			case op_greater_equal: return value >= leaf->m_value;
+			case op_contains:      return value.find(leaf->m_value) != std::string::npos;
+			case op_not_contains:  return value.find(leaf->m_value) == std::string::npos;
+			case op_derived_from:  return derived_from(value, leaf->m_value);
+			case op_exists:        return value.empty() != leaf->m_exists;
+			}
+			return false;
+		}
+
+		// can the node be answered from the postings, without looking at every item?
+		bool indexed(const node* plan)
+		{
+			switch (plan->m_kind)
+			{
+			case node::leaf:
+				return plan->m_field != unknown_field && (plan->m_op == op_equal || plan->m_op == op_contains || plan->m_op == op_derived_from);
+			case node::and_node:
+				return indexed(plan->m_left.get()) || indexed(plan->m_right.get());
+			case node::or_node:
+				return indexed(plan->m_left.get()) && indexed(plan->m_right.get());
+			}
+			return false;
+		}
+
+		/*
+		 * What a Search below the container may return. The folders own
+		 * their children, whose ids start with the id of the folder; the
+		 * Library groups and the Recently Added only list items, which
+		 * live somewhere else, and have to be walked.
+		 */
+		class scope_filter
+		{
+			std::vector<std::string> m_prefixes;
+			std::unordered_set<const items::media_item*> m_members;
+
+			void add(const items::media_item_ptr& container)
+			{
+				m_prefixes.push_back(container->get_raw_objectId_attr() + items::SEP);
+
+				auto virt = std::dynamic_pointer_cast<items::virtual_container>(container);
+				if (!virt)
+					return;
+
+				for (auto& child : virt->list(0, items::INVALID_ID))
+				{
+					if (!virt->owns_children())
+						m_members.insert(child.get());
+					if (child->is_folder())
+						add(child);
+				}
+			}
+		public:
+			explicit scope_filter(const items::media_item_ptr& scope) { add(scope); }
+
+			bool contains(const items::media_item_ptr& item) const
+			{
+				if (m_members.count(item.get()))
+					return true;
+
+				auto id = item->get_raw_objectId_attr();
+				for (auto& prefix : m_prefixes)
+				{
+					if (id.compare(0, prefix.length(), prefix) == 0)
+						return true;
+				}
+				return false;
+			}
+		};
+
+		template <typename T>
+		void unite(T& out, const T& other)
+		{
+			T tmp;
+			tmp.reserve(out.size() + other.size());
+			std::set_union(out.begin(), out.end(), other.begin(), other.end(), std::back_inserter(tmp));
+			out.swap(tmp);
+		}
+
+		template <typename T>
+		void intersect(T& out, const T& other)
+		{
+			T tmp;
+			std::set_intersection(out.begin(), out.end(), other.begin(), other.end(), std::back_inserter(tmp));
+			out.swap(tmp);
+		}
+	}
+
+	bool criteria::compile(const std::string& text)
+	{
+		try
+		{
+			m_root = parser(text).parse();
+			return true;
+		}
+		catch (syntax_error& e)
+		{
+			log::debug() << "SearchCriteria: " << e.what() << " in " << text;
+			return false;
+		}
+	}
+
+	void index::add(const items::media_item_ptr& item)
+	{
+		if (!item)
+			return;
+
+		document doc;
+		doc.m_item = item;
+		doc.m_ptr = item.get();
+		doc.m_alive = true;
+
+		auto common = dynamic_cast<const items::common_props_item*>(item.get());
+		if (common)
+			doc.m_fields[upnp_class] = lowercase(common->get_upnp_class());
+		doc.m_fields[dc_title] = lowercase(item->get_title());
+
+		auto metadata = item->get_metadata();
+		if (metadata)
+		{
+			doc.m_fields[upnp_artist] = lowercase(metadata->m_artist);
+			doc.m_fields[upnp_album] = lowercase(metadata->m_album);
+			doc.m_fields[upnp_genre] = lowercase(metadata->m_genre);
+		}
+
+		std::lock_guard<std::mutex> lock(m_guard);
+
+		// either the same item, added again, or a dead one at the same address
+		auto it = m_ids.find(item.get());
+		if (it != m_ids.end())
+			purge(it->second);
+
+		auto id = (doc_id) m_docs.size();
+		if (!doc.m_fields[upnp_class].empty())
+			m_tokens[upnp_class][doc.m_fields[upnp_class]].push_back(id);
+
+		for (int fld = dc_title; fld < field_count; ++fld)
+		{
+			for (auto& token : tokenize(doc.m_fields[fld]))
+				m_tokens[fld][token].push_back(id);
+		}
+
+		m_docs.push_back(std::move(doc));
+		m_ids[item.get()] = id;
+		++m_alive;
+
+		compact();
+	}
+
+	void index::remove(const items::media_item_ptr& item)
+	{
+		if (!item)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_guard);
+		auto it = m_ids.find(item.get());
+		if (it != m_ids.end())
+			purge(it->second);
+
+		compact();
+	}
+
+	void index::compact()
+	{
+		// only, when the dead documents are the most of them
+		if (m_docs.size() < MIN_COMPACT || m_alive > m_docs.size() / 2)
+			return;
+
+		// the order is kept, so the postings stay sorted
+		std::vector<doc_id> moved(m_docs.size(), 0);
+		std::vector<document> docs;
+		docs.reserve(m_alive);
+		for (doc_id id = 0; id < m_docs.size(); ++id)
+		{
+			if (!m_docs[id].m_alive)
+				continue;
+
+			moved[id] = (doc_id) docs.size();
+			docs.push_back(std::move(m_docs[id]));
+		}
+		m_docs.swap(docs);
+
+		for (auto& tokens : m_tokens)
+		{
+			for (auto& pair : tokens)
+			{
+				for (auto& id : pair.second)
+					id = moved[id];
+			}
+		}
+
+		for (auto& pair : m_ids)
+			pair.second = moved[pair.second];
+	}
+
+	void index::purge(doc_id id)
+	{
+		auto& doc = m_docs[id];
+		if (!doc.m_alive)
+			return;
+
+		auto drop = [id](std::unordered_map<std::string, postings>& tokens, const std::string& token)
+		{
+			auto it = tokens.find(token);
+			if (it == tokens.end())
+				return;
+
+			auto& list = it->second;
+			auto pos = std::lower_bound(list.begin(), list.end(), id);
+			if (pos != list.end() && *pos == id)
+				list.erase(pos);
+			if (list.empty())
+				tokens.erase(it);
+		};
+
+		if (!doc.m_fields[upnp_class].empty())
+			drop(m_tokens[upnp_class], doc.m_fields[upnp_class]);
+
+		for (int fld = dc_title; fld < field_count; ++fld)
+		{
+			for (auto& token : tokenize(doc.m_fields[fld]))
+				drop(m_tokens[fld], token);
+		}
+
+		auto it = m_ids.find(doc.m_ptr);
+		if (it != m_ids.end() && it->second == id)
+			m_ids.erase(it);
+
+		doc.m_alive = false;
+		doc.m_item.reset();
+		for (auto& value : doc.m_fields)
+			std::string().swap(value);
+		--m_alive;
+	}
+
+	index::postings index::all() const
+	{
+		postings out;
+		out.reserve(m_alive);
+		for (doc_id id = 0; id < m_docs.size(); ++id)
+		{
+			if (m_docs[id].m_alive)
+				out.push_back(id);
+		}
+		return out;
+	}
+
+	index::postings index::candidates(field fld, op oper, const std::string& value) const
+	{
+		auto& tokens = m_tokens[fld];
+
+		if (fld == upnp_class)
+		{
+			// the classes are kept whole, not split into words
+			auto accept = [&](const std::string& klass) -> bool
+			{
+				switch (oper)
+				{
+				case op_equal:        return klass == value;
+				case op_contains:     return klass.find(value) != std::string::npos;
+				case op_derived_from: return derived_from(klass, value);
+				default:              return false;
+				}
+			};
+
+			postings out;
+			for (auto& pair : tokens)
+			{
+				if (accept(pair.first))
+					unite(out, pair.second);
+			}
+			return out;
+		}
+
+		auto words = tokenize(value);
+		if (words.empty() || oper == op_derived_from)
+			return all();
+
+		postings out;
+		bool first = true;
+		for (auto& word : words)
+		{
+			postings found;
+			if (oper == op_equal)
+			{
+				auto it = tokens.find(word);
+				if (it != tokens.end())
+					found = it->second;
+			}
+			else
+			{
+				// "contains" may end in the middle of a word
+				for (auto& pair : tokens)
+				{
+					if (pair.first.find(word) != std::string::npos)
+						unite(found, pair.second);
+				}
+			}
+
+			if (first)
+				out.swap(found);
+			else
+				intersect(out, found);
+			first = false;
+
+			if (out.empty())
+				break;
+		}
+
+		return out;
+	}
+
+	bool index::matches(const document& doc, const node* plan) const
+	{
+		switch (plan->m_kind)
+		{
+		case node::leaf:
+			if (plan->m_field == unknown_field)
+				return plan->m_op == op_exists && !plan->m_exists;
+			return leaf_matches(doc.m_fields[plan->m_field], plan);
+		case node::and_node:
+			return matches(doc, plan->m_left.get()) && matches(doc, plan->m_right.get());
+		case node::or_node:
+			return matches(doc, plan->m_left.get()) || matches(doc, plan->m_right.get());
+		}
+		return false;
+	}
+
+	index::postings index::evaluate(const node* plan) const
+	{
+		postings out;
+
+		if (plan->m_kind == node::or_node)
+		{
+			out = evaluate(plan->m_left.get());
+			unite(out, evaluate(plan->m_right.get()));
+			return out;
+		}
+
+		const node* seed = plan;
+		const node* rest = nullptr;
+
+		// answer the indexed side first, check the other one item by item
+		if (plan->m_kind == node::and_node)
+		{
+			seed = plan->m_left.get();
+			rest = plan->m_right.get();
+			if (!indexed(seed) && indexed(rest))
+				std::swap(seed, rest);
+		}
+
+		if (seed->m_kind != node::leaf)
+			out = evaluate(seed);
+		else if (seed->m_field == unknown_field)
+		{
+			if (seed->m_op == op_exists && !seed->m_exists)
+				out = all();
+		}
+		else if (indexed(seed))
+			out = candidates(seed->m_field, seed->m_op, seed->m_value);
+		else
+			out = all();
+
+		auto it = std::remove_if(out.begin(), out.end(), [&](doc_id id) {
+			auto& doc = m_docs[id];
+			if (seed->m_kind == node::leaf && !matches(doc, seed))
+				return true;
+			return rest && !matches(doc, rest);
+		});
+		out.erase(it, out.end());
+
+		return out;
+	}
+
+	std::vector<items::media_item_ptr> index::find(const criteria& query, const items::media_item_ptr& scope)
+	{
+		std::vector<items::media_item_ptr> out;
+
+		// walked before the index is locked; the containers take their own locks
+		scope_filter filter(scope);
+
+		std::lock_guard<std::mutex> lock(m_guard);
+
+		auto found = query.m_root ? evaluate(query.m_root.get()) : all();
+
+		std::vector<doc_id> dead;
+		for (auto id : found)
+		{
+			auto item = m_docs[id].m_item.lock();
+			if (!item)
+			{
+				// went away with its folder
+				dead.push_back(id);
+				continue;
+			}
+
+			if (filter.contains(item))
+				out.push_back(item);
+		}
+
+		for (auto id : dead)
+			purge(id);
+		compact();
+
+		return out;
+	}
+
+}}}}} // net::ssdp::import::av::search
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <media_server.hpp>
+#include <sort.hpp>
+
+namespace net { namespace ssdp { namespace import { namespace av { namespace sorting {
+
+	namespace
+	{
+		inline char lower(char c)
+		{
+			return c >= 'A' && c <= 'Z' ? (char) (c - 'A' + 'a') : c;
+		}
+
+		int compare_nocase(const std::string& lhs, const std::string& rhs)
+		{
+			auto length = std::min(lhs.length(), rhs.length());
+			for (size_t i = 0; i < length; ++i)
+			{
+				auto l = (unsigned char) lower(lhs[i]);
+				auto r = (unsigned char) lower(rhs[i]);
+				if (l != r)
+					return l < r ? -1 : 1;
+			}
+			if (lhs.length() == rhs.length())
+				return 0;
+			return lhs.length() < rhs.length() ? -1 : 1;
+		}
+
+		template <typename T>
+		int compare_values(const T& lhs, const T& rhs)
+		{
+			return lhs < rhs ? -1 : rhs < lhs ? 1 : 0;
+		}
+
+		static const std::string nothing;
+
+		const std::string& artist(const items::media_item* item)
+		{
+			auto metadata = item->get_metadata();
+			return metadata ? metadata->m_artist : nothing;
+		}
+
+		const std::string& album(const items::media_item* item)
+		{
+			auto metadata = item->get_metadata();
+			return metadata ? metadata->m_album : nothing;
+		}
+
+		unsigned track(const items::media_item* item)
+		{
+			auto metadata = item->get_metadata();
+			return metadata ? metadata->m_track : 0;
+		}
+
+		time_t date(const items::media_item* item)
+		{
+			auto common = dynamic_cast<const items::common_props_item*>(item);
+			return common ? common->get_last_write_time() : 0;
+		}
+
+		int compare(key k, const items::media_item* lhs, const items::media_item* rhs)
+		{
+			switch (k)
+			{
+			case dc_title:                 return compare_nocase(lhs->get_title(), rhs->get_title());
+			case upnp_artist:              return compare_nocase(artist(lhs), artist(rhs));
+			case upnp_album:               return compare_nocase(album(lhs), album(rhs));
+			case upnp_originalTrackNumber: return compare_values(track(lhs), track(rhs));
+			case dc_date:                  return compare_values(date(lhs), date(rhs));
+			}
+			return 0;
+		}
+	}
+
+	bool criteria::compile(const std::string& text)
+	{
+		static struct
+		{
+			const char* name;
+			key k;
+		} keys [] = {
+			{ "dc:title",                 dc_title },
+			{ "upnp:artist",              upnp_artist },
+			{ "dc:creator",               upnp_artist },
+			{ "upnp:album",               upnp_album },
+			{ "upnp:originalTrackNumber", upnp_originalTrackNumber },
+			{ "dc:date",                  dc_date },
+		};
+
+		m_keys.clear();
+		m_text.clear();
+
+		size_t pos = 0;
+		while (pos < text.length())
+		{
+			auto comma = text.find(',', pos);
+			if (comma == std::string::npos)
+				comma = text.length();
+
+			auto b = text.find_first_not_of(" \t\r\n", pos);
+			auto e = text.find_last_not_of(" \t\r\n", comma - 1);
+			pos = comma + 1;
+
+			if (b == std::string::npos || b >= comma || e < b)
+				continue;
+
+			bool ascending = true;
+			if (text[b] == '+' || text[b] == '-')
+				ascending = text[b++] == '+';
+
+			auto name = text.substr(b, e - b + 1);
+			bool found = false;
+			for (auto& k : keys)
+			{
+				if (name == k.name)
+				{
+					m_keys.emplace_back(k.k, ascending);
+					if (!m_text.empty())
+						m_text.push_back(',');
+					m_text.push_back(ascending ? '+' : '-');
+					m_text.append(k.name);
+					found = true;
+					break;
+				}
+			}
+
+			if (!found)
+			{
+				m_keys.clear();
+				m_text.clear();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool criteria::less(const items::media_item* lhs, const items::media_item* rhs) const
+	{
+		for (auto& k : m_keys)
+		{
+			auto result = compare(k.first, lhs, rhs);
+			if (result)
+				return k.second ? result < 0 : result > 0;
+		}
+		return false;
+	}
+
+	container_type slice(const container_type& items, ulong start_from, ulong max_count)
+	{
+		if (start_from > items.size())
+			start_from = items.size();
+
+		auto end_at = items.size() - start_from;
+		if (end_at > max_count)
+			end_at = max_count;
+		end_at += start_from;
+
+		return container_type(items.begin() + start_from, items.begin() + end_at);
+	}
+
+	container_type permutations::slice(const container_type& children, const criteria& order, ulong start_from, ulong max_count)
+	{
+		if (order.empty())
+			return sorting::slice(children, start_from, max_count);
+
+		auto it = m_orders.begin();
+		for (; it != m_orders.end(); ++it)
+		{
+			if (it->m_order.str() == order.str())
+				break;
+		}
+
+		if (it == m_orders.end())
+		{
+			if (m_orders.size() >= MAX_ORDERS)
+				m_orders.pop_back();
+
+			// scan order for the items, which compare equal
+			m_orders.push_front(entry { order, children });
+			std::stable_sort(m_orders.front().m_items.begin(), m_orders.front().m_items.end(), order);
+		}
+		else
+			m_orders.splice(m_orders.begin(), m_orders, it);
+
+		return sorting::slice(m_orders.front().m_items, start_from, max_count);
+	}
+
+	void permutations::add(const items::media_item_ptr& item)
+	{
+		for (auto& sorted : m_orders)
+		{
+			auto pos = std::upper_bound(sorted.m_items.begin(), sorted.m_items.end(), item, sorted.m_order);
+			sorted.m_items.insert(pos, item);
+		}
+	}
+
+	void permutations::remove(const items::media_item_ptr& item)
+	{
+		for (auto& sorted : m_orders)
+		{
+			auto range = std::equal_range(sorted.m_items.begin(), sorted.m_items.end(), item, sorted.m_order);
+			auto pos = std::find(range.first, range.second, item);
+			if (pos == range.second)
+				pos = std::find(sorted.m_items.begin(), sorted.m_items.end(), item);
+			if (pos != sorted.m_items.end())
+				sorted.m_items.erase(pos);
+		}
+	}
+
+}}}}} // net::ssdp::import::av::sorting
@@ -221,9 +221,23 @@ namespace net
 					return m_cached;
 				}
 
+				// Re-reads the default interface, unless the address was
+				// pinned in the config file; returns true, if it changed.
+				bool refresh()
+				{
+					Value prev = *this;
+					auto str = get_value<std::string>::helper(m_parent, m_name, "0.0.0.0");
+					if (!Value::from_string(str).is_unspecified())
+						return false;
+
+					m_cached = net::iface::get_default_interface();
+					return m_cached != prev;
+				}
+
 				my_type& operator = (const Value& v)
 				{
 					m_parent.set_value(m_name, v.to_string());
+					m_set = false;
 					return *this;
 				}
 			};
@@ -236,19 +250,29 @@ namespace net
 		{
 		private:
 			wrapper::section server;
+			wrapper::section scanner;
 
 		public:
 			config(const base::config_ptr& impl)
 				: server(impl, "Server")
+				, scanner(impl, "Scanner")
 				, uuid (server, "UUID")
 				, port (server, "Port", 6001)
 				, iface(server, "Interface")
+				, partial_browse(server, "PartialBrowse", false)
+				, listers(scanner, "Listers", 2)
+				, probers(scanner, "Probers", 0)
 			{}
 			virtual ~config() {}
 
 			wrapper::setting<std::string> uuid;
 			wrapper::setting<int> port;
 			wrapper::setting<boost::asio::ip::address_v4> iface;
+			// answer a Browse of a folder, which is still being scanned, with what is there already
+			wrapper::setting<bool> partial_browse;
+			// the threads walking the folders and the ones opening the files; 0 probers is one per core
+			wrapper::setting<int> listers;
+			wrapper::setting<int> probers;
 
 			static inline config_ptr from_file(const boost::filesystem::path& path)
 			{
@@ -306,7 +330,7 @@ namespace net
 					, seek_by_time         (*this, "SeekByTime", false)
 					, protocol_localization(*this, "ProtocolLocalization", false)
 					, profile_patches      (*this, "ProfilePatches")
-					, send_ORG_PN          (*this, "Send_ORG_PN", false)
+					, send_ORG_PN          (*this, "Send_ORG_PN", true)
 				{
 				}
 				wrapper::setting<bool>        seek_by_time;
@@ -26,12 +26,31 @@
 #define __NETWORK_INTERFACE_HPP__
 
 #include <boost/asio.hpp>
+#include <functional>
+#include <memory>
 
 namespace net
 {
 	namespace iface
 	{
 		boost::asio::ip::address_v4 get_default_interface();
+
+		/*
+		 * Watches the OS for address and link changes. The handler is called
+		 * on the io_service thread, possibly several times for one real change;
+		 * it is up to the listener to compare the address it is bound to.
+		 */
+		struct monitor
+		{
+			typedef std::function<void()> change_handler_t;
+
+			virtual ~monitor() {}
+			virtual void start(const change_handler_t& handler) = 0;
+			virtual void stop() = 0;
+		};
+		typedef std::shared_ptr<monitor> monitor_ptr;
+
+		monitor_ptr create_monitor(boost::asio::io_service& service);
 	}
 }
 
@@ -79,6 +79,14 @@ namespace net
 	std::string create_uuid();
 	std::string xmlencode(const std::string& in);
 
+	// appends the escaped text to out
+	void xmlencode(std::string& out, const char* in, size_t length);
+	inline void xmlencode(std::string& out, const std::string& in) { xmlencode(out, in.c_str(), in.length()); }
+
+	// escapes twice, for text of a document, which itself is a text of another document
+	void xmlencode_twice(std::string& out, const char* in, size_t length);
+	inline void xmlencode_twice(std::string& out, const std::string& in) { xmlencode_twice(out, in.c_str(), in.length()); }
+
 	namespace time
 	{
 		inline boost::local_time::local_date_time now()
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <interface.hpp>
+#include <log.hpp>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+namespace net
+{
+	namespace iface
+	{
+		struct log : public Log::basic_log<log>
+		{
+			static const Log::Module& module() { return Log::Module::UPnP; }
+		};
+
+		boost::asio::ip::address_v4 get_default_interface()
+		{
+			using boost::asio::ip::address_v4;
+
+			ifaddrs* list = nullptr;
+			if (getifaddrs(&list) != 0)
+				return address_v4 { INADDR_ANY };
+
+			address_v4 out { INADDR_ANY };
+			for (auto it = list; it; it = it->ifa_next)
+			{
+				if (!it->ifa_addr || it->ifa_addr->sa_family != AF_INET)
+					continue;
+				if ((it->ifa_flags & IFF_UP) == 0 || (it->ifa_flags & IFF_RUNNING) == 0)
+					continue;
+				if (it->ifa_flags & IFF_LOOPBACK)
+					continue;
+
+				auto addr = reinterpret_cast<const sockaddr_in*>(it->ifa_addr);
+				out = address_v4 { ntohl(addr->sin_addr.s_addr) };
+				break;
+			}
+
+			freeifaddrs(list);
+			return out;
+		}
+
+		namespace
+		{
+			struct netlink_monitor : monitor, std::enable_shared_from_this<netlink_monitor>
+			{
+				typedef boost::asio::posix::stream_descriptor descriptor_t;
+				typedef std::array<char, 8192> buffer_t;
+
+				descriptor_t     m_descriptor;
+				buffer_t         m_buffer;
+				change_handler_t m_handler;
+
+				netlink_monitor(boost::asio::io_service& service)
+					: m_descriptor(service)
+				{
+				}
+
+				~netlink_monitor()
+				{
+					stop();
+				}
+
+				void start(const change_handler_t& handler) override
+				{
+					int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+					if (fd < 0)
+					{
+						log::error() << "Cannot open netlink socket: " << strerror(errno);
+						return;
+					}
+
+					sockaddr_nl local = {};
+					local.nl_family = AF_NETLINK;
+					local.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
+					if (bind(fd, (sockaddr*)&local, sizeof(local)) < 0)
+					{
+						log::error() << "Cannot bind netlink socket: " << strerror(errno);
+						close(fd);
+						return;
+					}
+
+					m_handler = handler;
+					m_descriptor.assign(fd);
+					receive();
+				}
+
+				void stop() override
+				{
+					boost::system::error_code ec;
+					m_descriptor.close(ec);
+				}
+
+				void receive()
+				{
+					auto self = shared_from_this();
+					m_descriptor.async_read_some(boost::asio::buffer(m_buffer), [self, this](const boost::system::error_code& ec, std::size_t received)
+					{
+						if (ec)
+							return;
+
+						if (interesting(received) && m_handler)
+							m_handler();
+
+						receive();
+					});
+				}
+
+				bool interesting(std::size_t received) const
+				{
+					int len = (int) received;
+					for (auto hdr = (const nlmsghdr*) m_buffer.data(); NLMSG_OK(hdr, len); hdr = NLMSG_NEXT(hdr, len))
+					{
+						switch (hdr->nlmsg_type)
+						{
+						case RTM_NEWADDR:
+						case RTM_DELADDR:
+						case RTM_NEWLINK:
+						case RTM_DELLINK:
+							return true;
+						}
+					}
+					return false;
+				}
+			};
+		}
+
+		monitor_ptr create_monitor(boost::asio::io_service& service)
+		{
+			return std::make_shared<netlink_monitor>(service);
+		}
+	}
+}
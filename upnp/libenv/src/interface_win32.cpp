@@ -102,5 +102,21 @@ namespace net
 
 			return address_v4 { INADDR_ANY };
 		}
+
+		namespace
+		{
+			// Interface changes are not tracked on Windows yet; the ticker
+			// will pick up the new address on the next restart.
+			struct null_monitor : monitor
+			{
+				void start(const change_handler_t&) override {}
+				void stop() override {}
+			};
+		}
+
+		monitor_ptr create_monitor(boost::asio::io_service&)
+		{
+			return std::make_shared<null_monitor>();
+		}
 	}
 }
@@ -25,46 +25,118 @@
 #include "pch.h"
 #include <utils.hpp>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XMLENCODE_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 namespace net
 {
-	std::string xmlencode(const std::string& in)
+	namespace
 	{
-		auto len = in.length();
-		for (auto && c : in)
+		inline bool needs_escape(char c)
 		{
-			switch (c)
+			return c == '<' || c == '>' || c == '&' || c == '"';
+		}
+
+#ifdef XMLENCODE_SSE2
+		inline size_t first_bit(unsigned int mask)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return index;
+#else
+			return __builtin_ctz(mask);
+#endif
+		}
+#endif
+
+		// length of the prefix, which can be copied as-is; bytes of UTF-8
+		// sequences are all above 0x7F, so they never need to be looked at
+		size_t clean_run(const char* in, size_t length)
+		{
+			size_t i = 0;
+#ifdef XMLENCODE_SSE2
+			const __m128i lt = _mm_set1_epi8('<');
+			const __m128i gt = _mm_set1_epi8('>');
+			const __m128i amp = _mm_set1_epi8('&');
+			const __m128i quot = _mm_set1_epi8('"');
+
+			for (; i + 16 <= length; i += 16)
 			{
-			case '<':
-			case '>':
-				len += 3;
-				break;
-			case '&':
-				len += 4;
-				break;
-			case '"':
-				len += 5;
-				break;
+				auto chunk = _mm_loadu_si128((const __m128i*) (in + i));
+				auto hits = _mm_or_si128(
+					_mm_or_si128(_mm_cmpeq_epi8(chunk, lt), _mm_cmpeq_epi8(chunk, gt)),
+					_mm_or_si128(_mm_cmpeq_epi8(chunk, amp), _mm_cmpeq_epi8(chunk, quot)));
+				auto mask = (unsigned int) _mm_movemask_epi8(hits);
+				if (mask)
+					return i + first_bit(mask);
 			}
+#endif
+			while (i < length && !needs_escape(in[i]))
+				++i;
+			return i;
 		}
 
-		if (len == in.length())
-			return in;
+		template <typename Entity>
+		void encode(std::string& out, const char* in, size_t length, Entity entity)
+		{
+			out.reserve(out.size() + length);
+			while (length)
+			{
+				auto run = clean_run(in, length);
+				out.append(in, run);
+				in += run;
+				length -= run;
 
-		std::string out;
-		out.reserve(len);
+				if (!length)
+					break;
 
-		for (auto && c : in)
+				entity(out, *in++);
+				--length;
+			}
+		}
+	}
+
+	void xmlencode(std::string& out, const char* in, size_t length)
+	{
+		encode(out, in, length, [](std::string& out, char c)
 		{
 			switch (c)
 			{
-			case '<': out.append("&lt;"); break;
-			case '>': out.append("&gt;"); break;
-			case '&': out.append("&amp;"); break;
-			case '"': out.append("&quot;"); break;
-			default:  out.push_back(c);
+			case '<': out.append("&lt;", 4); break;
+			case '>': out.append("&gt;", 4); break;
+			case '&': out.append("&amp;", 5); break;
+			case '"': out.append("&quot;", 6); break;
 			}
-		}
+		});
+	}
+
+	void xmlencode_twice(std::string& out, const char* in, size_t length)
+	{
+		encode(out, in, length, [](std::string& out, char c)
+		{
+			switch (c)
+			{
+			case '<': out.append("&amp;lt;", 8); break;
+			case '>': out.append("&amp;gt;", 8); break;
+			case '&': out.append("&amp;amp;", 9); break;
+			case '"': out.append("&amp;quot;", 10); break;
+			}
+		});
+	}
+
+	std::string xmlencode(const std::string& in)
+	{
+		if (clean_run(in.c_str(), in.length()) == in.length())
+			return in;
 
+		std::string out;
+		xmlencode(out, in.c_str(), in.length());
 		return out;
 	}
 }
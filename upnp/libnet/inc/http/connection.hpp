@@ -117,17 +117,21 @@ namespace net
 			void start() { read_some_more(); }
 			void run();
 			void stop() { m_socket.close(); }
+			// the Web thread, which renders the generated bodies of this connection
+			void attach(const queue::worker_ptr& worker) { m_worker = worker; }
 		private:
 			void read_some_more();
 			bool parse_header(std::size_t bytes_transferred);
 			void send_reply(bool send_body);
 			static void continue_sending(connection_ptr self, response_buffer buffer, boost::system::error_code ec, std::size_t);
+			static void send_next(connection_ptr self, response_buffer buffer);
 
 			std::array<char, 8192> m_buffer;
 			boost::asio::ip::tcp::socket m_socket;
 			http::header_parser<http::http_request> m_parser;
 			connection_manager& m_manager;
 			request_handler_ptr m_handler;
+			std::weak_ptr<queue::Queue> m_worker;
 			response m_response;
 			std::vector<char> m_response_chunk;
 			int m_pos;
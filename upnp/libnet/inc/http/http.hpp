@@ -111,7 +111,9 @@ namespace net
 			head,
 			post,
 			m_search,
-			notify
+			notify,
+			subscribe,
+			unsubscribe
 		};
 		struct http_request : http_request_line, mime::headers
 		{
@@ -148,6 +150,8 @@ namespace net
 				if (m_method == "POST")     return http_method::post;
 				if (m_method == "M-SEARCH") return http_method::m_search;
 				if (m_method == "NOTIFY")   return http_method::notify;
+				if (m_method == "SUBSCRIBE")   return http_method::subscribe;
+				if (m_method == "UNSUBSCRIBE") return http_method::unsubscribe;
 
 				return http_method::other;
 			}
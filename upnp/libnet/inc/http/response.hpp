@@ -30,6 +30,9 @@
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <limits>
+#include <functional>
+#include <deque>
+#include <mutex>
 
 namespace fs = boost::filesystem;
 
@@ -50,10 +53,13 @@ namespace net
 			virtual std::size_t get_size() = 0;
 			virtual std::size_t skip(std::size_t size) = 0;
 			virtual std::size_t read(void* buffer, std::size_t size) = 0;
+			// false, if the next part is not there yet; resume is called, once it is
+			virtual bool ready(const std::function<void ()>& /*resume*/) { return true; }
 			template <std::size_t size>
 			std::size_t read(char (&buffer)[size]) { return read(buffer, size); }
 
 			inline static content_ptr from_string(const std::string& text);
+			inline static content_ptr from_string(std::string&& text);
 			inline static content_ptr from_file(const fs::path& path);
 		};
 
@@ -63,6 +69,7 @@ namespace net
 			std::size_t m_pointer;
 		public:
 			string_content(const std::string& text) : m_text(text), m_pointer(0) {}
+			string_content(std::string&& text) : m_text(std::move(text)), m_pointer(0) {}
 			bool can_skip() override { return true; }
 			bool size_known() override { return true; }
 			std::size_t get_size() override { return m_text.size(); }
@@ -117,10 +124,141 @@ namespace net
 			}
 		};
 
+		/*
+		 * A body assembled from pieces, some of them text and some produced
+		 * on demand. A generator appends its next part to the buffer it is
+		 * given and returns false once it has nothing more to add. Only the
+		 * current part is kept in memory; the size is not known up front,
+		 * so the response goes out chunked.
+		 */
+		class chunked_content : public content
+		{
+		public:
+			typedef std::function<bool (std::string& out)> generator_t;
+		private:
+			struct piece
+			{
+				std::string m_text;
+				generator_t m_generator;
+			};
+			std::deque<piece> m_pieces;
+			std::string m_buffer;
+			std::size_t m_pointer;
+
+			bool fill()
+			{
+				m_buffer.clear();
+				m_pointer = 0;
+				while (m_buffer.empty() && !m_pieces.empty())
+				{
+					auto& front = m_pieces.front();
+					if (front.m_generator)
+					{
+						if (!front.m_generator(m_buffer))
+							m_pieces.pop_front();
+					}
+					else
+					{
+						m_buffer.swap(front.m_text);
+						m_pieces.pop_front();
+					}
+				}
+				return !m_buffer.empty();
+			}
+		public:
+			chunked_content() : m_pointer(0) {}
+
+			void append(std::string&& text)
+			{
+				if (text.empty())
+					return;
+				m_pieces.emplace_back();
+				m_pieces.back().m_text = std::move(text);
+			}
+
+			void append(const generator_t& generator)
+			{
+				m_pieces.emplace_back();
+				m_pieces.back().m_generator = generator;
+			}
+
+			bool can_skip() override { return false; }
+			bool size_known() override { return false; }
+			std::size_t get_size() override { return 0; }
+			std::size_t skip(std::size_t) override { return 0; }
+			std::size_t read(void* buffer, std::size_t size) override
+			{
+				std::size_t _read = 0;
+				while (size > 0)
+				{
+					if (m_pointer >= m_buffer.size() && !fill())
+						break;
+
+					auto rest = m_buffer.size() - m_pointer;
+					if (rest > size)
+						rest = size;
+
+					memcpy((char*) buffer + _read, m_buffer.c_str() + m_pointer, rest);
+					_read += rest;
+					size -= rest;
+					m_pointer += rest;
+				}
+				return _read;
+			}
+		};
+
+		/*
+		 * A body, which is not there yet, when the header goes out. The
+		 * handler resolves it later, from any thread, and the connection
+		 * continues sending from there; no thread is held in between.
+		 */
+		class deferred_content : public content
+		{
+			std::mutex m_guard;
+			content_ptr m_content;
+			std::function<void ()> m_resume;
+		public:
+			void resolve(const content_ptr& body)
+			{
+				std::function<void ()> resume;
+				{
+					std::lock_guard<std::mutex> lock(m_guard);
+					m_content = body ? body : std::make_shared<string_content>(std::string());
+					resume.swap(m_resume);
+				}
+
+				if (resume)
+					resume();
+			}
+
+			bool ready(const std::function<void ()>& resume) override
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+				if (m_content)
+					return m_content->ready(resume);
+
+				m_resume = resume;
+				return false;
+			}
+
+			bool can_skip() override { return false; }
+			bool size_known() override { return false; }
+			std::size_t get_size() override { return 0; }
+			std::size_t skip(std::size_t) override { return 0; }
+			std::size_t read(void* buffer, std::size_t size) override
+			{
+				return m_content ? m_content->read(buffer, size) : 0;
+			}
+		};
+
 		inline content_ptr content::from_string(const std::string& text)
 		{
 			return std::make_shared<string_content>(text);
 		}
+		inline content_ptr content::from_string(std::string&& text)
+		{
+			return std::make_shared<string_content>(std::move(text));
+		}
 		inline content_ptr content::from_file(const fs::path& path)
 		{
 			return std::make_shared<file_content>(path);
@@ -147,7 +285,9 @@ namespace net
 		public:
 			explicit response_buffer(response& data);
 
+			bool ready(const std::function<void ()>& resume);
 			bool advance(std::vector<char>& buffer);
+			bool chunked() const { return m_chunked; }
 		};
 
 		class response : boost::noncopyable
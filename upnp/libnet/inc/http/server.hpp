@@ -41,6 +41,7 @@ namespace net
 
 			void start() { do_accept(); }
 			void stop();
+			void rebind();
 
 		private:
 			request_handler_ptr m_handler;
@@ -51,6 +52,7 @@ namespace net
 			boost::asio::ip::tcp::socket m_socket;
 			http::connection_manager m_manager;
 
+			void listen();
 			void do_accept();
 		};
 	}
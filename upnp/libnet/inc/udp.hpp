@@ -49,6 +49,7 @@ namespace net
 
 			void start(const receive_handler_t& handler);
 			void stop();
+			void rebind(const address_t& local, boost::system::error_code& ec);
 
 			const char* data() const { return m_buffer.data(); }
 			size_t received() const { return m_received; }
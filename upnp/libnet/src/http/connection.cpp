@@ -174,6 +174,7 @@ namespace net
 
 			if (m_worker != m_pool.end()) // empty pool?
 			{
+				c->attach(*m_worker);
 				(*m_worker)->post([c]{ c->run(); });
 				++m_worker;
 				while (m_worker != m_pool.end() && !(*m_worker)->is_valid())
@@ -368,23 +369,24 @@ namespace net
 		{
 			if (!ec)
 			{
-				if (buffer.advance(self->m_response_chunk))
+				// a body, which is not ready yet, calls back here; the thread is let go meanwhile
+				bool ready = buffer.ready([self, buffer]
 				{
-					//std::cout.write(self->m_response_chunk.data(), self->m_response_chunk.size());
-					boost::asio::async_write(
-						self->m_socket, boost::asio::buffer(self->m_response_chunk),
-						[self, buffer](boost::system::error_code ec, std::size_t size)
+					self->m_socket.get_io_service().post([self, buffer]
 					{
-						continue_sending(self, buffer, ec, size);
+						continue_sending(self, buffer, boost::system::error_code(), 0);
 					});
+				});
+				if (!ready)
 					return;
-				}
+
+				// a generated body is rendered on the Web thread; the io thread only writes it out
+				auto worker = buffer.chunked() ? self->m_worker.lock() : queue::worker_ptr();
+				if (worker && worker->is_valid())
+					worker->post([self, buffer] { send_next(self, buffer); });
 				else
-				{
-					// Initiate graceful connection closure.
-					boost::system::error_code ignored_ec;
-					self->m_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
-				}
+					send_next(self, buffer);
+				return;
 			}
 
 			if (ec != boost::asio::error::operation_aborted)
@@ -393,6 +395,43 @@ namespace net
 			}
 		}
 
+		void connection::send_next(connection_ptr self, response_buffer buffer)
+		{
+			bool more = false;
+			try
+			{
+				more = buffer.advance(self->m_response_chunk);
+			}
+			catch (std::exception& e)
+			{
+				// the header is gone already; a client sees the cut, instead of waiting for the rest
+				log::error() << "[CONNECTION] Cannot produce the response: " << e.what();
+				return self->m_manager.stop(self);
+			}
+			catch (...)
+			{
+				log::error() << "[CONNECTION] Cannot produce the response";
+				return self->m_manager.stop(self);
+			}
+
+			if (more)
+			{
+				//std::cout.write(self->m_response_chunk.data(), self->m_response_chunk.size());
+				boost::asio::async_write(
+					self->m_socket, boost::asio::buffer(self->m_response_chunk),
+					[self, buffer](boost::system::error_code ec, std::size_t size)
+				{
+					continue_sending(self, buffer, ec, size);
+				});
+				return;
+			}
+
+			// Initiate graceful connection closure.
+			boost::system::error_code ignored_ec;
+			self->m_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
+			self->m_manager.stop(self);
+		}
+
 		void connection::send_reply(bool send_body)
 		{
 			if (!send_body)
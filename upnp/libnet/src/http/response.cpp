@@ -38,6 +38,14 @@ namespace net
 		{
 		}
 
+		bool response_buffer::ready(const std::function<void ()>& resume)
+		{
+			if (m_status != chunks || !m_data.content())
+				return true;
+
+			return m_data.content()->ready(resume);
+		}
+
 		bool response_buffer::advance(std::vector<char>& out_buffer)
 		{
 			if (m_status == header)
@@ -35,10 +35,15 @@ namespace net
 			, m_acceptor(service)
 			, m_socket(service)
 			, m_config(config)
+		{
+			listen();
+		}
+
+		void server::listen()
 		{
 			boost::asio::ip::tcp::resolver resolver(m_io_service);
 			boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve(
-				boost::asio::ip::tcp::resolver::query{ to_string(config->iface), std::to_string(config->port) }
+				boost::asio::ip::tcp::resolver::query{ to_string(m_config->iface), std::to_string(m_config->port) }
 			);
 			m_acceptor.open(endpoint.protocol());
 			m_acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
@@ -55,6 +60,29 @@ namespace net
 			m_manager.stop_all();
 		}
 
+		void server::rebind()
+		{
+			// Closing the acceptor queues the pending accept with
+			// operation_aborted; the new acceptor is opened only after that
+			// handler had a chance to see the closed socket and bail out.
+			// Connections already being served are left alone.
+			m_acceptor.close();
+			m_io_service.post([this]
+			{
+				try
+				{
+					listen();
+					do_accept();
+				}
+				catch (boost::system::system_error&)
+				{
+					// the address is not ready yet; next change will retry
+					boost::system::error_code ec;
+					m_acceptor.close(ec);
+				}
+			});
+		}
+
 		void server::do_accept()
 		{
 			m_acceptor.async_accept(m_socket, [this](boost::system::error_code ec) {
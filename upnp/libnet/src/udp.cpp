@@ -50,8 +50,37 @@ namespace net
 
 		void multicast_receiver::stop()
 		{
-			m_socket.set_option(boost::asio::ip::multicast::leave_group(m_multicast.address().to_v4(), m_local));
-			m_socket.close();
+			boost::system::error_code ec;
+			m_socket.set_option(boost::asio::ip::multicast::leave_group(m_multicast.address().to_v4(), m_local), ec);
+			m_socket.close(ec);
+		}
+
+		void multicast_receiver::rebind(const address_t& local, boost::system::error_code& ec)
+		{
+			// the old address may already be gone, so errors from leaving
+			// the group are of no interest here
+			stop();
+
+			// this runs on the io_service thread, so nothing may be thrown
+			// from here; the new address may be not quite ready yet either
+			m_local = local;
+			m_socket.open(m_multicast.protocol(), ec);
+			if (!ec)
+				m_socket.set_option(boost::asio::ip::udp::socket::reuse_address(true), ec);
+			if (!ec)
+				m_socket.bind(endpoint_t(m_local, m_multicast.port()), ec);
+			if (!ec)
+				m_socket.set_option(boost::asio::ip::multicast::join_group(m_multicast.address().to_v4(), m_local), ec);
+
+			if (ec)
+			{
+				// the next change will retry
+				boost::system::error_code ignore;
+				m_socket.close(ignore);
+				return;
+			}
+
+			receive();
 		}
 
 		void multicast_receiver::receive()
@@ -100,7 +129,8 @@ namespace net
 
 		multicast_socket::~multicast_socket()
 		{
-			m_socket.set_option(boost::asio::ip::multicast::leave_group(m_remote.address().to_v4(), m_local));
+			boost::system::error_code ec;
+			m_socket.set_option(boost::asio::ip::multicast::leave_group(m_remote.address().to_v4(), m_local), ec);
 		}
 
 		void multicast_socket::send(const std::string& msg)
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __CLIENT_CACHE_HPP__
+#define __CLIENT_CACHE_HPP__
+
+#include <device.hpp>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <boost/asio/ip/address.hpp>
+
+namespace net
+{
+	namespace ssdp
+	{
+		/*
+		 * Remembers which client_info a given remote endpoint resolved to.
+		 * A client is keyed by its address and a hash of the user agent and
+		 * of every other header any of the renderer configurations looks at,
+		 * so a device changing its identity is matched again. The cache is
+		 * split into independently locked shards, each one a bounded LRU.
+		 */
+		class client_cache
+		{
+		public:
+			typedef unsigned long long fingerprint_t;
+
+			enum { DEFAULT_CAPACITY = 256, SHARD_COUNT = 8 };
+
+			explicit client_cache(size_t capacity = DEFAULT_CAPACITY);
+
+			void set_headers(const std::vector<std::string>& headers);
+			fingerprint_t fingerprint(const http::http_request& req) const;
+
+			client_info_ptr find(const boost::asio::ip::address& address, fingerprint_t fingerprint);
+			void insert(const boost::asio::ip::address& address, fingerprint_t fingerprint, const client_info_ptr& client);
+			void clear();
+
+			size_t hits() const { return m_hits.load(); }
+			size_t misses() const { return m_misses.load(); }
+		private:
+			struct key
+			{
+				boost::asio::ip::address m_address;
+				fingerprint_t m_fingerprint;
+
+				bool operator == (const key& rhs) const
+				{
+					return m_fingerprint == rhs.m_fingerprint && m_address == rhs.m_address;
+				}
+			};
+
+			struct key_hash
+			{
+				size_t operator()(const key& k) const;
+			};
+
+			typedef std::list<std::pair<key, client_info_ptr>> lru_t;
+
+			struct shard
+			{
+				std::mutex m_guard;
+				lru_t m_lru; // most recently used first
+				std::unordered_map<key, lru_t::iterator, key_hash> m_index;
+			};
+
+			shard& shard_for(const key& k);
+
+			std::vector<std::string> m_headers;
+			size_t m_shard_capacity;
+			shard m_shards[SHARD_COUNT];
+			std::atomic<size_t> m_hits;
+			std::atomic<size_t> m_misses;
+		};
+	}
+}
+
+#endif // __CLIENT_CACHE_HPP__
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __CLIENT_MATCHER_SET_HPP__
+#define __CLIENT_MATCHER_SET_HPP__
+
+#include <device.hpp>
+#include <string>
+#include <vector>
+
+namespace net
+{
+	namespace ssdp
+	{
+		/*
+		 * All the client matchers of a device, compiled together. Every
+		 * UAMatch pattern contributes the literal text each of its matches
+		 * must contain; the literals form one Aho-Corasick automaton, so a
+		 * single pass over the user agent names the few matchers worth
+		 * running the regular expression for. Patterns with no usable
+		 * literal are always verified.
+		 */
+		class client_matcher_set
+		{
+		public:
+			enum : size_t { npos = (size_t) -1 };
+
+			size_t add(const client_matcher& matcher);
+			size_t size() const { return m_matchers.size(); }
+
+			// index of the first matcher, in the order of add(), accepting the request
+			size_t find(const http::http_request& request) const;
+
+		private:
+			struct state
+			{
+				size_t m_fail;
+				std::vector<size_t> m_output; // matcher indices, including those reached by fail links
+			};
+
+			std::vector<client_matcher> m_matchers;
+			std::vector<std::vector<std::string>> m_literals; // per matcher
+			std::vector<bool> m_always;      // user agent pattern without a usable literal
+
+			unsigned char m_class[256];      // byte -> column; 0 is "any other byte"
+			size_t m_classes;
+			std::vector<state> m_states;
+			std::vector<size_t> m_delta;     // m_states.size() x m_classes
+
+			void compile();
+			static bool required_literals(const std::string& pattern, std::vector<std::string>& out);
+		};
+	}
+}
+
+#endif // __CLIENT_MATCHER_SET_HPP__
@@ -28,12 +28,7 @@
 #include <config.hpp>
 #include <log.hpp>
 #include <regex>
-
-namespace dom
-{
-	struct XmlDocument;
-	typedef std::shared_ptr<XmlDocument> XmlDocumentPtr;
-}
+#include <mutex>
 
 namespace net
 {
@@ -57,6 +52,8 @@ namespace net
 			{}
 
 			bool matches(const http::http_request& request) const;
+			const std::string& user_agent() const { return m_ua_string; }
+			const std::string& other_header() const { return m_other_header; }
 		private:
 			std::string m_other_header;
 			std::string m_ua_string;
@@ -96,12 +93,27 @@ namespace net
 			} m_manufacturer;
 		};
 
+		typedef std::vector<std::pair<std::string, std::string>> event_state;
+
+		struct event_sink
+		{
+			virtual ~event_sink() {}
+
+			// a plain evented variable; the latest value wins
+			virtual void property_changed(const char* service_id, const std::string& name, const std::string& value) = 0;
+
+			// one "key,value" entry of a list variable, like ContainerUpdateIDs
+			virtual void list_changed(const char* service_id, const std::string& name, const std::string& key, const std::string& value) = 0;
+		};
+		typedef std::shared_ptr<event_sink> event_sink_ptr;
+
 		struct ServiceInterface
 		{
 			virtual ~ServiceInterface() {}
 			virtual const char* get_type() const = 0;
 			virtual const char* get_id() const = 0;
-			virtual bool answer(const std::string& /*name*/, const client_info_ptr& /*info*/, const http::http_request& /*req*/, const dom::XmlDocumentPtr& /*doc*/, http::response& /*response*/, const http::module_version& /*server*/) { return false; }
+			virtual void get_events(event_state& /*out*/) const {}
+			virtual bool answer(const std::string& /*name*/, const client_info_ptr& /*info*/, const http::http_request& /*req*/, http::response& /*response*/, const http::module_version& /*server*/) { return false; }
 			virtual std::string get_configuration(const ssdp::client_info_ptr& /*client*/) const { return std::string(); };
 		};
 		typedef std::shared_ptr<ServiceInterface> service_ptr;
@@ -123,10 +135,20 @@ namespace net
 			virtual size_t get_service_count() const { return m_services.size(); }
 			virtual service_ptr get_service(size_t i) const { return m_services[i]; }
 			virtual std::string get_configuration(const ssdp::client_info_ptr& client, const std::string& host) const;
-			virtual bool call_http(const http::http_request& req, const boost::filesystem::path& root, const boost::filesystem::path& rest, http::response& resp) = 0;
+			// path segments served under /upnp/<root>/; call_http gets the index of the matched root
+			virtual std::vector<std::string> get_http_roots() const { return std::vector<std::string>(); }
+			virtual bool call_http(const http::http_request& req, size_t root, const std::string& rest, http::response& resp) = 0;
 			virtual client_info_ptr match_from_request(const http::http_request& request) const = 0;
+			// headers, other than the user agent, match_from_request looks at
+			virtual std::vector<std::string> get_client_headers() const { return std::vector<std::string>(); }
 
 			config::config_ptr config() const { return m_config; }
+
+			void set_event_sink(const event_sink_ptr& sink)
+			{
+				std::lock_guard<std::mutex> lock(m_sink_guard);
+				m_sink = sink;
+			}
 		protected:
 			void add(const service_ptr& service)
 			{
@@ -135,9 +157,17 @@ namespace net
 				m_services.push_back(service);
 			}
 
+			event_sink_ptr get_event_sink() const
+			{
+				std::lock_guard<std::mutex> lock(m_sink_guard);
+				return m_sink;
+			}
+
 		private:
 			config::config_ptr m_config;
 			std::vector<service_ptr> m_services;
+			mutable std::mutex m_sink_guard;
+			event_sink_ptr m_sink;
 			const device_info m_info;
 			const std::string m_usn;
 
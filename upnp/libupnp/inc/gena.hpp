@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef __SSDP_GENA_HPP__
+#define __SSDP_GENA_HPP__
+
+#include <device.hpp>
+#include <boost/asio.hpp>
+#include <map>
+#include <mutex>
+
+namespace net
+{
+	namespace ssdp
+	{
+		namespace gena
+		{
+			static const long DEFAULT_TIMEOUT = 1800;
+			static const long MIN_TIMEOUT = 60;
+			static const long MODERATION_MS = 2000;
+			static const long INITIAL_EVENT_MS = 100;
+
+			struct subscriber;
+			typedef std::shared_ptr<subscriber> subscriber_ptr;
+
+			/*
+			 * The GENA subscription table. Changes coming from the device are
+			 * queued per subscriber and sent at most once every MODERATION_MS;
+			 * list entries for the same key replace each other while waiting.
+			 * All the network I/O is done on the io_service thread.
+			 */
+			class subscriptions : public event_sink, public std::enable_shared_from_this<subscriptions>
+			{
+			public:
+				subscriptions(boost::asio::io_service& service) : m_service(service) {}
+
+				// callbacks is the raw CALLBACK header; returns the new SID or empty string on error
+				std::string subscribe(const service_ptr& service, const std::string& callbacks, long& timeout);
+				bool renew(const std::string& sid, long& timeout);
+				bool unsubscribe(const std::string& sid);
+				void stop();
+
+				void property_changed(const char* service_id, const std::string& name, const std::string& value) override;
+				void list_changed(const char* service_id, const std::string& name, const std::string& key, const std::string& value) override;
+
+				static long parse_timeout(const std::string& header);
+
+			private:
+				boost::asio::io_service&              m_service;
+				std::mutex                            m_guard;
+				std::map<std::string, subscriber_ptr> m_subscribers;
+
+				void expire();
+				void schedule(const subscriber_ptr& sub, long delay_ms);
+				void flush(const subscriber_ptr& sub);
+			};
+			typedef std::shared_ptr<subscriptions> subscriptions_ptr;
+		}
+	}
+}
+
+#endif // __SSDP_GENA_HPP__
@@ -31,6 +31,9 @@
 #include <boost/filesystem.hpp>
 #include <device.hpp>
 #include <config.hpp>
+#include <gena.hpp>
+#include <http_router.hpp>
+#include <client_cache.hpp>
 
 namespace net
 {
@@ -39,28 +42,25 @@ namespace net
 		typedef std::vector<std::pair<std::string, std::string>> template_vars;
 		class http_handler: public request_handler, boost::noncopyable
 		{
-			struct client
-			{
-				boost::asio::ip::address m_address;
-				ssdp::client_info_ptr m_client;
-				client(const boost::asio::ip::address& address, const ssdp::client_info_ptr& client)
-					: m_address(address)
-					, m_client(client)
-				{}
-			};
-
 			template_vars      m_vars;
 			ssdp::device_ptr   m_device;
 			config::config_ptr m_config;
-			std::vector<client> m_clients_seen;
+			ssdp::client_cache m_clients;
+			ssdp::gena::subscriptions_ptr m_events;
+			router             m_router;
+			std::vector<ssdp::service_ptr> m_services;
 
 			void make_templated(const char* tmplt, const char* content_type, response& resp);
 			void make_device_xml(const ssdp::client_info_ptr& client, response& resp);
 			void make_service_xml(const ssdp::client_info_ptr& client, response& resp, const ssdp::service_ptr& service);
 			void make_file(const boost::filesystem::path& path, response& resp);
+			void make_subscription(const http_request& req, const ssdp::service_ptr& service, response& resp);
+			void make_control(const http_request& req, size_t control_id, response& resp);
 			ssdp::client_info_ptr client_from_request(const http_request& req, bool save = true);
+			void build_router();
 		public:
-			http_handler(const ssdp::device_ptr& device, const config::config_ptr& config);
+			http_handler(boost::asio::io_service& service, const ssdp::device_ptr& device, const config::config_ptr& config);
+			void stop();
 			void handle(const http_request& req, response& resp) override;
 			void make_404(response& resp) override;
 			void make_500(response& resp);
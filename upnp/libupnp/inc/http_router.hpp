@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __HTTP_ROUTER_HPP__
+#define __HTTP_ROUTER_HPP__
+
+#include <string>
+#include <vector>
+
+namespace net
+{
+	namespace http
+	{
+		enum class route
+		{
+			none,
+			device_xml,  // /config/device.xml
+			service_xml, // /config/serviceN
+			images,      // /images/...
+			device_http, // /upnp/<root>/..., with roots taken from the device
+			event,       // /upnp/event/serviceN
+			control,     // /upnp/control/serviceN
+		};
+
+		struct route_target
+		{
+			route m_route;
+			size_t m_index;
+
+			route_target() : m_route(route::none), m_index(0) {}
+			route_target(route r, size_t index) : m_route(r), m_index(index) {}
+			explicit operator bool() const { return m_route != route::none; }
+		};
+
+		/*
+		 * A byte trie over fixed strings. Every node may end an exact key,
+		 * a prefix key or both; lookups walk the input once and never
+		 * allocate.
+		 */
+		class route_trie
+		{
+			struct node
+			{
+				std::vector<std::pair<char, size_t>> m_children;
+				route_target m_exact;
+				route_target m_prefix;
+			};
+			std::vector<node> m_nodes;
+
+			size_t insert(const std::string& key);
+			size_t child(size_t n, char c) const;
+		public:
+			route_trie() : m_nodes(1) {}
+
+			void add_exact(const std::string& key, const route_target& target) { m_nodes[insert(key)].m_exact = target; }
+			void add_prefix(const std::string& key, const route_target& target) { m_nodes[insert(key)].m_prefix = target; }
+
+			// exact match wins; otherwise the longest prefix, with its length in "matched"
+			route_target find(const char* key, size_t length, size_t& matched) const;
+		};
+
+		struct route_match
+		{
+			route_target m_target;
+			const char* m_rest;
+			size_t m_rest_length;
+
+			route_match() : m_rest(nullptr), m_rest_length(0) {}
+		};
+
+		class router
+		{
+			route_trie m_paths;
+			route_trie m_urns;
+		public:
+			void add_path(const std::string& path, route r, size_t index = 0) { m_paths.add_exact(path, { r, index }); }
+			void add_prefix(const std::string& prefix, route r, size_t index = 0) { m_paths.add_prefix(prefix, { r, index }); }
+			void add_service(const std::string& type, size_t index) { m_urns.add_exact(type, { route::control, index }); }
+
+			route_match find(const std::string& resource) const;
+
+			// splits "urn:...:service:Name:1#Action" into the index of the service and the action
+			bool find_action(const std::string& SOAPAction, size_t& service, std::string& action) const;
+		};
+	}
+}
+
+#endif // __HTTP_ROUTER_HPP__
@@ -60,6 +60,7 @@ namespace net
 		struct state_variable : private xml_helper
 		{
 			bool m_event;
+			bool m_escaped;
 			bool m_referenced;
 			std::string m_name;
 			std::string m_type;
@@ -72,7 +73,7 @@ namespace net
 				{
 					if (m_values.empty())
 					{
-						if (m_type == "string") return "const std::string&";
+						if (m_type == "string") return m_escaped ? "const xml_escaped&" : "const std::string&";
 						if (m_type == "bin.base64") return "const base64&";
 						return m_type;
 					}
@@ -83,7 +84,7 @@ namespace net
 				{
 					if (m_values.empty())
 					{
-						if (m_type == "string") return "std::string&";
+						if (m_type == "string") return m_escaped ? "xml_escaped&" : "std::string&";
 						if (m_type == "bin.base64") return "base64&";
 						return m_type + "&";
 					}
@@ -95,7 +96,7 @@ namespace net
 			{
 				if (m_values.empty())
 				{
-					if (m_type == "string") return "std::string";
+					if (m_type == "string") return m_escaped ? "xml_escaped" : "std::string";
 					if (m_type == "bin.base64") return "base64";
 					return m_type;
 				}
@@ -108,6 +109,10 @@ namespace net
 				auto sendEvent = find_string(variable, "@sendEvents");
 
 				m_event = sendEvent == "1" || sendEvent == "yes";
+
+				// not a part of SCPD; the value is escaped by the service, not by the SOAP response
+				auto escaped = find_string(variable, "@escaped");
+				m_escaped = escaped == "1" || escaped == "yes";
 				m_name = find_string(variable, "svc:name", svc());
 				m_type = find_string(variable, "svc:dataType", svc());
 				m_referenced = false;
@@ -5,9 +5,13 @@
 #define __SSDP_SERVICE_IMPL_HPP__
 
 #include <string>
+#include <cstdlib>
+#include <type_traits>
+#include <functional>
+#include <mutex>
 #include <http/response.hpp>
 #include <device.hpp>
-#include <dom.hpp>
+#include <soap.hpp>
 #include <log.hpp>
 
 namespace net { namespace ssdp { namespace import {
@@ -48,6 +52,104 @@ namespace net { namespace ssdp { namespace import {
 		}
 	};
 
+	/*
+	 * An answer, which the action could not give right away. The action
+	 * fills the output arguments later, from any thread, and calls done();
+	 * the response is written only then, and the Web thread is not held.
+	 */
+	struct pending_answer
+	{
+		typedef std::function<void ()> resume_t;
+
+		pending_answer() : m_done(false) {}
+
+		void done()
+		{
+			resume_t resume;
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+				m_done = true;
+				resume.swap(m_resume);
+			}
+
+			if (resume)
+				resume();
+		}
+
+		// true, if the answer is already there; otherwise, resume is called by done()
+		bool wait(const resume_t& resume)
+		{
+			std::lock_guard<std::mutex> lock(m_guard);
+			if (m_done)
+				return true;
+
+			m_resume = resume;
+			return false;
+		}
+
+	private:
+		std::mutex m_guard;
+		bool m_done;
+		resume_t m_resume;
+	};
+	typedef std::shared_ptr<pending_answer> pending_answer_ptr;
+
+	// a string, which is already escaped for the SOAP response, like DIDL-Lite in Result;
+	// the rest of it may come from a generator, called only while the response is sent
+	struct xml_escaped : std::string
+	{
+		typedef http::chunked_content::generator_t generator_t;
+		generator_t m_generator;
+		pending_answer_ptr m_pending;
+
+		xml_escaped() : std::string() {}
+		explicit xml_escaped(std::string && v) : std::string(std::move(v)) {}
+		explicit xml_escaped(const std::string & v) : std::string(v) {}
+		xml_escaped& operator=(std::string && v)
+		{
+			std::string::operator=(std::move(v));
+			return *this;
+		}
+
+		void stream(const generator_t& generator) { m_generator = generator; }
+		void defer(const pending_answer_ptr& pending) { m_pending = pending; }
+		void clear()
+		{
+			std::string::clear();
+			m_generator = nullptr;
+			m_pending = nullptr;
+		}
+	};
+
+	template <typename T>
+	inline pending_answer_ptr pending_of(const T&) { return nullptr; }
+	inline pending_answer_ptr pending_of(const xml_escaped& value) { return value.m_pending; }
+
+	// the target of the generated writers: text, with generated parts spliced in
+	struct soap_output : std::string
+	{
+		std::shared_ptr<http::chunked_content> m_chunks;
+
+		void stream(const xml_escaped::generator_t& generator)
+		{
+			if (!m_chunks)
+				m_chunks = std::make_shared<http::chunked_content>();
+			m_chunks->append(std::move(static_cast<std::string&>(*this)));
+			std::string::clear();
+			m_chunks->append(generator);
+		}
+
+		http::content_ptr finish()
+		{
+			if (!m_chunks)
+				return http::content::from_string(std::move(static_cast<std::string&>(*this)));
+
+			m_chunks->append(std::move(static_cast<std::string&>(*this)));
+			std::string::clear();
+			return m_chunks;
+		}
+	};
+
 	template <>
 	struct type_info<uri> {
 		static uri unknown_value() { return uri(); }
@@ -61,6 +163,11 @@ namespace net { namespace ssdp { namespace import {
 		{
 			return uri(rhs);
 		};
+
+		static void write(std::string& out, const uri& rhs)
+		{
+			xmlencode(out, rhs);
+		}
 		static void get_config(std::ostream& o) { o << "			<dataType>uri</dataType>\n"; }
 	};
 
@@ -77,6 +184,11 @@ namespace net { namespace ssdp { namespace import {
 		{
 			return base64(rhs);
 		};
+
+		static void write(std::string& out, const base64& rhs)
+		{
+			out.append(rhs);
+		}
 		static void get_config(std::ostream& o) { o << "			<dataType>bin.base64</dataType>\n"; }
 	};
 
@@ -93,6 +205,43 @@ namespace net { namespace ssdp { namespace import {
 		{
 			return std::string(rhs);
 		};
+
+		static void write(std::string& out, const std::string& rhs)
+		{
+			xmlencode(out, rhs);
+		}
+		static void get_config(std::ostream& o) { o << "			<dataType>string</dataType>\n"; }
+	};
+
+	template <>
+	struct type_info<xml_escaped> {
+		static xml_escaped unknown_value() { return xml_escaped(); }
+
+		static std::string to_string(const xml_escaped& rhs)
+		{
+			return rhs;
+		};
+
+		static xml_escaped from_string(const std::string& rhs)
+		{
+			return xml_escaped(rhs);
+		};
+
+		static void write(std::string& out, const xml_escaped& rhs)
+		{
+			out.append(rhs);
+			if (rhs.m_generator)
+			{
+				auto generator = rhs.m_generator;
+				while (generator(out)) {}
+			}
+		}
+		static void write(soap_output& out, const xml_escaped& rhs)
+		{
+			out.append(rhs);
+			if (rhs.m_generator)
+				out.stream(rhs.m_generator);
+		}
 		static void get_config(std::ostream& o) { o << "			<dataType>string</dataType>\n"; }
 	};
 
@@ -107,11 +256,28 @@ namespace net { namespace ssdp { namespace import {
 
 		static T from_string(const std::string& rhs)
 		{
-			std::istringstream i(rhs);
-			T val;
-			i >> val;
-			return val;
+			return (T) std::strtoll(rhs.c_str(), nullptr, 10);
 		};
+
+		static void write(std::string& out, T rhs)
+		{
+			typedef typename std::make_unsigned<T>::type unsigned_t;
+
+			char buffer[24];
+			char* ptr = buffer + sizeof(buffer);
+			bool negative = rhs < 0;
+			unsigned_t val = negative ? unsigned_t(0) - unsigned_t(rhs) : unsigned_t(rhs);
+			do
+			{
+				*--ptr = '0' + (val % 10);
+				val /= 10;
+			} while (val);
+
+			if (negative)
+				*--ptr = '-';
+
+			out.append(ptr, buffer + sizeof(buffer));
+		}
 	};
 
 	template <>
@@ -126,18 +292,23 @@ namespace net { namespace ssdp { namespace import {
 		static void get_config(std::ostream& o) { o << "			<dataType>ui4</dataType>\n"; }
 	};
 
+	// macros, so the ssvc writers can glue them with per-action literals
+#define SOAP_BODY_START \
+	R"(<?xml version="1.0" encoding="utf-8"?>)" "\n" \
+	R"(<s:Envelope xmlns:s="http://schemas.xmlsoap.org/soap/envelope/" s:encodingStyle="http://schemas.xmlsoap.org/soap/encoding/">)" "\n" \
+	R"(<s:Body>)" "\n"
+#define SOAP_BODY_STOP "\n</s:Body>\n</s:Envelope>\n"
+
 	struct SOAP
 	{
 		static const char* BODY_START()
 		{
-			return R"(<?xml version="1.0" encoding="utf-8"?>)" "\n"
-				R"(<s:Envelope xmlns:s="http://schemas.xmlsoap.org/soap/envelope/" s:encodingStyle="http://schemas.xmlsoap.org/soap/encoding/">)" "\n"
-				R"(<s:Body>)" "\n";
+			return SOAP_BODY_START;
 		}
 
-		static char* BODY_STOP()
+		static const char* BODY_STOP()
 		{
-			return "\n</s:Body>\n</s:Envelope>\n";
+			return SOAP_BODY_STOP;
 		}
 
 		static void soap_answer(const char* method, const char* service_urn, http::response& response, const std::string& body, const http::module_version& server)
@@ -156,6 +327,20 @@ namespace net { namespace ssdp { namespace import {
 			response.content(http::content::from_string(o.str()));
 		}
 
+		// the body is a complete envelope, already built by a generated writer
+		static void soap_answer(http::response& response, soap_output& body, const http::module_version& server)
+		{
+			soap_answer(response, body.finish(), server);
+		}
+
+		static void soap_answer(http::response& response, const http::content_ptr& body, const http::module_version& server)
+		{
+			auto & header = response.header();
+			header.clear(server);
+			header.append("content-type", "text/xml; charset=\"utf-8\"");
+			response.content(body);
+		}
+
 		static void quick404(http::response& response)
 		{
 			auto & header = response.header();
@@ -224,7 +409,7 @@ namespace net { namespace ssdp { namespace import {
 		virtual ~method_base() {}
 
 		virtual const std::string& name() const = 0;
-		virtual bool call(proxy_t* self, const client_info_ptr& info, const http::http_request& req, const dom::XmlDocumentPtr& doc, http::response& response, const http::module_version& server) = 0;
+		virtual bool call(proxy_t* self, const client_info_ptr& info, const http::http_request& req, http::response& response, const http::module_version& server) = 0;
 		virtual void get_config(std::ostream& o) = 0;
 	};
 
@@ -235,16 +420,20 @@ namespace net { namespace ssdp { namespace import {
 		typedef Response response_t;
 		typedef Request request_t;
 		typedef error_code(proxy_t::* method_t)(const client_info_ptr&, const http::http_request&, const request_t&, response_t&);
+		typedef void(*writer_t)(soap_output& out, const response_t& src);
 
 		struct accessor_base
 		{
 			virtual ~accessor_base() {};
 
-			virtual void load(const dom::XmlNodePtr& src, request_t& dst) = 0;
+			virtual const std::string& name() const = 0;
+			virtual void reset(request_t& dst) = 0;
+			virtual void load(const std::string& value, request_t& dst) = 0;
 			virtual void clean(response_t& dst) = 0;
 			virtual void store(const response_t& src, std::ostream& out) = 0;
 			virtual void get_config(std::ostream& o) = 0;
 			virtual void debug(const response_t& src, std::ostream& o) = 0;
+			virtual pending_answer_ptr pending(const response_t& src) = 0;
 
 			void get_config(std::ostream& o, const char* name, const char* dir, const char* ref)
 			{
@@ -269,21 +458,23 @@ namespace net { namespace ssdp { namespace import {
 			variable_t& m_ref;
 			accessor_load(const std::string& name, variable_t& ref, ptr_t field) : m_name(name), m_ref(ref), m_field(field) {}
 
+			const std::string& name() const override { return m_name; }
 			void clean(response_t& /*dst*/) override {}
 			void store(const response_t& /*src*/, std::ostream& /*out*/) override {}
-			void load(const dom::XmlNodePtr& src, request_t& dst) override
+			void reset(request_t& dst) override
 			{
-				auto node = src->find(m_name);
-				if (!node)
-					dst.*m_field = type_info<field_t>::unknown_value();
-				else
-					dst.*m_field = type_info<field_t>::from_string(node->stringValue());
+				dst.*m_field = type_info<field_t>::unknown_value();
+			}
+			void load(const std::string& value, request_t& dst) override
+			{
+				dst.*m_field = type_info<field_t>::from_string(value);
 			}
 			void get_config(std::ostream& o) override
 			{
 				accessor_base::get_config(o, m_name.c_str(), "in", m_ref.m_name.c_str());
 			}
 			void debug(const response_t& /*src*/, std::ostream& /*o*/) override {}
+			pending_answer_ptr pending(const response_t& /*src*/) override { return nullptr; }
 		};
 
 		template <typename T>
@@ -298,14 +489,18 @@ namespace net { namespace ssdp { namespace import {
 			variable_t& m_ref;
 			accessor_store(const std::string& name, variable_t& ref, ptr_t field) : m_name(name), m_ref(ref), m_field(field) {}
 
-			void load(const dom::XmlNodePtr& /*src*/, request_t& /*dst*/) override {}
+			const std::string& name() const override { return m_name; }
+			void reset(request_t& /*dst*/) override {}
+			void load(const std::string& /*value*/, request_t& /*dst*/) override {}
 			void clean(response_t& dst) override
 			{
 				dst.*m_field = type_info<field_t>::unknown_value();
 			}
 			void store(const response_t& src, std::ostream& out) override
 			{
-				out << "<" << m_name << ">" << xmlencode(type_info<field_t>::to_string(src.*m_field)) << "</" << m_name << ">";
+				std::string value;
+				type_info<field_t>::write(value, src.*m_field);
+				out << "<" << m_name << ">" << value << "</" << m_name << ">";
 			}
 			void get_config(std::ostream& o) override
 			{
@@ -315,20 +510,40 @@ namespace net { namespace ssdp { namespace import {
 			{
 				out << m_name << ": " << type_info<field_t>::to_string(src.*m_field) << "\n";
 			}
+			pending_answer_ptr pending(const response_t& src) override
+			{
+				return pending_of(src.*m_field);
+			}
 		};
 
 		typedef std::shared_ptr<accessor_base> accessor_ptr;
 
+		struct request_loader : soap::argument_sink
+		{
+			method_info& m_method;
+			request_t&   m_dst;
+			request_loader(method_info& method, request_t& dst) : m_method(method), m_dst(dst) {}
+
+			void argument(const char* name, const std::string& value) override
+			{
+				m_method.load(name, value, m_dst);
+			}
+		};
+
 		std::string m_name;
 		method_t m_method;
+		writer_t m_writer;
 		std::vector<accessor_ptr> m_accessors;
+		std::vector<accessor_ptr> m_inputs;
 
-		method_info(const std::string& name, method_t method) : m_name(name), m_method(method) {}
+		method_info(const std::string& name, method_t method) : m_name(name), m_method(method), m_writer(nullptr) {}
 
 		template <typename Field>
 		method_info& input(const std::string& name, variable<Field>& ref, Field request_t::* field)
 		{
-			m_accessors.push_back(std::make_shared<accessor_load<Field>>(name, ref, field));
+			auto accessor = std::make_shared<accessor_load<Field>>(name, ref, field);
+			m_accessors.push_back(accessor);
+			m_inputs.push_back(accessor);
 			return *this;
 		}
 
@@ -339,10 +554,25 @@ namespace net { namespace ssdp { namespace import {
 			return *this;
 		}
 
-		void load(const dom::XmlNodePtr& src, request_t& dst)
+		method_info& writer(writer_t writer)
+		{
+			m_writer = writer;
+			return *this;
+		}
+
+		void reset(request_t& dst)
+		{
+			for (auto&& accessor : m_inputs)
+				accessor->reset(dst);
+		}
+
+		void load(const char* name, const std::string& value, request_t& dst)
 		{
-			for (auto&& accessor : m_accessors)
-				accessor->load(src, dst);
+			for (auto&& accessor : m_inputs)
+			{
+				if (accessor->name() == name)
+					return accessor->load(value, dst);
+			}
 		}
 
 		void clean(response_t& dst)
@@ -363,31 +593,80 @@ namespace net { namespace ssdp { namespace import {
 				accessor->debug(src, out);
 		}
 
+		pending_answer_ptr pending(const response_t& src)
+		{
+			for (auto && accessor : m_accessors)
+			{
+				auto ptr = accessor->pending(src);
+				if (ptr)
+					return ptr;
+			}
+			return nullptr;
+		}
+
+		http::content_ptr answer(response_t& call_resp)
+		{
+#ifdef LOG_DEBUG
+			{
+				log::debug dbg;
+				debug(call_resp, dbg);
+			}
+#endif
+			soap_output body;
+			m_writer(body, call_resp);
+			return body.finish();
+		}
+
 		const std::string& name() const override { return m_name; }
 
-		bool call(proxy_t* self, const client_info_ptr& info, const http::http_request& req, const dom::XmlDocumentPtr& doc, http::response& response, const http::module_version& server) override
+		bool call(proxy_t* self, const client_info_ptr& info, const http::http_request& req, http::response& response, const http::module_version& server) override
 		{
 			request_t call_req;
-			response_t call_resp;
+			// outlives the call, if the action answers later
+			auto call_resp = std::make_shared<response_t>();
 
 			error_code result = error::cannot_process_the_request;
 
-			dom::NSData ns [] = { { "s", "http://schemas.xmlsoap.org/soap/envelope/" }, { "upnp", self->get_type() } };
-			auto elem = doc->find("/s:Envelope/s:Body/upnp:" + m_name, ns);
-			if (elem)
+			reset(call_req);
+			request_loader loader(*this, call_req);
+			if (soap::decode(req.request_data(), self->get_type(), m_name, loader) == soap::decode_result::ok)
 			{
-				clean(call_resp);
-				load(elem, call_req);
-				result = (self->*m_method)(info, req, call_req, call_resp);
+				clean(*call_resp);
+				result = (self->*m_method)(info, req, call_req, *call_resp);
 				if (result == error::no_error)
 				{
-					std::ostringstream out;
-					store(call_resp, out);
+					auto pending = m_writer ? this->pending(*call_resp) : nullptr;
+					if (pending)
 					{
-						log::debug dbg;
-						debug(call_resp, dbg);
+						auto body = std::make_shared<http::deferred_content>();
+						bool ready = pending->wait([this, call_resp, body]
+						{
+							body->resolve(answer(*call_resp));
+						});
+
+						if (!ready)
+						{
+							SOAP::soap_answer(response, body, server);
+							return true;
+						}
+					}
+
+					if (m_writer)
+					{
+						SOAP::soap_answer(response, answer(*call_resp), server);
+					}
+					else
+					{
+#ifdef LOG_DEBUG
+						{
+							log::debug dbg;
+							debug(*call_resp, dbg);
+						}
+#endif
+						std::ostringstream out;
+						store(*call_resp, out);
+						SOAP::soap_answer(m_name.c_str(), self->get_type(), response, out.str(), server);
 					}
-					SOAP::soap_answer(m_name.c_str(), self->get_type(), response, out.str(), server);
 				}
 				else if (result == error::not_implemented)
 				{
@@ -431,16 +710,23 @@ namespace net { namespace ssdp { namespace import {
 		methods_t m_methods;
 		variables_t m_variables;
 
-		bool answer(const std::string& name, const client_info_ptr& info, const http::http_request& req, const dom::XmlDocumentPtr& doc, http::response& response, const http::module_version& server) override
+		bool answer(const std::string& name, const client_info_ptr& info, const http::http_request& req, http::response& response, const http::module_version& server) override
 		{
 			for (auto&& method: m_methods)
 			{
 				if (method->name() == name)
-					return method->call(static_cast<Proxy*>(this), info, req, doc, response, server);
+					return method->call(static_cast<Proxy*>(this), info, req, response, server);
 			}
 
 			return false;
 		}
+
+		// used by the ssvc-generated answer(), which knows the method order
+		bool call_method(size_t id, const client_info_ptr& info, const http::http_request& req, http::response& response, const http::module_version& server)
+		{
+			return m_methods[id]->call(static_cast<Proxy*>(this), info, req, response, server);
+		}
+
 		template <typename Request, typename Response>
 		method_info<Proxy, Request, Response>& add_method(const std::string& name, error_code (Proxy::* method)(const client_info_ptr&, const http::http_request&, const Request&, Response&))
 		{
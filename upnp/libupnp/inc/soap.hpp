@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef __SSDP_SOAP_HPP__
+#define __SSDP_SOAP_HPP__
+
+#include <string>
+#include <http/http.hpp>
+
+namespace net
+{
+	namespace ssdp
+	{
+		namespace soap
+		{
+			/*
+			 * Receives the arguments of a SOAP action as soon as the closing
+			 * tag of each argument is seen. The name is the local name of the
+			 * argument element, the value is its concatenated text.
+			 */
+			struct argument_sink
+			{
+				virtual ~argument_sink() {}
+				virtual void argument(const char* name, const std::string& value) = 0;
+			};
+
+			enum class decode_result
+			{
+				ok,
+				no_action,
+				malformed
+			};
+
+			/*
+			 * Streams the request body through expat, looking for
+			 * /s:Envelope/s:Body/{service_type}action and reporting its
+			 * arguments; reading stops right after the action's closing tag.
+			 */
+			decode_result decode(const http::request_data_ptr& data, const char* service_type, const std::string& action, argument_sink& sink);
+		}
+	}
+}
+
+#endif // __SSDP_SOAP_HPP__
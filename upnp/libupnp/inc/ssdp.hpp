@@ -76,6 +76,7 @@ namespace net
 			ticker(boost::asio::io_service& io_service, const device_ptr& device, long seconds, const config::config_ptr& config);
 			void start();
 			void stop();
+			void rebind(const boost::asio::ip::address_v4& local);
 		private:
 			device_ptr                  m_device;
 			boost::asio::io_service&    m_service;
@@ -88,6 +89,7 @@ namespace net
 
 			void notify(notification_type nts) const;
 			void stillAlive();
+			void schedule();
 		};
 
 		struct receiver
@@ -95,6 +97,7 @@ namespace net
 			receiver(boost::asio::io_service& io_service, const device_ptr& device, const config::config_ptr& config);
 			void start();
 			void stop();
+			void rebind(const boost::asio::ip::address_v4& local);
 		private:
 			udp::multicast_receiver m_impl;
 
@@ -116,10 +119,12 @@ namespace net
 		struct server
 		{
 			server(boost::asio::io_service& service, const device_ptr& device, const config::config_ptr& config)
-				: m_handler(std::make_shared<http::http_handler>(device, config))
+				: m_handler(std::make_shared<http::http_handler>(service, device, config))
 				, m_http(service, m_handler, config)
 				, m_alive_ticker(service, device, INTERVAL, config)
 				, m_listener(service, device, config)
+				, m_monitor(iface::create_monitor(service))
+				, m_config(config)
 			{
 			}
 
@@ -128,22 +133,29 @@ namespace net
 				m_http.start();
 				m_alive_ticker.start();
 				m_listener.start();
+				m_monitor->start([this] { interface_changed(); });
 			}
 
 			void stop()
 			{
+				m_monitor->stop();
 				m_listener.stop();
 				m_alive_ticker.stop();
 				m_http.stop();
+				m_handler->stop();
 			}
 
 		private:
-			typedef http::request_handler_ptr handler_ptr;
+			typedef std::shared_ptr<http::http_handler> handler_ptr;
 
-			handler_ptr   m_handler;
-			http::server  m_http;
-			ticker        m_alive_ticker;
-			receiver      m_listener;
+			handler_ptr        m_handler;
+			http::server       m_http;
+			ticker             m_alive_ticker;
+			receiver           m_listener;
+			iface::monitor_ptr m_monitor;
+			config::config_ptr m_config;
+
+			void interface_changed();
 		};
 	}
 }
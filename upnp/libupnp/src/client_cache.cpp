@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <client_cache.hpp>
+#include <algorithm>
+
+namespace net
+{
+	namespace ssdp
+	{
+		namespace
+		{
+			// FNV-1a, 64 bit
+			const client_cache::fingerprint_t FNV_OFFSET = 14695981039346656037ULL;
+			const client_cache::fingerprint_t FNV_PRIME = 1099511628211ULL;
+
+			inline void fnv(client_cache::fingerprint_t& hash, const char* data, size_t length)
+			{
+				for (size_t i = 0; i < length; ++i)
+				{
+					hash ^= (unsigned char) data[i];
+					hash *= FNV_PRIME;
+				}
+			}
+
+			inline void fnv(client_cache::fingerprint_t& hash, const std::string& s)
+			{
+				fnv(hash, s.c_str(), s.length());
+				// separator, so "ab" + "c" is not "a" + "bc"
+				hash ^= 0xFF;
+				hash *= FNV_PRIME;
+			}
+		}
+
+		client_cache::client_cache(size_t capacity)
+			: m_shard_capacity((capacity + SHARD_COUNT - 1) / SHARD_COUNT)
+			, m_hits(0)
+			, m_misses(0)
+		{
+			if (!m_shard_capacity)
+				m_shard_capacity = 1;
+			m_headers.push_back("user-agent");
+		}
+
+		void client_cache::set_headers(const std::vector<std::string>& headers)
+		{
+			m_headers.clear();
+			m_headers.push_back("user-agent");
+			for (auto&& header : headers)
+			{
+				if (header.empty())
+					continue;
+
+				std::string name = header;
+				for (auto&& c : name) c = (char) std::tolower((unsigned char) c);
+
+				if (std::find(m_headers.begin(), m_headers.end(), name) == m_headers.end())
+					m_headers.push_back(name);
+			}
+		}
+
+		client_cache::fingerprint_t client_cache::fingerprint(const http::http_request& req) const
+		{
+			fingerprint_t hash = FNV_OFFSET;
+			for (auto&& name : m_headers)
+			{
+				auto it = req.find(name);
+				if (it == req.end())
+					fnv(hash, nullptr, 0);
+				else
+					fnv(hash, it->value());
+				hash ^= 0xFE;
+				hash *= FNV_PRIME;
+			}
+			return hash;
+		}
+
+		size_t client_cache::key_hash::operator()(const key& k) const
+		{
+			fingerprint_t hash = k.m_fingerprint;
+			if (k.m_address.is_v4())
+			{
+				auto bytes = k.m_address.to_v4().to_bytes();
+				fnv(hash, (const char*) bytes.data(), bytes.size());
+			}
+			else
+			{
+				auto bytes = k.m_address.to_v6().to_bytes();
+				fnv(hash, (const char*) bytes.data(), bytes.size());
+			}
+			return (size_t) (hash ^ (hash >> 32));
+		}
+
+		client_cache::shard& client_cache::shard_for(const key& k)
+		{
+			return m_shards[key_hash()(k) % SHARD_COUNT];
+		}
+
+		client_info_ptr client_cache::find(const boost::asio::ip::address& address, fingerprint_t fingerprint)
+		{
+			key k { address, fingerprint };
+			auto& s = shard_for(k);
+
+			std::lock_guard<std::mutex> lock(s.m_guard);
+			auto it = s.m_index.find(k);
+			if (it == s.m_index.end())
+			{
+				++m_misses;
+				return nullptr;
+			}
+
+			++m_hits;
+			s.m_lru.splice(s.m_lru.begin(), s.m_lru, it->second);
+			return it->second->second;
+		}
+
+		void client_cache::insert(const boost::asio::ip::address& address, fingerprint_t fingerprint, const client_info_ptr& client)
+		{
+			key k { address, fingerprint };
+			auto& s = shard_for(k);
+
+			std::lock_guard<std::mutex> lock(s.m_guard);
+			auto it = s.m_index.find(k);
+			if (it != s.m_index.end())
+			{
+				it->second->second = client;
+				s.m_lru.splice(s.m_lru.begin(), s.m_lru, it->second);
+				return;
+			}
+
+			s.m_lru.emplace_front(k, client);
+			s.m_index[k] = s.m_lru.begin();
+
+			while (s.m_lru.size() > m_shard_capacity)
+			{
+				s.m_index.erase(s.m_lru.back().first);
+				s.m_lru.pop_back();
+			}
+		}
+
+		void client_cache::clear()
+		{
+			for (auto&& s : m_shards)
+			{
+				std::lock_guard<std::mutex> lock(s.m_guard);
+				s.m_index.clear();
+				s.m_lru.clear();
+			}
+		}
+	}
+}
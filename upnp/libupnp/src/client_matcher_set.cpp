@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <client_matcher_set.hpp>
+#include <cctype>
+#include <cstring>
+#include <deque>
+
+namespace net
+{
+	namespace ssdp
+	{
+		namespace
+		{
+			const size_t NONE = (size_t) -1;
+
+			// index one past the bracket/parenthesis closing the one at "pos"
+			size_t skip_group(const std::string& pattern, size_t pos)
+			{
+				int depth = 0;
+				bool in_class = false;
+				for (auto i = pos; i < pattern.length(); ++i)
+				{
+					auto c = pattern[i];
+					if (c == '\\') { ++i; continue; }
+					if (in_class)
+					{
+						if (c == ']')
+						{
+							in_class = false;
+							if (!depth)
+								return i + 1;
+						}
+						continue;
+					}
+					if (c == '[') in_class = true;
+					else if (c == '(') ++depth;
+					else if (c == ')' && !--depth)
+						return i + 1;
+				}
+				return pattern.length();
+			}
+
+			bool is_quantifier(char c) { return c == '?' || c == '*' || c == '+' || c == '{'; }
+		}
+
+		bool client_matcher_set::required_literals(const std::string& pattern, std::vector<std::string>& out)
+		{
+			std::vector<std::string> alternatives;
+			size_t start = 0;
+			for (size_t i = 0; i < pattern.length(); ++i)
+			{
+				auto c = pattern[i];
+				if (c == '\\') { ++i; continue; }
+				if (c == '(' || c == '[') { i = skip_group(pattern, i) - 1; continue; }
+				if (c == '|')
+				{
+					alternatives.push_back(pattern.substr(start, i - start));
+					start = i + 1;
+				}
+			}
+			alternatives.push_back(pattern.substr(start));
+
+			for (auto&& alt : alternatives)
+			{
+				// "(...)" spanning the whole alternative: look inside
+				if (!alt.empty() && alt[0] == '(' && skip_group(alt, 0) == alt.length())
+				{
+					auto inner = alt.substr(1, alt.length() - 2);
+					if (inner.compare(0, 2, "?:") == 0)
+						inner = inner.substr(2);
+					else if (!inner.empty() && inner[0] == '?')
+						return false; // a look-ahead does not consume anything
+
+					if (!required_literals(inner, out))
+						return false;
+					continue;
+				}
+
+				std::string best, current;
+				auto end_run = [&]
+				{
+					if (current.length() > best.length())
+						best = current;
+					current.clear();
+				};
+
+				size_t i = 0;
+				while (i < alt.length())
+				{
+					auto c = alt[i];
+					char literal = 0;
+					size_t next = i + 1;
+
+					if (c == '\\' && next < alt.length())
+					{
+						auto escaped = alt[next++];
+						if (!std::isalnum((unsigned char) escaped))
+							literal = escaped;
+					}
+					else if (c == '(' || c == '[')
+						next = skip_group(alt, i);
+					else if (!std::strchr(".^$|)?*+{", c))
+						literal = c;
+
+					bool optional = false;
+					if (next < alt.length() && is_quantifier(alt[next]))
+					{
+						optional = alt[next] != '+';
+						if (alt[next] == '{')
+							next = alt.find('}', next);
+						next = next == std::string::npos ? alt.length() : next + 1;
+						if (next < alt.length() && alt[next] == '?') // lazy
+							++next;
+					}
+
+					if (literal && !optional)
+						current.push_back(literal);
+					if (!literal || next != i + 1 + (c == '\\' ? 1 : 0))
+						end_run(); // anything but a plain literal breaks the run
+
+					i = next;
+				}
+				end_run();
+
+				if (best.empty())
+					return false;
+				out.push_back(best);
+			}
+
+			return true;
+		}
+
+		size_t client_matcher_set::add(const client_matcher& matcher)
+		{
+			m_matchers.push_back(matcher);
+
+			std::vector<std::string> literals;
+			bool always = false;
+			auto& ua = matcher.user_agent();
+			if (!ua.empty() && !required_literals(ua, literals))
+			{
+				literals.clear();
+				always = true;
+			}
+			m_literals.push_back(literals);
+			m_always.push_back(always);
+
+			compile();
+			return m_matchers.size() - 1;
+		}
+
+		void client_matcher_set::compile()
+		{
+			memset(m_class, 0, sizeof(m_class));
+			m_classes = 1;
+			for (auto&& literals : m_literals)
+				for (auto&& literal : literals)
+					for (auto c : literal)
+					{
+						auto& cls = m_class[(unsigned char) c];
+						if (!cls)
+							cls = (unsigned char) m_classes++;
+					}
+
+			m_states.clear();
+			m_states.push_back({ 0 });
+			m_delta.assign(m_classes, NONE);
+
+			for (size_t id = 0; id < m_literals.size(); ++id)
+			{
+				for (auto&& literal : m_literals[id])
+				{
+					size_t s = 0;
+					for (auto c : literal)
+					{
+						auto& next = m_delta[s * m_classes + m_class[(unsigned char) c]];
+						if (next == NONE)
+						{
+							next = m_states.size();
+							m_states.push_back({ 0 });
+							m_delta.resize(m_delta.size() + m_classes, NONE);
+						}
+						s = m_delta[s * m_classes + m_class[(unsigned char) c]];
+					}
+					m_states[s].m_output.push_back(id);
+				}
+			}
+
+			// breadth-first: fail links, then turn the trie into a full transition table
+			std::deque<size_t> queue;
+			for (size_t c = 0; c < m_classes; ++c)
+			{
+				auto& next = m_delta[c];
+				if (next == NONE)
+					next = 0;
+				else
+				{
+					m_states[next].m_fail = 0;
+					queue.push_back(next);
+				}
+			}
+
+			while (!queue.empty())
+			{
+				auto s = queue.front();
+				queue.pop_front();
+
+				auto fail = m_states[s].m_fail;
+				for (size_t c = 0; c < m_classes; ++c)
+				{
+					auto& next = m_delta[s * m_classes + c];
+					if (next == NONE)
+					{
+						next = m_delta[fail * m_classes + c];
+						continue;
+					}
+
+					auto target = m_delta[fail * m_classes + c];
+					m_states[next].m_fail = target;
+					auto& inherited = m_states[target].m_output;
+					m_states[next].m_output.insert(m_states[next].m_output.end(), inherited.begin(), inherited.end());
+					queue.push_back(next);
+				}
+			}
+		}
+
+		size_t client_matcher_set::find(const http::http_request& request) const
+		{
+			if (m_matchers.empty())
+				return npos;
+
+			std::vector<bool> candidate(m_always);
+
+			auto ua = request.find("user-agent");
+			if (ua != request.end())
+			{
+				size_t s = 0;
+				for (auto c : ua->value())
+				{
+					s = m_delta[s * m_classes + m_class[(unsigned char) c]];
+					for (auto id : m_states[s].m_output)
+						candidate[id] = true;
+				}
+			}
+
+			for (size_t id = 0; id < m_matchers.size(); ++id)
+			{
+				auto& matcher = m_matchers[id];
+				if (!candidate[id])
+				{
+					auto& header = matcher.other_header();
+					if (header.empty() || request.find(header) == request.end())
+						continue;
+				}
+
+				if (matcher.matches(request))
+					return id;
+			}
+
+			return npos;
+		}
+	}
+}
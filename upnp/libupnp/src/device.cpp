@@ -36,17 +36,14 @@ namespace net
 
 		bool client_matcher::matches(const http::http_request& request) const
 		{
-			log::debug log;
-			log << "[MATCHING] [" << m_ua_string << "]";
 			if (!m_ua_string.empty())
 			{
-				auto header = request.user_agent();
-				if (std::regex_search(header, m_user_agent))
+				auto it = request.find("user-agent");
+				static const std::string empty;
+				if (std::regex_search(it == request.end() ? empty : it->value(), m_user_agent))
 					return true;
 			}
 
-			log << " or [" << m_other_header << ": " << m_hm_string << "] ";
-
 			if (!m_other_header.empty())
 			{
 				auto it = request.find(m_other_header);
@@ -55,7 +52,6 @@ namespace net
 				if (m_hm_string.empty())
 					return true;
 
-				log << it->value();
 				if (std::regex_search(it->value(), m_header_match))
 					return true;
 			}
@@ -0,0 +1,469 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <gena.hpp>
+#include <http/http.hpp>
+#include <utils.hpp>
+#include <log.hpp>
+#include <array>
+#include <sstream>
+
+namespace net
+{
+	namespace ssdp
+	{
+		namespace gena
+		{
+			struct log : public Log::basic_log<log>
+			{
+				static const Log::Module& module() { return Log::Module::UPnP; }
+			};
+
+			typedef boost::posix_time::ptime ptime;
+			typedef boost::asio::ip::tcp tcp;
+
+			struct callback_url
+			{
+				tcp::endpoint m_endpoint;
+				std::string   m_host;
+				std::string   m_path;
+			};
+
+			namespace
+			{
+				inline ptime now() { return boost::posix_time::microsec_clock::universal_time(); }
+				inline boost::posix_time::milliseconds ms(long value) { return boost::posix_time::milliseconds(value); }
+
+				bool parse_url(const std::string& url, callback_url& out)
+				{
+					static const char prefix [] = "http://";
+					static const size_t prefix_len = sizeof(prefix) - 1;
+					if (url.compare(0, prefix_len, prefix) != 0)
+						return false;
+
+					auto path = url.find('/', prefix_len);
+					out.m_host = url.substr(prefix_len, path == std::string::npos ? std::string::npos : path - prefix_len);
+					out.m_path = path == std::string::npos ? "/" : url.substr(path);
+
+					auto host = out.m_host;
+					net::ushort port = 80;
+					auto colon = host.rfind(':');
+					if (colon != std::string::npos)
+					{
+						port = (net::ushort) atoi(host.c_str() + colon + 1);
+						host = host.substr(0, colon);
+					}
+
+					// renderers send numeric addresses; there is no resolver round-trip here
+					boost::system::error_code ec;
+					auto address = boost::asio::ip::address::from_string(host, ec);
+					if (ec || !port)
+						return false;
+
+					out.m_endpoint = tcp::endpoint(address, port);
+					return true;
+				}
+
+				// CALLBACK: <http://a/b><http://c/d>
+				std::vector<callback_url> parse_callbacks(const std::string& header)
+				{
+					std::vector<callback_url> out;
+					std::string::size_type pos = 0;
+					for (;;)
+					{
+						auto open = header.find('<', pos);
+						if (open == std::string::npos)
+							break;
+						auto close = header.find('>', open);
+						if (close == std::string::npos)
+							break;
+
+						callback_url url;
+						if (parse_url(header.substr(open + 1, close - open - 1), url))
+							out.push_back(url);
+
+						pos = close + 1;
+					}
+					return out;
+				}
+
+				struct delivery : std::enable_shared_from_this<delivery>
+				{
+					typedef std::function<void()> handler_t;
+
+					tcp::socket                 m_socket;
+					boost::asio::deadline_timer m_timeout;
+					std::vector<callback_url>   m_callbacks;
+					size_t                      m_current;
+					std::string                 m_sid;
+					net::ulong                  m_seq;
+					std::string                 m_body;
+					std::string                 m_request;
+					std::array<char, 512>       m_buffer;
+					handler_t                   m_done;
+
+					delivery(boost::asio::io_service& service, const std::vector<callback_url>& callbacks, const std::string& sid, net::ulong seq, std::string&& body)
+						: m_socket(service)
+						, m_timeout(service)
+						, m_callbacks(callbacks)
+						, m_current(0)
+						, m_sid(sid)
+						, m_seq(seq)
+						, m_body(std::move(body))
+					{
+					}
+
+					void start(const handler_t& done)
+					{
+						m_done = done;
+						try_current();
+					}
+
+					void try_current()
+					{
+						if (m_current >= m_callbacks.size())
+						{
+							log::warning() << "Could not deliver event #" << m_seq << " to " << m_sid;
+							return finish();
+						}
+
+						auto& url = m_callbacks[m_current];
+						http::http_request req { "NOTIFY", url.m_path };
+						req.append("host", url.m_host);
+						req.append("content-type", "text/xml; charset=\"utf-8\"");
+						req.append("nt", "upnp:event");
+						req.append("nts", "upnp:propchange");
+						req.append("sid", m_sid);
+						req.append("seq")->out() << m_seq;
+						req.append("content-length")->out() << m_body.length();
+						req.append("connection", "close");
+
+						std::ostringstream os;
+						os << req << m_body;
+						m_request = os.str();
+
+						auto self = shared_from_this();
+						m_timeout.expires_from_now(boost::posix_time::seconds(5));
+						m_timeout.async_wait([self, this](const boost::system::error_code& ec)
+						{
+							if (!ec)
+							{
+								boost::system::error_code ignore;
+								m_socket.close(ignore);
+							}
+						});
+
+						m_socket.async_connect(url.m_endpoint, [self, this](const boost::system::error_code& ec)
+						{
+							if (ec)
+								return next();
+
+							boost::asio::async_write(m_socket, boost::asio::buffer(m_request), [self, this](const boost::system::error_code& ec, std::size_t)
+							{
+								if (ec)
+									return next();
+
+								// the status line is enough; the renderer closes the connection
+								m_socket.async_read_some(boost::asio::buffer(m_buffer), [self, this](const boost::system::error_code&, std::size_t)
+								{
+									finish();
+								});
+							});
+						});
+					}
+
+					void next()
+					{
+						boost::system::error_code ignore;
+						m_socket.close(ignore);
+						m_timeout.cancel();
+						++m_current;
+						try_current();
+					}
+
+					void finish()
+					{
+						boost::system::error_code ignore;
+						m_socket.close(ignore);
+						m_timeout.cancel();
+						if (m_done)
+						{
+							auto done = std::move(m_done);
+							m_done = nullptr;
+							done();
+						}
+					}
+				};
+			}
+
+			struct subscriber
+			{
+				typedef std::map<std::string, std::string> values_t;
+
+				std::string                 m_sid;
+				std::string                 m_service_id;
+				std::vector<callback_url>   m_callbacks;
+				ptime                       m_expires;
+				ptime                       m_last_sent;
+				net::ulong                  m_seq;
+				bool                        m_scheduled;
+				bool                        m_in_flight;
+				values_t                    m_pending;
+				std::map<std::string, values_t> m_lists;
+				boost::asio::deadline_timer m_timer;
+
+				subscriber(boost::asio::io_service& service)
+					: m_last_sent(boost::posix_time::min_date_time)
+					, m_seq(0)
+					, m_scheduled(false)
+					, m_in_flight(false)
+					, m_timer(service)
+				{
+				}
+
+				bool has_pending() const { return !m_pending.empty() || !m_lists.empty(); }
+
+				net::ulong next_seq()
+				{
+					auto seq = m_seq;
+					// after 4294967295 comes 1, not 0
+					m_seq = m_seq == 0xFFFFFFFF ? 1 : m_seq + 1;
+					return seq;
+				}
+
+				std::string take_body()
+				{
+					std::string out =
+						"<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+						"<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\">\n";
+
+					for (auto && prop : m_pending)
+						property(out, prop.first, prop.second);
+
+					for (auto && list : m_lists)
+					{
+						std::string value;
+						for (auto && entry : list.second)
+						{
+							if (!value.empty())
+								value.push_back(',');
+							value.append(entry.first);
+							value.push_back(',');
+							value.append(entry.second);
+						}
+						property(out, list.first, value);
+					}
+
+					out.append("</e:propertyset>\n");
+
+					m_pending.clear();
+					m_lists.clear();
+					return out;
+				}
+
+				static void property(std::string& out, const std::string& name, const std::string& value)
+				{
+					out.append("<e:property><");
+					out.append(name);
+					out.append(">");
+					xmlencode(out, value);
+					out.append("</");
+					out.append(name);
+					out.append("></e:property>\n");
+				}
+			};
+
+			long subscriptions::parse_timeout(const std::string& header)
+			{
+				static const char prefix [] = "Second-";
+				static const size_t prefix_len = sizeof(prefix) - 1;
+
+				if (header.length() <= prefix_len || header.compare(0, prefix_len, prefix) != 0)
+					return DEFAULT_TIMEOUT;
+
+				auto value = atol(header.c_str() + prefix_len);
+				if (value <= 0 || value > DEFAULT_TIMEOUT) // includes "infinite"
+					return DEFAULT_TIMEOUT;
+				if (value < MIN_TIMEOUT)
+					return MIN_TIMEOUT;
+				return value;
+			}
+
+			std::string subscriptions::subscribe(const service_ptr& service, const std::string& callbacks, long& timeout)
+			{
+				auto sub = std::make_shared<subscriber>(m_service);
+				sub->m_callbacks = parse_callbacks(callbacks);
+				if (sub->m_callbacks.empty())
+					return std::string();
+
+				sub->m_sid = "uuid:" + net::create_uuid();
+				sub->m_service_id = service->get_id();
+				sub->m_expires = now() + boost::posix_time::seconds(timeout);
+
+				event_state state;
+				service->get_events(state);
+				for (auto && prop : state)
+					sub->m_pending[prop.first] = prop.second;
+
+				std::lock_guard<std::mutex> lock(m_guard);
+				expire();
+				m_subscribers[sub->m_sid] = sub;
+
+				// the initial event has to go out after the SUBSCRIBE response
+				schedule(sub, INITIAL_EVENT_MS);
+
+				log::info() << "New subscription " << sub->m_sid << " to " << sub->m_service_id;
+				return sub->m_sid;
+			}
+
+			bool subscriptions::renew(const std::string& sid, long& timeout)
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+				expire();
+
+				auto it = m_subscribers.find(sid);
+				if (it == m_subscribers.end())
+					return false;
+
+				it->second->m_expires = now() + boost::posix_time::seconds(timeout);
+				return true;
+			}
+
+			bool subscriptions::unsubscribe(const std::string& sid)
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+				return m_subscribers.erase(sid) > 0;
+			}
+
+			void subscriptions::stop()
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+				m_subscribers.clear();
+			}
+
+			void subscriptions::property_changed(const char* service_id, const std::string& name, const std::string& value)
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+				expire();
+
+				for (auto && pair : m_subscribers)
+				{
+					auto& sub = pair.second;
+					if (sub->m_service_id != service_id)
+						continue;
+
+					sub->m_pending[name] = value;
+					schedule(sub, 0);
+				}
+			}
+
+			void subscriptions::list_changed(const char* service_id, const std::string& name, const std::string& key, const std::string& value)
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+				expire();
+
+				for (auto && pair : m_subscribers)
+				{
+					auto& sub = pair.second;
+					if (sub->m_service_id != service_id)
+						continue;
+
+					sub->m_lists[name][key] = value;
+					schedule(sub, 0);
+				}
+			}
+
+			// m_guard is held
+			void subscriptions::expire()
+			{
+				auto current = now();
+				for (auto it = m_subscribers.begin(); it != m_subscribers.end();)
+				{
+					if (it->second->m_expires < current)
+					{
+						log::info() << "Subscription " << it->first << " expired";
+						it = m_subscribers.erase(it);
+					}
+					else
+						++it;
+				}
+			}
+
+			// m_guard is held
+			void subscriptions::schedule(const subscriber_ptr& sub, long delay_ms)
+			{
+				if (sub->m_scheduled || sub->m_in_flight)
+					return;
+				sub->m_scheduled = true;
+
+				auto due = sub->m_last_sent + ms(MODERATION_MS);
+				auto earliest = now() + ms(delay_ms);
+				if (due < earliest)
+					due = earliest;
+
+				auto self = shared_from_this();
+				m_service.post([self, this, sub, due]
+				{
+					sub->m_timer.expires_at(due);
+					sub->m_timer.async_wait([self, this, sub](const boost::system::error_code& ec)
+					{
+						if (!ec)
+							flush(sub);
+					});
+				});
+			}
+
+			void subscriptions::flush(const subscriber_ptr& sub)
+			{
+				std::string body;
+				net::ulong seq = 0;
+				{
+					std::lock_guard<std::mutex> lock(m_guard);
+					sub->m_scheduled = false;
+
+					if (m_subscribers.find(sub->m_sid) == m_subscribers.end() || !sub->has_pending())
+						return;
+
+					body = sub->take_body();
+					seq = sub->next_seq();
+					sub->m_last_sent = now();
+					sub->m_in_flight = true;
+				}
+
+				auto self = shared_from_this();
+				auto message = std::make_shared<delivery>(m_service, sub->m_callbacks, sub->m_sid, seq, std::move(body));
+				message->start([self, this, sub]
+				{
+					std::lock_guard<std::mutex> lock(m_guard);
+					sub->m_in_flight = false;
+
+					// changes, which came while the NOTIFY was on the wire
+					if (sub->has_pending())
+						schedule(sub, 0);
+				});
+			}
+		}
+	}
+}
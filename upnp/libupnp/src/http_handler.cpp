@@ -27,7 +27,6 @@
 #include <http/response.hpp>
 #include <regex>
 #include <interface.hpp>
-#include <dom.hpp>
 #include <log.hpp>
 
 namespace net
@@ -39,27 +38,6 @@ namespace net
 			static const Log::Module& module() { return Log::Module::HTTP; }
 		};
 
-		dom::XmlDocumentPtr create_from_socket(request_data_ptr data)
-		{
-			if (!data || !data->content_length())
-				return nullptr;
-
-			size_t rest = data->content_length();
-			return dom::XmlDocument::fromDataSource([&](void* buffer, size_t chunk) -> size_t
-			{
-				if (!rest)
-					return 0;
-
-				if (chunk > rest)
-					chunk = rest;
-
-				auto tmp = data->read(buffer, chunk);
-				rest -= tmp;
-
-				return tmp;
-			});
-		}
-
 		struct tmplt_chunk
 		{
 			template_vars::const_iterator m_var;
@@ -168,13 +146,45 @@ namespace net
 			}
 		};
 
-		http_handler::http_handler(const ssdp::device_ptr& device, const config::config_ptr& config)
+		http_handler::http_handler(boost::asio::io_service& service, const ssdp::device_ptr& device, const config::config_ptr& config)
 			: m_device(device)
 			, m_config(config)
+			, m_events(std::make_shared<ssdp::gena::subscriptions>(service))
 		{
 			m_vars.emplace_back("host", to_string(config->iface));
 			m_vars.emplace_back("port", std::to_string(config->port));
 			m_vars.emplace_back("uuid", m_device->usn());
+			m_device->set_event_sink(m_events);
+			m_clients.set_headers(m_device->get_client_headers());
+			build_router();
+		}
+
+		void http_handler::build_router()
+		{
+			m_router.add_path("/config/device.xml", route::device_xml);
+			m_router.add_prefix("/images/", route::images);
+
+			size_t id = 0;
+			for (auto&& service : ssdp::services(m_device))
+			{
+				auto name = "service" + std::to_string(id);
+				m_router.add_path("/config/" + name, route::service_xml, id);
+				m_router.add_path("/upnp/event/" + name, route::event, id);
+				m_router.add_path("/upnp/control/" + name, route::control, id);
+				m_router.add_service(service->get_type(), id);
+				m_services.push_back(service);
+				++id;
+			}
+
+			id = 0;
+			for (auto&& root : m_device->get_http_roots())
+				m_router.add_prefix("/upnp/" + root + "/", route::device_http, id++);
+		}
+
+		void http_handler::stop()
+		{
+			m_device->set_event_sink(nullptr);
+			m_events->stop();
 		}
 
 		struct log_request
@@ -182,16 +192,14 @@ namespace net
 			response& resp;
 			const http_request& header;
 			const std::string& SOAPAction;
-			dom::XmlDocumentPtr doc;
 			ssdp::client_info_ptr _client;
 			bool with_header;
 			bool printed;
 
-			log_request(response& resp, const http_request& header, const std::string& SOAPAction, dom::XmlDocumentPtr& doc)
+			log_request(response& resp, const http_request& header, const std::string& SOAPAction)
 				: resp(resp)
 				, header(header)
 				, SOAPAction(SOAPAction)
-				, doc(doc)
 				, with_header(false)
 				, printed(false)
 			{
@@ -256,42 +264,9 @@ namespace net
 			log_request& operator=(const log_request&);
 		};
 
-		std::pair<fs::path, fs::path> pop(const fs::path& p)
-		{
-			if (p.empty())
-				return std::make_pair(p, p);
-			auto it = p.begin();
-			auto root = *it++;
-			fs::path rest;
-			while (it != p.end())
-				rest /= *it++;
-
-			return std::make_pair(root, rest);
-		}
-
-		std::pair<std::string, std::string> break_action(const std::string& action)
-		{
-			auto hash = action.find('#');
-
-			// no hash - no function; no function - no sense
-			if (hash == std::string::npos)
-				return std::make_pair(std::string(), std::string());
-
-			return std::make_pair(action.substr(0, hash), action.substr(hash + 1));
-		}
-
 		void http_handler::handle(const http_request& req, response& resp)
 		{
-			auto SOAPAction = req.SOAPAction();
-			auto res = req.resource();
-			auto method = req.method();
-
-			dom::XmlDocumentPtr doc;
-
-			if (method == http_method::post && !SOAPAction.empty())
-				doc = create_from_socket(req.request_data());
-
-			//log_request __{ resp, req, SOAPAction, doc };
+			//log_request __{ resp, req, req.SOAPAction() };
 			//__.client(client_from_request(req, false));
 			//__.withHeader().print();
 
@@ -303,88 +278,78 @@ namespace net
 				return;
 			}
 
-			fs::path root, rest;
-			std::tie(root, rest) = pop(res); // pop leading slash
-			std::tie(root, rest) = pop(rest);
+			auto method = req.method();
+			auto match = m_router.find(req.m_resource);
+			auto& target = match.m_target;
 
-			if (method == http_method::get || method == http_method::head)
+			switch (target.m_route)
 			{
-				if (root == "config")
-				{
-					auto client = client_from_request(req, false);
-					if (rest == "device.xml")
-						return make_device_xml(client, resp);
-					else if (rest.string().substr(0, 7) == "service")
-					{
-						auto id = rest.string().substr(7);
-
-						size_t int_id = 0;
-						for (auto&& service: ssdp::services(m_device))
-						{
-							if (id == std::to_string(int_id++))
-								return make_service_xml(client, resp, service);
-						}
-					}
-				}
-				if (root == "images")
-					return make_file(boost::filesystem::path("data") / root / rest, resp);
+			case route::device_xml:
+			case route::service_xml:
+			case route::images:
+			case route::device_http:
+				if (method != http_method::get && method != http_method::head)
+					break;
+
+				if (target.m_route == route::device_xml)
+					return make_device_xml(client_from_request(req, false), resp);
+				if (target.m_route == route::service_xml)
+					return make_service_xml(client_from_request(req, false), resp, m_services[target.m_index]);
+				if (target.m_route == route::images)
+					return make_file(fs::path("data") / "images" / std::string(match.m_rest, match.m_rest_length), resp);
+
+				client_from_request(req);
+				if (m_device->call_http(req, target.m_index, std::string(match.m_rest, match.m_rest_length), resp))
+					return;
+				break;
+
+			case route::event:
+				if (method == http_method::subscribe || method == http_method::unsubscribe)
+					return make_subscription(req, m_services[target.m_index], resp);
+				break;
+
+			case route::control:
+				if (method == http_method::post)
+					return make_control(req, target.m_index, resp);
+				break;
+
+			default:
+				break;
+			}
 
-				if (root == "upnp")
-				{
-					//__.withHeader().print();
+			make_404(resp);
+		}
 
-					auto client = client_from_request(req);
-					std::tie(root, rest) = pop(rest);
-					if (m_device->call_http(req, root, rest, resp))
-						return;
-				}
-			}
+		void http_handler::make_control(const http_request& req, size_t control_id, response& resp)
+		{
+			auto client = client_from_request(req);
+			auto SOAPAction = req.SOAPAction();
 
-			if (method == http_method::post)
+			size_t id = 0;
+			std::string soap_method;
+			if (!m_router.find_action(SOAPAction, id, soap_method))
 			{
-				if (root == "upnp")
-				{
-					auto client = client_from_request(req);
-					std::string soap_type, soap_method;
-					std::tie(soap_type, soap_method) = break_action(SOAPAction);
-
-					ssdp::service_ptr service;
-					size_t int_id = 0;
-					for (auto&& candidate: ssdp::services(m_device))
-					{
-						if (soap_type == candidate->get_type())
-						{
-							service = candidate;
-							break;
-						}
-						++int_id;
-					}
+				log::warning() << "Unknown service requested: " << SOAPAction;
+				return make_404(resp);
+			}
 
-					if (!service)
-					{
-						log::warning() << "Unknown service requested: " << soap_type;
-						return make_404(resp);
-					}
+			// the action must be posted to the control URL of its own service
+			if (id != control_id)
+				return make_404(resp);
 
-					std::tie(root, rest) = pop(rest);
-					if (root == "control")
-					{
-						if (rest == "service" + std::to_string(int_id)) try
-						{
-							resp.header().clear(m_device->server());
-							if (service->answer(soap_method, client, req, doc, resp, m_device->server()))
-								return;
-							log::warning() << "Unimplemented SOAP method called: " << SOAPAction;
-						}
-						catch (std::exception& e)
-						{
-							log::error() << "Exception: " << e.what();
-							return make_500(resp);
-						}
-						catch (...) { return make_500(resp); }
-					}
-				}
+			try
+			{
+				resp.header().clear(m_device->server());
+				if (m_services[id]->answer(soap_method, client, req, resp, m_device->server()))
+					return;
+				log::warning() << "Unimplemented SOAP method called: " << SOAPAction;
+			}
+			catch (std::exception& e)
+			{
+				log::error() << "Exception: " << e.what();
+				return make_500(resp);
 			}
+			catch (...) { return make_500(resp); }
 
 			make_404(resp);
 		}
@@ -448,6 +413,59 @@ namespace net
 			resp.content(content::from_file(path));
 		}
 
+		void http_handler::make_subscription(const http_request& req, const ssdp::service_ptr& service, response& resp)
+		{
+			auto & header = resp.header();
+			header.clear(m_device->server());
+
+			auto sid = req.simple("sid");
+			auto callback = req.simple("callback");
+			auto nt = req.simple("nt");
+
+			// SID together with CALLBACK or NT is a malformed request
+			if (!sid.empty() && (!callback.empty() || !nt.empty()))
+			{
+				header.m_status = 400;
+				return;
+			}
+
+			if (req.method() == http_method::unsubscribe)
+			{
+				if (sid.empty() || !m_events->unsubscribe(sid))
+					header.m_status = 412;
+				return;
+			}
+
+			auto timeout = ssdp::gena::subscriptions::parse_timeout(req.simple("timeout"));
+			if (!sid.empty())
+			{
+				if (!m_events->renew(sid, timeout))
+				{
+					header.m_status = 412;
+					return;
+				}
+			}
+			else
+			{
+				if (nt != "upnp:event")
+				{
+					header.m_status = 412;
+					return;
+				}
+
+				sid = m_events->subscribe(service, callback, timeout);
+				if (sid.empty())
+				{
+					header.m_status = 412;
+					return;
+				}
+			}
+
+			header.append("sid", sid);
+			header.append("timeout")->out() << "Second-" << timeout;
+			header.append("content-length", "0");
+		}
+
 		void http_handler::make_404(response& resp)
 		{
 			auto & header = resp.header();
@@ -466,17 +484,17 @@ namespace net
 
 		ssdp::client_info_ptr http_handler::client_from_request(const http_request& req, bool save)
 		{
-			for (auto&& seen : m_clients_seen)
-			{
-				if (seen.m_address == req.m_remote_address && seen.m_client->matches(req))
-					return seen.m_client;
-			}
+			auto fingerprint = m_clients.fingerprint(req);
+			auto client = m_clients.find(req.m_remote_address, fingerprint);
+			if (client)
+				return client;
 
-			auto client = m_device->match_from_request(req);
+			client = m_device->match_from_request(req);
 			if (client && save)
 			{
-				log::info() << "New client at " << to_string(req.m_remote_address) <<": " << client->get_name();
-				m_clients_seen.emplace_back(req.m_remote_address, client);
+				log::info() << "New client at " << to_string(req.m_remote_address) <<": " << client->get_name()
+					<< " (cache: " << m_clients.hits() << " hits, " << m_clients.misses() << " misses)";
+				m_clients.insert(req.m_remote_address, fingerprint, client);
 				if (!client->from_config())
 				{
 					log::info() << req;
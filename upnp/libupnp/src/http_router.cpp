@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <http_router.hpp>
+#include <cstring>
+
+namespace net
+{
+	namespace http
+	{
+		size_t route_trie::child(size_t n, char c) const
+		{
+			for (auto&& ch : m_nodes[n].m_children)
+			{
+				if (ch.first == c)
+					return ch.second;
+			}
+			return 0;
+		}
+
+		size_t route_trie::insert(const std::string& key)
+		{
+			size_t n = 0;
+			for (auto c : key)
+			{
+				auto next = child(n, c);
+				if (!next)
+				{
+					next = m_nodes.size();
+					m_nodes[n].m_children.emplace_back(c, next);
+					m_nodes.emplace_back();
+				}
+				n = next;
+			}
+			return n;
+		}
+
+		route_target route_trie::find(const char* key, size_t length, size_t& matched) const
+		{
+			route_target prefix = m_nodes[0].m_prefix;
+			matched = 0;
+
+			size_t n = 0;
+			for (size_t i = 0; i < length; ++i)
+			{
+				n = child(n, key[i]);
+				if (!n)
+					return prefix;
+
+				if (m_nodes[n].m_prefix)
+				{
+					prefix = m_nodes[n].m_prefix;
+					matched = i + 1;
+				}
+			}
+
+			if (m_nodes[n].m_exact)
+			{
+				matched = length;
+				return m_nodes[n].m_exact;
+			}
+
+			return prefix;
+		}
+
+		route_match router::find(const std::string& resource) const
+		{
+			route_match out;
+			size_t matched = 0;
+			out.m_target = m_paths.find(resource.c_str(), resource.length(), matched);
+			if (out.m_target)
+			{
+				out.m_rest = resource.c_str() + matched;
+				out.m_rest_length = resource.length() - matched;
+			}
+			return out;
+		}
+
+		bool router::find_action(const std::string& SOAPAction, size_t& service, std::string& action) const
+		{
+			auto hash = SOAPAction.find('#');
+
+			// no hash - no function; no function - no sense
+			if (hash == std::string::npos)
+				return false;
+
+			size_t matched = 0;
+			auto target = m_urns.find(SOAPAction.c_str(), hash, matched);
+			if (!target)
+				return false;
+
+			service = target.m_index;
+			action.assign(SOAPAction, hash + 1, std::string::npos);
+			return true;
+		}
+	}
+}
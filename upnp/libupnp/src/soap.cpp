@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <soap.hpp>
+#include <expat.hpp>
+#include <cstring>
+
+namespace net
+{
+	namespace ssdp
+	{
+		namespace soap
+		{
+			namespace
+			{
+				// expat reports namespaced names as "uri" SEP "local"
+				const char NS_SEP = '\x01';
+				const char ENVELOPE_NS[] = "http://schemas.xmlsoap.org/soap/envelope/";
+
+				enum depth
+				{
+					DEPTH_ENVELOPE = 1,
+					DEPTH_BODY,
+					DEPTH_ACTION,
+					DEPTH_ARGUMENT
+				};
+
+				inline bool qname_equals(const char* name, const char* ns, size_t ns_length, const char* local)
+				{
+					if (strncmp(name, ns, ns_length) != 0 || name[ns_length] != NS_SEP)
+						return false;
+					return strcmp(name + ns_length + 1, local) == 0;
+				}
+
+				inline const char* local_name(const char* name)
+				{
+					auto sep = strrchr(name, NS_SEP);
+					return sep ? sep + 1 : name;
+				}
+
+				class action_parser : public xml::ExpatBase<action_parser>
+				{
+					const char*    m_service_type;
+					size_t         m_service_type_length;
+					const char*    m_action;
+					argument_sink& m_sink;
+
+					size_t      m_depth;
+					bool        m_ignore;   // outside of the Envelope/Body/action path
+					size_t      m_ignore_depth;
+					std::string m_argument; // name of the argument being collected
+					std::string m_value;
+				public:
+					bool m_found;
+					bool m_finished;
+
+					action_parser(const char* service_type, const std::string& action, argument_sink& sink)
+						: m_service_type(service_type)
+						, m_service_type_length(strlen(service_type))
+						, m_action(action.c_str())
+						, m_sink(sink)
+						, m_depth(0)
+						, m_ignore(false)
+						, m_ignore_depth(0)
+						, m_found(false)
+						, m_finished(false)
+					{
+					}
+
+					bool create()
+					{
+						char sep [] = { NS_SEP, 0 };
+						return xml::ExpatBase<action_parser>::create(nullptr, sep);
+					}
+
+					void onStartElement(const XML_Char* name, const XML_Char** /*attrs*/)
+					{
+						++m_depth;
+						if (m_ignore)
+							return;
+
+						switch (m_depth)
+						{
+						case DEPTH_ENVELOPE:
+							if (!qname_equals(name, ENVELOPE_NS, sizeof(ENVELOPE_NS) - 1, "Envelope"))
+								ignore();
+							break;
+						case DEPTH_BODY:
+							if (!qname_equals(name, ENVELOPE_NS, sizeof(ENVELOPE_NS) - 1, "Body"))
+								ignore();
+							break;
+						case DEPTH_ACTION:
+							if (!qname_equals(name, m_service_type, m_service_type_length, m_action))
+								ignore();
+							else
+								m_found = true;
+							break;
+						case DEPTH_ARGUMENT:
+							m_argument = local_name(name);
+							m_value.clear();
+							break;
+						default:
+							// nested markup inside an argument contributes its text only
+							break;
+						}
+					}
+
+					void onEndElement(const XML_Char* /*name*/)
+					{
+						auto depth = m_depth--;
+						if (m_ignore)
+						{
+							if (depth == m_ignore_depth)
+								m_ignore = false;
+							return;
+						}
+
+						if (depth == DEPTH_ARGUMENT)
+						{
+							m_sink.argument(m_argument.c_str(), m_value);
+						}
+						else if (depth == DEPTH_ACTION)
+						{
+							m_finished = true;
+							XML_StopParser(m_parser, XML_FALSE);
+						}
+					}
+
+					void onCharacterData(const XML_Char* data, int length)
+					{
+						if (!m_ignore && m_depth >= DEPTH_ARGUMENT)
+							m_value.append(data, length);
+					}
+
+				private:
+					void ignore()
+					{
+						m_ignore = true;
+						m_ignore_depth = m_depth;
+					}
+				};
+			}
+
+			decode_result decode(const http::request_data_ptr& data, const char* service_type, const std::string& action, argument_sink& sink)
+			{
+				if (!data || !data->content_length())
+					return decode_result::no_action;
+
+				action_parser parser(service_type, action, sink);
+				if (!parser.create())
+					return decode_result::malformed;
+
+				parser.enableElementHandler();
+				parser.enableCharacterDataHandler();
+
+				static const int CHUNK = 8192;
+				size_t rest = data->content_length();
+				while (rest && !parser.m_finished)
+				{
+					int chunk = rest > CHUNK ? CHUNK : (int) rest;
+					auto buffer = parser.getBuffer(chunk);
+					if (!buffer)
+						return decode_result::malformed;
+
+					auto read = data->read(buffer, chunk);
+					if (!read)
+						break;
+					rest -= read;
+
+					if (!parser.parseBuffer((int) read, rest == 0))
+					{
+						if (parser.m_finished)
+							break;
+						return decode_result::malformed;
+					}
+				}
+
+				if (parser.m_finished)
+					return decode_result::ok;
+
+				return parser.m_found ? decode_result::malformed : decode_result::no_action;
+			}
+		}
+	}
+}
@@ -118,12 +118,7 @@ namespace net
 		void ticker::start()
 		{
 			notify(ALIVE);
-
-			m_timer.async_wait([this](boost::system::error_code ec)
-			{
-				if (!ec)
-					stillAlive();
-			});
+			schedule();
 		}
 
 		void ticker::stop()
@@ -132,6 +127,26 @@ namespace net
 			notify(BYEBYE);
 		}
 
+		void ticker::rebind(const boost::asio::ip::address_v4& local)
+		{
+			m_timer.cancel();
+			notify(BYEBYE);
+			m_local = local;
+			notify(ALIVE);
+
+			m_timer.expires_from_now(boost::posix_time::seconds(m_interval / 3));
+			schedule();
+		}
+
+		void ticker::schedule()
+		{
+			m_timer.async_wait([this](boost::system::error_code ec)
+			{
+				if (!ec)
+					stillAlive();
+			});
+		}
+
 		std::string ticker::build_msg(const std::string& nt, notification_type nts) const
 		{
 			http::http_request req { "NOTIFY", "*" };
@@ -159,7 +174,17 @@ namespace net
 
 		void ticker::notify(notification_type nts) const
 		{
-			auto socket = std::make_shared<udp::multicast_socket>(m_service, ipv4_multicast_endpoint(), m_config->iface);
+			std::shared_ptr<udp::multicast_socket> socket;
+			try
+			{
+				socket = std::make_shared<udp::multicast_socket>(m_service, ipv4_multicast_endpoint(), m_local.to_v4());
+			}
+			catch (boost::system::system_error& e)
+			{
+				// byebye on an address, which is already gone
+				log::warning() << "Cannot send on " << net::to_string(m_local) << ": " << e.what();
+				return;
+			}
 
 			printf("Sending %s...\n", nts == ALIVE ? "ALIVE" : "BYEBYE"); fflush(stdout);
 			log::info() << "Sending " << (nts == ALIVE ? "ALIVE" : "BYEBYE") << "...";
@@ -175,11 +200,7 @@ namespace net
 		{
 			notify(ALIVE);
 			m_timer.expires_at(m_timer.expires_at() + boost::posix_time::seconds(m_interval));
-			m_timer.async_wait([this](boost::system::error_code ec)
-			{
-				if (!ec)
-					stillAlive();
-			});
+			schedule();
 		}
 
 		receiver::receiver(boost::asio::io_service& io_service, const device_ptr& device, const config::config_ptr& config)
@@ -250,6 +271,16 @@ namespace net
 			m_impl.stop();
 		}
 
+		void receiver::rebind(const boost::asio::ip::address_v4& local)
+		{
+			m_local = local;
+
+			boost::system::error_code ec;
+			m_impl.rebind(local, ec);
+			if (ec)
+				log::warning() << "Cannot listen on " << net::to_string(local) << ": " << ec.message();
+		}
+
 		void receiver::discovery(const std::string& st)
 		{
 			log::info() << "Replying to DISCOVER...";
@@ -280,5 +311,18 @@ namespace net
 			return os.str();
 		}
 
+		void server::interface_changed()
+		{
+			auto prev = static_cast<boost::asio::ip::address_v4>(m_config->iface);
+			if (!m_config->iface.refresh())
+				return;
+
+			auto local = static_cast<boost::asio::ip::address_v4>(m_config->iface);
+			log::info() << "Interface changed: " << net::to_string(prev) << " -> " << net::to_string(local);
+
+			m_http.rebind();
+			m_listener.rebind(local);
+			m_alive_ticker.rebind(local);
+		}
 	}
 }